@@ -19,7 +19,8 @@
 #include "packednumbers.h"
 
 #define BUILD_LCP 1
-//#define UNBOUNDED_LCP 1 // if the lcp values are unbounded (int) or truncated to 255 (unsigned char)
+//#define UNBOUNDED_LCP 1 // if the lcp values are exact (255 escape byte plus overflow table) or truncated to 255 (only used without STREAM_LCP)
+#define STREAM_LCP 1 // if only the LCP samples are collected while induced sorting, instead of filling the full LCP array
 //#define DEBUG_INDEX 1
 //#define FILL_INDEX 1
 
@@ -146,7 +147,35 @@ static const unsigned int inverseLetterBitMasks[ALPHABETSIZE][3] = {
 		0x00000000  // 3rd bit mask for 'T' (101): ~1...1 = 0...0
 	}
 };
+// Letter ids of all the chars: '$' (and '\0') = 0 , N (and all other chars) = 1 , A = 2 , C = 3 , G = 4 , T = 5 (upper or lower case)
+static const unsigned char letterIds[256] = {
+	0,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1, // 0x00-0x0F
+	1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1, // 0x10-0x1F
+	1,1,1,1,0,1,1,1,1,1,1,1,1,1,1,1, // 0x20-0x2F
+	1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1, // 0x30-0x3F
+	1,2,1,3,1,1,1,4,1,1,1,1,1,1,1,1, // 0x40-0x4F
+	1,1,1,1,5,1,1,1,1,1,1,1,1,1,1,1, // 0x50-0x5F
+	1,2,1,3,1,1,1,4,1,1,1,1,1,1,1,1, // 0x60-0x6F
+	1,1,1,1,5,1,1,1,1,1,1,1,1,1,1,1, // 0x70-0x7F
+	1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1, // 0x80-0x8F
+	1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1, // 0x90-0x9F
+	1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1, // 0xA0-0xAF
+	1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1, // 0xB0-0xBF
+	1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1, // 0xC0-0xCF
+	1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1, // 0xD0-0xDF
+	1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1, // 0xE0-0xEF
+	1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1  // 0xF0-0xFF
+};
+
+// NOTE: all the query functions only read the index through its handle, so several indexes can be queried at the same time by multiple threads
+struct _FMIndex {
+	IndexBlock *blocks;
+	unsigned int bwtSize; // textSize plus counting with the terminator char too
+	unsigned int numSamples;
+	char isAttached; // if the index blocks belong to a (shared) mapped index file instead of being allocated here
+};
 
+// NOTE: these variables are only used while building an index, and they are handed over to the new index handle at the end
 static IndexBlock *Index = NULL;
 static unsigned int bwtSize = 0; // textSize plus counting with the terminator char too
 static unsigned int numSamples = 0;
@@ -154,15 +183,37 @@ static char *text = NULL;
 //static PackedNumberArray *packedText = NULL;
 static PackedNumberArray *packedBwt = NULL;
 static char *textFilename = NULL;
-static unsigned char *letterIds = NULL;
 
 #ifdef BUILD_LCP
-	#ifdef UNBOUNDED_LCP
-	// use array of ints for storing LCP values
-	static int *LCPArray;
-	#else
 	// use array of chars for storing LCP values (truncate to 255)
 	static unsigned char *LCPArray;
+	#ifdef UNBOUNDED_LCP
+	typedef struct _LCPOverflowEntry {	// exact value of an LCP stored as the escape byte 255 in the LCP array
+		unsigned int pos;
+		int lcp;
+	} LCPOverflowEntry;
+	static LCPOverflowEntry *LCPOverflows = NULL;
+	static unsigned int numLCPOverflows = 0, maxLCPOverflows = 0;
+	#endif
+	#ifdef STREAM_LCP
+	typedef struct _LCPSamplesStream {	// LCPs of the L-type or of the S-type part of a bucket, in the order they are induced
+		unsigned int bucketStartPos;	// BWT position of the 1st position of the bucket
+		unsigned int bucketSize;
+		unsigned int numPositions;		// number of positions of this stream already set
+		unsigned int lastPos;			// BWT position of the last set LCP
+		int lastValue;					// last set LCP
+		int belowValue;					// LCP of the position bellow the last set one (S-type streams only)
+		int topValue, bottomValue;		// LCPs at the topmost and bottommost positions of the stream
+		char isSType, bottomSampled;
+		unsigned char *samples;			// sampled LCP values (255 if oversized)
+		int *bigSamples;				// oversized sampled LCP values
+		unsigned int numSamples, maxSamples, numBigSamples, maxBigSamples;
+		unsigned int readPos, readBigPos;
+	} LCPSamplesStream;
+	static LCPSamplesStream *LCPStreams = NULL;
+	static unsigned long long int *LCPSampleMarks = NULL; // the bit is set to 1 if the LCP at that BWT position is sampled
+	static int readerStreamId;
+	static unsigned int readerBwtPos;
 	#endif
 #endif
 
@@ -178,90 +229,18 @@ static unsigned int *multiStringFirstPos;
 static unsigned int multiStringPosShift;
 static unsigned int *multiStringIdInBlock;
 
-void InitializeIndexArrays(){
-	int i;
-	letterIds=(unsigned char *)malloc(256*sizeof(unsigned char));
-	for(i=0;i<256;i++) letterIds[i]=(unsigned char)1; // ACGT, N and $
-	letterIds[(int)'\0']=(unsigned char)0;
-	letterIds[(int)'$']=(unsigned char)0;
-	letterIds[(int)'N']=(unsigned char)1;
-	letterIds[(int)'A']=(unsigned char)2;
-	letterIds[(int)'C']=(unsigned char)3;
-	letterIds[(int)'G']=(unsigned char)4;
-	letterIds[(int)'T']=(unsigned char)5;
-	letterIds[(int)'n']=(unsigned char)1;
-	letterIds[(int)'a']=(unsigned char)2;
-	letterIds[(int)'c']=(unsigned char)3;
-	letterIds[(int)'g']=(unsigned char)4;
-	letterIds[(int)'t']=(unsigned char)5;
-	/*
-	unsigned int mask, twoMasks[2];
-	offsetMasks = (unsigned int *)malloc(SAMPLEINTERVALSIZE*sizeof(unsigned int));
-	searchOffsetMasks = (unsigned int *)malloc((SAMPLEINTERVALSIZE+1)*sizeof(unsigned int));
-	searchOffsetMasks[0] = 0x00000000;
-	mask = 0x00000001;
-	for(i=1;i<=SAMPLEINTERVALSIZE;i++){
-		offsetMasks[(i-1)] = mask; // from 0 to 31
-		searchOffsetMasks[i] = ( searchOffsetMasks[(i-1)] | mask ); // from 1 to 32
-		mask = ( mask << 1 );
-	}
-	inverseLetterBitMasks = (unsigned int **)malloc(3*sizeof(unsigned int *));
-	for(i=0;i<3;i++) inverseLetterBitMasks[i] = (unsigned int *)malloc(ALPHABETSIZE*sizeof(unsigned int));
-	twoMasks[0] = 0xFFFFFFFF;
-	twoMasks[1] = 0x00000000;
-	for(i=0;i<ALPHABETSIZE;i++){
-		inverseLetterBitMasks[i][0] = twoMasks[ (i & 0x1) ]; // if 1st bit = 1 , mask = ~0xFFFFFFFF , else mask = ~0x00000000
-		inverseLetterBitMasks[i][1] = twoMasks[ ((i & 0x2) >> 1)  ]; // 2nd bit
-		inverseLetterBitMasks[i][2] = twoMasks[ ((i & 0x4) >> 2)  ]; // 3rd bit
-	}
-	*/
+void FMI_FreeIndex( FMIndex *fmi ){
+	if( fmi == NULL ) return;
+	if( !(fmi->isAttached) ) free(fmi->blocks);
+	free(fmi);
 }
 
-void FMI_FreeIndex(){
-	if(textFilename!=NULL){
-		free(textFilename);
-		textFilename=NULL;
-	}
-	if(Index!=NULL){
-		free(Index);
-		Index=NULL;
-	}
-	if(letterIds!=NULL){
-		free(letterIds);
-		letterIds=NULL;
-	}
-	if(multiStringTexts!=NULL){
-		free(multiStringLastChar);
-		free(multiStringFirstPos);
-		free(multiStringIdInBlock);
-		multiStringLastChar=NULL;
-		multiStringFirstPos=NULL;
-		multiStringIdInBlock=NULL;
-		multiStringTexts=NULL;
-	}
-	/*
-	if(offsetMasks!=NULL){
-		free(offsetMasks);
-		offsetMasks=NULL;
-	}
-	if(searchOffsetMasks!=NULL){
-		free(searchOffsetMasks);
-		searchOffsetMasks=NULL;
-	}
-	if(inverseLetterBitMasks!=NULL){
-		for(i=0;i<ALPHABETSIZE;i++) free(inverseLetterBitMasks[i]);
-		free(inverseLetterBitMasks);
-		inverseLetterBitMasks=NULL;
-	}
-	*/
-}
-
-unsigned int FMI_GetTextSize(){
-	return (bwtSize-1); // the bwtSize variable counts the terminator char too
+unsigned int FMI_GetTextSize( FMIndex *fmi ){
+	return ((fmi->bwtSize)-1); // the bwtSize variable counts the terminator char too
 }
 
-unsigned int FMI_GetBWTSize(){
-	return bwtSize;
+unsigned int FMI_GetBWTSize( FMIndex *fmi ){
+	return (fmi->bwtSize);
 }
 
 char *FMI_GetTextFilename(){
@@ -284,12 +263,12 @@ static __inline void SetCharAtBWTPos( unsigned int bwtpos , unsigned int charid
 }
 
 // TODO: check if creating masks on-the-fly is faster than fetching them from array
-static __inline unsigned int GetCharIdAtBWTPos( unsigned int bwtpos ){
+static __inline unsigned int GetCharIdAtBWTPos( IndexBlock *index , unsigned int bwtpos ){
 	unsigned int sample, offset, mask, charid;
 	IndexBlock *block;
 	sample = ( bwtpos >> SAMPLEINTERVALSHIFT );
 	offset = ( bwtpos & SAMPLEINTERVALMASK );
-	block = &(Index[sample]); // get sample block
+	block = &(index[sample]); // get sample block
 	mask = offsetMasks[offset]; // get only the bit at the offset
 	charid = ( ( (block->bwtBits[0]) >> offset ) & FIRSTLETTERMASK ); // get 1st bit
 	charid |= ( ( ( (block->bwtBits[1]) >> offset ) & FIRSTLETTERMASK ) << 1 ); // get 2nd bit
@@ -301,11 +280,11 @@ static __inline unsigned int GetCharIdAtBWTPos( unsigned int bwtpos ){
 	/**/
 }
 
-__inline char FMI_GetCharAtBWTPos( unsigned int bwtpos ){
+__inline char FMI_GetCharAtBWTPos( FMIndex *fmi , unsigned int bwtpos ){
 	IndexBlock *block;
 	unsigned int offset, charid;
 	offset = ( bwtpos & SAMPLEINTERVALMASK );
-	block = &(Index[( bwtpos >> SAMPLEINTERVALSHIFT )]); // get sample block
+	block = &((fmi->blocks)[( bwtpos >> SAMPLEINTERVALSHIFT )]); // get sample block
 	charid = ( ( (block->bwtBits[0]) >> offset ) & FIRSTLETTERMASK ); // get 1st bit
 	charid |= ( ( ( (block->bwtBits[1]) >> offset ) & FIRSTLETTERMASK ) << 1 ); // get 2nd bit
 	charid |= ( ( ( (block->bwtBits[2]) >> offset ) & FIRSTLETTERMASK ) << 2 ); // get 3rd bit
@@ -337,12 +316,12 @@ __inline unsigned int BitsSetCount( unsigned int bitArray ){
 
 // NOTE: if letterId is not at position bwtPos, it considers the jump of the previous occurence behind/above
 // NOTE: it assumes we will never try to do a letter jump by the terminator symbol, since there are no jumps stored in the index for it
-static __inline unsigned int FMI_LetterJump( unsigned int letterId , unsigned int bwtPos ){
+static __inline unsigned int FMI_LetterJump( IndexBlock *index , unsigned int letterId , unsigned int bwtPos ){
 	unsigned int offset, bitArray, letterJump, *letterMasks;
 	IndexBlock *block;
 	letterMasks = (unsigned int *)(inverseLetterBitMasks[letterId]);
 	offset = ( bwtPos & SAMPLEINTERVALMASK );
-	block = &(Index[( bwtPos >> SAMPLEINTERVALSHIFT )]);
+	block = &(index[( bwtPos >> SAMPLEINTERVALSHIFT )]);
 	bitArray = searchOffsetMasks[(offset+1)]; // all bits bellow and at offset (+1 otherwise it would not include the bit at the offset)
 	bitArray &= ( (block->bwtBits[0]) ^ letterMasks[0] ); // keep only positions with the same 1st bit
 	bitArray &= ( (block->bwtBits[1]) ^ letterMasks[1] ); // keep only positions with the same 2nd bit
@@ -356,7 +335,7 @@ static __inline unsigned int FMI_LetterJump( unsigned int letterId , unsigned in
 }
 
 // NOTE: returns the size of the BWT interval if a match exists, and 0 otherwise
-unsigned int FMI_FollowLetter( char c , unsigned int *topPointer , unsigned int *bottomPointer ){
+unsigned int FMI_FollowLetter( FMIndex *fmi , char c , unsigned int *topPointer , unsigned int *bottomPointer ){
 	/*
 	unsigned int charId;
 	unsigned int originalTopPointer;
@@ -371,7 +350,7 @@ unsigned int FMI_FollowLetter( char c , unsigned int *topPointer , unsigned int
 	letterId = letterIds[(unsigned char)c];
 	letterMasks = (unsigned int *)(inverseLetterBitMasks[letterId]);
 	offset = ( (*topPointer) & SAMPLEINTERVALMASK );
-	block = &(Index[( (*topPointer) >> SAMPLEINTERVALSHIFT )]);
+	block = &((fmi->blocks)[( (*topPointer) >> SAMPLEINTERVALSHIFT )]);
 	bitArray = searchOffsetMasks[offset]; // exclusive search mask on top pointer (all bits only bellow offset)
 	bitArray &= ( (block->bwtBits[0]) ^ letterMasks[0] );
 	bitArray &= ( (block->bwtBits[1]) ^ letterMasks[1] );
@@ -384,7 +363,7 @@ unsigned int FMI_FollowLetter( char c , unsigned int *topPointer , unsigned int
 	#endif
 	(*topPointer)++; // if the letter is not in the topPointer position, its next occurrence is after that: LF[top]=count(c,(top-1))+1
 	offset = ( (*bottomPointer) & SAMPLEINTERVALMASK );
-	block = &(Index[( (*bottomPointer) >> SAMPLEINTERVALSHIFT )]);
+	block = &((fmi->blocks)[( (*bottomPointer) >> SAMPLEINTERVALSHIFT )]);
 	bitArray = searchOffsetMasks[(offset+1)]; // inclusive search mask on bottom pointer (all bits bellow and at offset)
 	bitArray &= ( (block->bwtBits[0]) ^ letterMasks[0] );
 	bitArray &= ( (block->bwtBits[1]) ^ letterMasks[1] );
@@ -399,35 +378,99 @@ unsigned int FMI_FollowLetter( char c , unsigned int *topPointer , unsigned int
 	return ( (*bottomPointer) - (*topPointer) + 1 );
 }
 
-unsigned int FMI_PositionInText( unsigned int bwtpos ){
+// Gets the letter jumps of all the letters NACGT (not $) at this BWT position, with or without counting the letter at the position
+static __inline void GetAllLetterJumps( IndexBlock *index , unsigned int bwtPos , char inclusive , unsigned int *letterJumps ){
+	unsigned int letterId, offset, bitArray, *letterMasks;
+	IndexBlock *block;
+	offset = ( bwtPos & SAMPLEINTERVALMASK );
+	block = &(index[( bwtPos >> SAMPLEINTERVALSHIFT )]);
+	if( inclusive ) offset++;
+	for( letterId = 1 ; letterId < ALPHABETSIZE ; letterId++ ){
+		letterMasks = (unsigned int *)(inverseLetterBitMasks[letterId]);
+		bitArray = searchOffsetMasks[offset];
+		bitArray &= ( (block->bwtBits[0]) ^ letterMasks[0] );
+		bitArray &= ( (block->bwtBits[1]) ^ letterMasks[1] );
+		bitArray &= ( (block->bwtBits[2]) ^ letterMasks[2] );
+		letterJumps[(letterId-1)] = (block->letterJumpsSample[(letterId-1)]);
+		#if defined(__GNUC__) && defined(__SSE4_2__)
+			letterJumps[(letterId-1)] += __builtin_popcount( bitArray );
+		#else
+			letterJumps[(letterId-1)] += BitsSetCount( bitArray );
+		#endif
+	}
+}
+
+// Extends the bidirectional interval of a pattern by one letter to the left (backward) or to the right (forward), and returns its new size
+// NOTE: the index must contain both strands of the text (as in the FMD-index), so the interval of a pattern is given by its top pointer,
+//  the top pointer of its reverse complement, and the size (the same for both), and extending the pattern to the right is the same as
+//  extending its reverse complement to the left with the complement letter
+// NOTE: only the letters ACGT can be extended, and if no match exists the size is set to 0 but the pointers are not updated
+unsigned int FMI_ExtendBidirectionalInterval( FMIndex *fmi , char c , char forward , unsigned int *topPointer , unsigned int *revTopPointer , unsigned int *intervalSize ){
+	unsigned int letterId, topJumps[5], bottomJumps[5], letterSizes[ALPHABETSIZE], revTopPtr, *topPtr, *otherTopPtr;
+	int i;
+	letterId = letterIds[(unsigned char)c];
+	if( letterId < 2 || (*intervalSize) == 0 ){ // not ACGT
+		(*intervalSize) = 0;
+		return 0;
+	}
+	if( forward ){ // extend the reverse complement to the left instead
+		letterId = ( 7 - letterId ); // complement letter (A=2<->T=5 and C=3<->G=4)
+		topPtr = revTopPointer;
+		otherTopPtr = topPointer;
+	} else {
+		topPtr = topPointer;
+		otherTopPtr = revTopPointer;
+	}
+	GetAllLetterJumps( (fmi->blocks) , (*topPtr) , 0 , topJumps );
+	GetAllLetterJumps( (fmi->blocks) , ( (*topPtr) + (*intervalSize) - 1 ) , 1 , bottomJumps );
+	letterSizes[0] = (*intervalSize); // number of '$' chars in the interval
+	for( i = 1 ; i < ALPHABETSIZE ; i++ ){
+		letterSizes[i] = ( bottomJumps[(i-1)] - topJumps[(i-1)] );
+		letterSizes[0] -= letterSizes[i];
+	}
+	if( letterSizes[letterId] == 0 ){
+		(*intervalSize) = 0;
+		return 0;
+	}
+	revTopPtr = ( (*otherTopPtr) + letterSizes[0] + letterSizes[1] ); // the other interval is split by the complement of the new letter, in the order $NTGCA
+	for( i = 5 ; i > (int)letterId ; i-- ) revTopPtr += letterSizes[i];
+	(*topPtr) = ( topJumps[(letterId-1)] + 1 );
+	(*otherTopPtr) = revTopPtr;
+	(*intervalSize) = letterSizes[letterId];
+	return (*intervalSize);
+}
+
+unsigned int FMI_PositionInText( FMIndex *fmi , unsigned int bwtpos ){
 	unsigned int charid, addpos;
+	IndexBlock *index;
+	index = (fmi->blocks);
 	addpos = 0;
 	while( bwtpos & SAMPLEINTERVALMASK ){ // move backwards until we land on a position with a sample
-		charid = GetCharIdAtBWTPos(bwtpos);
+		charid = GetCharIdAtBWTPos(index,bwtpos);
 		if( charid == 0 ){ // check if this is the terminator char
 			#ifdef DEBUG_INDEX
 			numBackSteps = addpos;
 			#endif
 			return addpos;
 		}
-		bwtpos = FMI_LetterJump( charid , bwtpos ); // follow the left letter backwards
+		bwtpos = FMI_LetterJump( index , charid , bwtpos ); // follow the left letter backwards
 		addpos++; // one more position away from our original position
 	}
 	#ifdef DEBUG_INDEX
 	numBackSteps = addpos;
 	#endif
-	return ( (Index[( bwtpos >> SAMPLEINTERVALSHIFT )].textPositionSample) + addpos );
+	return ( (index[( bwtpos >> SAMPLEINTERVALSHIFT )].textPositionSample) + addpos );
 }
 
 // returns the new position in the BWT array after left jumping by the char at the given BWT position
-unsigned int FMI_LeftJump( unsigned int bwtpos ){
+unsigned int FMI_LeftJump( FMIndex *fmi , unsigned int bwtpos ){
 	unsigned int charid;
-	charid = GetCharIdAtBWTPos( bwtpos );
+	charid = GetCharIdAtBWTPos( (fmi->blocks) , bwtpos );
 	if( charid == 0 ) return 0U; // terminator symbol jumps to the 0-th position of the BWT
-	else return FMI_LetterJump( charid , bwtpos ); // follow the left letter backwards
+	else return FMI_LetterJump( (fmi->blocks) , charid , bwtpos ); // follow the left letter backwards
 }
 
-void FMI_GetCharCountsAtBWTInterval(unsigned int topPtr, unsigned int bottomPtr, int *counts){
+void FMI_GetCharCountsAtBWTInterval(FMIndex *fmi, unsigned int topPtr, unsigned int bottomPtr, int *counts){
 	unsigned int offset, charid;
 	IndexBlock *block;
 	counts[0] = 0; // reset counts for chars: A,C,G,T,N
@@ -435,7 +478,7 @@ void FMI_GetCharCountsAtBWTInterval(unsigned int topPtr, unsigned int bottomPtr,
 	counts[2] = 0;
 	counts[3] = 0;
 	counts[4] = 0;
-	block = &(Index[( topPtr >> SAMPLEINTERVALSHIFT )]);
+	block = &((fmi->blocks)[( topPtr >> SAMPLEINTERVALSHIFT )]);
 	offset = ( topPtr & SAMPLEINTERVALMASK );
 	while( topPtr <= bottomPtr ){ // process all positions of interval
 		if( offset == SAMPLEINTERVALSIZE ){ // go to next sample block if needed
@@ -578,6 +621,38 @@ void FMI_SaveIndex(char *indexfilename){
 }
 */
 
+// Writes the index blocks (and their sizes) to the current position of an index file, and returns the number of written bytes (or 0 on error)
+size_t FMI_WriteIndex( FMIndex *fmi , FILE *indexFile ){
+	unsigned int sizes[2];
+	if( fmi == NULL || (fmi->blocks) == NULL ) return 0;
+	sizes[0] = (fmi->bwtSize);
+	sizes[1] = (fmi->numSamples);
+	if( fwrite( sizes , sizeof(unsigned int) , (size_t)2 , indexFile ) != (size_t)2 ) return 0;
+	if( fwrite( (fmi->blocks) , sizeof(IndexBlock) , (size_t)(fmi->numSamples) , indexFile ) != (size_t)(fmi->numSamples) ) return 0;
+	return ( 2*sizeof(unsigned int) + (size_t)(fmi->numSamples)*sizeof(IndexBlock) );
+}
+
+// Creates an index handle that uses the index blocks stored in this (mapped) index file data directly, without copying them,
+//  and sets the number of used bytes (returns NULL if the data is invalid)
+// NOTE: the data must stay mapped until FMI_FreeIndex() is called, and it is only read, so it can be shared by multiple processes
+FMIndex *FMI_AttachIndex( char *indexData , size_t dataSize , size_t *usedSize ){
+	FMIndex *fmi;
+	unsigned int *sizes;
+	size_t indexSize;
+	if( dataSize < 2*sizeof(unsigned int) ) return NULL;
+	sizes = (unsigned int *)indexData;
+	if( sizes[0] < 2 || sizes[1] != ( ( ( sizes[0] - 1 ) >> SAMPLEINTERVALSHIFT ) + 1 ) ) return NULL; // check if the number of samples matches the BWT size
+	indexSize = ( 2*sizeof(unsigned int) + (size_t)sizes[1]*sizeof(IndexBlock) );
+	if( indexSize > dataSize ) return NULL;
+	fmi = (FMIndex *)malloc(sizeof(FMIndex));
+	(fmi->bwtSize) = sizes[0];
+	(fmi->numSamples) = sizes[1];
+	(fmi->blocks) = (IndexBlock *)( indexData + 2*sizeof(unsigned int) );
+	(fmi->isAttached) = 1;
+	(*usedSize) = indexSize;
+	return fmi;
+}
+
 
 // Function pointer to get char id at corresponding text position
 unsigned int (*GetTextCharId)(unsigned int);
@@ -636,7 +711,7 @@ unsigned int GetTextCharIdFromMultipleStrings(unsigned int pos){
 }
 
 
-void PrintBWT(unsigned int *letterStartPos){
+void PrintBWT(FMIndex *fmi, unsigned int *letterStartPos){
 	unsigned int i, n, p;
 	printf("%u {", bwtSize);
 	for (n = 1; n < ALPHABETSIZE; n++){
@@ -652,15 +727,15 @@ void PrintBWT(unsigned int *letterStartPos){
 #endif
 	printf(" BWT\n");
 	for (i = 0; i < bwtSize; i++){ // position in BWT
-		p = FMI_PositionInText(i);
+		p = FMI_PositionInText(fmi, i);
 		printf("[%02u]%c(%2u) {", i, (i & SAMPLEINTERVALMASK) ? ' ' : '*', p);
 		for (n = 1; n < ALPHABETSIZE; n++){
-			printf("%02u%c", FMI_LetterJump(n, i), (n == (ALPHABETSIZE - 1)) ? '}' : ',');
+			printf("%02u%c", FMI_LetterJump(Index, n, i), (n == (ALPHABETSIZE - 1)) ? '}' : ',');
 		}
 #ifdef BUILD_LCP
 		if (LCPArray != NULL) printf(" %3d", (int)LCPArray[i]);
 #endif
-		printf(" %c ", FMI_GetCharAtBWTPos(i));
+		printf(" %c ", FMI_GetCharAtBWTPos(fmi, i));
 		n = 0;
 		while ((n < (ALPHABETSIZE - 1)) && (i >= letterStartPos[(n + 1)])) n++;
 		printf(" %c ", LETTERCHARS[n]);
@@ -1021,6 +1096,319 @@ void SortLMSs( int *charsBuckets , char verbose ){
 	#endif
 }
 
+#ifdef STREAM_LCP
+// Initializes the LCP sample streams of all buckets (one for the L-type part and one for the S-type part of each bucket)
+void InitializeLCPStreams( unsigned int *bucketSize ){
+	LCPSamplesStream *stream;
+	unsigned int startPos;
+	int charId, n;
+	LCPStreams = (LCPSamplesStream *)calloc((2*ALPHABETSIZE),sizeof(LCPSamplesStream));
+	LCPSampleMarks = (unsigned long long int *)calloc(((bwtSize>>6)+1),sizeof(unsigned long long int));
+	if( LCPStreams==NULL || LCPSampleMarks==NULL ){
+		printf("\n> ERROR: Not enough memory to collect LCP samples\n");
+		exit(-1);
+	}
+	startPos = 0;
+	for( charId = 0 ; charId < ALPHABETSIZE ; charId++ ){
+		for( n = 0 ; n < 2 ; n++ ){
+			stream = &(LCPStreams[(2*charId+n)]);
+			(stream->bucketStartPos) = startPos;
+			(stream->bucketSize) = bucketSize[charId];
+			(stream->isSType) = (char)n;
+		}
+		startPos += bucketSize[charId];
+	}
+}
+
+// Returns the final LCP value of a BWT position, since the LCPs of the 0-th position and of the 1st position of each bucket are fixed
+static __inline int GetFinalStreamLCP( LCPSamplesStream *stream , unsigned int bwtPos , int lcpValue ){
+	if( bwtPos == 0 ) return (-1);
+	if( bwtPos == (stream->bucketStartPos) ) return 0;
+	return lcpValue;
+}
+
+// Adds a sampled LCP value to the stream (values of 255 or more, and -1, are kept in a separate array)
+static void AddSampleToLCPStream( LCPSamplesStream *stream , unsigned int bwtPos , int lcpValue ){
+	LCPSampleMarks[(bwtPos >> 6)] |= ( 1ULL << (bwtPos & 63) );
+	if( (stream->numSamples) == (stream->maxSamples) ){
+		(stream->maxSamples) += ( ((stream->bucketSize) >> 4) + 1024 ); // grow by 1/16 of the bucket size each time
+		(stream->samples) = (unsigned char *)realloc((stream->samples),(stream->maxSamples)*sizeof(unsigned char));
+		if( (stream->samples) == NULL ){
+			printf("\n> ERROR: Not enough memory to collect LCP samples\n");
+			exit(-1);
+		}
+	}
+	if( lcpValue >= 0 && lcpValue < UCHAR_MAX ){
+		(stream->samples)[(stream->numSamples)++] = (unsigned char)lcpValue;
+		return;
+	}
+	(stream->samples)[(stream->numSamples)++] = UCHAR_MAX;
+	if( (stream->numBigSamples) == (stream->maxBigSamples) ){
+		(stream->maxBigSamples) += ( ((stream->bucketSize) >> 8) + 1024 );
+		(stream->bigSamples) = (int *)realloc((stream->bigSamples),(stream->maxBigSamples)*sizeof(int));
+		if( (stream->bigSamples) == NULL ){
+			printf("\n> ERROR: Not enough memory to collect LCP samples\n");
+			exit(-1);
+		}
+	}
+	(stream->bigSamples)[(stream->numBigSamples)++] = lcpValue;
+}
+
+// The last value of the S-type stream is now final, so check if it needs to be sampled
+static void SetLastLCPInSStream( LCPSamplesStream *stream ){
+	(stream->lastValue) = GetFinalStreamLCP( stream , (stream->lastPos) , (stream->lastValue) );
+	if( (stream->numPositions) == 1 ) (stream->bottomValue) = (stream->lastValue); // the bottom position is only sampled at the end
+	else if( (stream->lastValue) != (stream->belowValue) ) AddSampleToLCPStream( stream , (stream->lastPos) , (stream->lastValue) );
+	(stream->belowValue) = (stream->lastValue);
+}
+
+// Sets the LCP of the next BWT position of the stream, and samples the previous position if the LCP changed between them
+// NOTE: L-type streams are filled downwards and S-type streams upwards, and the last value of an S-type stream can still be updated by
+//  UpdateLastLCPInStream() until the next value is set
+void SetLCPInStream( LCPSamplesStream *stream , unsigned int bwtPos , int lcpValue ){
+	if( !(stream->isSType) ){ // (lastPos+1)==bwtPos
+		lcpValue = GetFinalStreamLCP( stream , bwtPos , lcpValue );
+		if( (stream->numPositions) == 0 ) (stream->topValue) = lcpValue;
+		else if( (stream->lastValue) != lcpValue ) AddSampleToLCPStream( stream , (stream->lastPos) , (stream->lastValue) );
+	} else if( (stream->numPositions) != 0 ) SetLastLCPInSStream( stream ); // (lastPos-1)==bwtPos
+	(stream->lastPos) = bwtPos;
+	(stream->lastValue) = lcpValue;
+	(stream->numPositions)++;
+}
+
+// Fixes the LCP value of the last (topmost) position set in the S-type stream
+void UpdateLastLCPInStream( LCPSamplesStream *stream , unsigned int bwtPos , int lcpValue ){
+	if( (stream->numPositions) != 0 && (stream->lastPos) == bwtPos ) (stream->lastValue) = lcpValue; // otherwise it is the 1st position of the next bucket, whose LCP is always 0
+}
+
+// After all the LCPs were set, checks if the bottom position of each stream needs to be sampled, by comparing it with the next position
+void FinishLCPStreams(){
+	LCPSamplesStream *stream;
+	int streamId, nextLcp;
+	for( streamId = 0 ; streamId < (2*ALPHABETSIZE) ; streamId++ ){ // the values at both ends of all the streams must be final first
+		stream = &(LCPStreams[streamId]);
+		if( (stream->numPositions) == 0 ) continue;
+		if( (stream->isSType) ){
+			SetLastLCPInSStream( stream );
+			(stream->topValue) = (stream->lastValue);
+			(stream->lastPos) = ( (stream->lastPos) + (stream->numPositions) - 1 ); // bottom position
+		} else (stream->bottomValue) = (stream->lastValue);
+	}
+	for( streamId = 0 ; streamId < (2*ALPHABETSIZE) ; streamId++ ){
+		stream = &(LCPStreams[streamId]);
+		if( (stream->numPositions) == 0 ) continue;
+		if( !(stream->isSType) && (LCPStreams[(streamId+1)].numPositions) != 0 ) nextLcp = (LCPStreams[(streamId+1)].topValue); // the S-type part follows in the same bucket
+		else if( (stream->lastPos) == (bwtSize-1) ) nextLcp = (-1); // fake next-to-last position
+		else nextLcp = 0; // the 1st position of the next bucket
+		(stream->bottomSampled) = (char)( (stream->bottomValue) != nextLcp );
+	}
+}
+#endif
+
+// Prepares the reader of the LCP samples collected while building the index, and returns the total number of samples
+// NOTE: only available if the LCP samples were streamed, otherwise returns 0
+unsigned int FMI_StartLCPSamplesReader( unsigned int *numBigSamples ){
+	#ifdef STREAM_LCP
+	LCPSamplesStream *stream;
+	unsigned int numSamples;
+	int streamId;
+	numSamples = 0;
+	(*numBigSamples) = 0;
+	if( LCPStreams == NULL ) return 0;
+	for( streamId = 0 ; streamId < (2*ALPHABETSIZE) ; streamId++ ){
+		stream = &(LCPStreams[streamId]);
+		numSamples += (stream->numSamples);
+		(*numBigSamples) += (stream->numBigSamples);
+		if( (stream->numPositions) != 0 && (stream->bottomSampled) ){
+			LCPSampleMarks[((stream->lastPos) >> 6)] |= ( 1ULL << ((stream->lastPos) & 63) );
+			numSamples++;
+			if( (stream->bottomValue) < 0 || (stream->bottomValue) >= UCHAR_MAX ) (*numBigSamples)++;
+		}
+		(stream->readPos) = ( (stream->isSType) ? (stream->numSamples) : 0 ); // S-type streams are read backwards
+		(stream->readBigPos) = ( (stream->isSType) ? (stream->numBigSamples) : 0 );
+	}
+	readerStreamId = 0;
+	readerBwtPos = 0;
+	return numSamples;
+	#else
+	(*numBigSamples) = 0;
+	return 0;
+	#endif
+}
+
+// Returns the next LCP sample in BWT order, and its BWT position in the argument
+// NOTE: the samples of each stream are released as soon as they are all read
+int FMI_GetNextLCPSample( unsigned int *bwtPos ){
+	#ifdef STREAM_LCP
+	LCPSamplesStream *stream;
+	unsigned char value;
+	while( !( LCPSampleMarks[(readerBwtPos >> 6)] & ( 1ULL << (readerBwtPos & 63) ) ) ) readerBwtPos++;
+	(*bwtPos) = readerBwtPos;
+	while( 1 ){
+		stream = &(LCPStreams[readerStreamId]);
+		if( !(stream->isSType) && (stream->readPos) != (stream->numSamples) ){
+			value = (stream->samples)[(stream->readPos)++];
+			break;
+		}
+		if( (stream->isSType) && (stream->readPos) != 0 ){
+			value = (stream->samples)[--(stream->readPos)];
+			break;
+		}
+		free(stream->samples); // no more samples inside the stream
+		(stream->samples) = NULL;
+		if( (stream->numPositions) != 0 && (stream->bottomSampled) ){
+			(stream->bottomSampled) = 0;
+			readerBwtPos++;
+			return (stream->bottomValue);
+		}
+		free(stream->bigSamples);
+		(stream->bigSamples) = NULL;
+		readerStreamId++;
+		if( readerStreamId == (2*ALPHABETSIZE) ) return (-1); // all samples were already read
+	}
+	readerBwtPos++;
+	if( value != UCHAR_MAX ) return (int)value;
+	if( (stream->isSType) ) return (stream->bigSamples)[--(stream->readBigPos)];
+	return (stream->bigSamples)[(stream->readBigPos)++];
+	#else
+	(*bwtPos) = 0;
+	return (-1);
+	#endif
+}
+
+#if ( defined(BUILD_LCP) && defined(UNBOUNDED_LCP) && !defined(STREAM_LCP) )
+// Stores an LCP value in the LCP array, using the 255 escape byte and the overflow table if it does not fit in a byte
+static __inline void SetEscapedLCP( unsigned int bwtPos , int lcpValue ){
+	if( lcpValue >= 0 && lcpValue < UCHAR_MAX ){
+		LCPArray[bwtPos] = (unsigned char)lcpValue;
+		return;
+	}
+	LCPArray[bwtPos] = UCHAR_MAX;
+	if( numLCPOverflows == maxLCPOverflows ){
+		maxLCPOverflows += 1024;
+		LCPOverflows = (LCPOverflowEntry *)realloc(LCPOverflows,maxLCPOverflows*sizeof(LCPOverflowEntry));
+		if( LCPOverflows == NULL ){
+			printf("\n> ERROR: Not enough memory to store the oversized LCP values\n");
+			exit(-1);
+		}
+	}
+	LCPOverflows[numLCPOverflows].pos = bwtPos;
+	LCPOverflows[numLCPOverflows].lcp = lcpValue;
+	numLCPOverflows++;
+}
+
+// Sorts the overflow table by BWT position and keeps only the last value set at each position that still holds the escape byte
+// NOTE: a position can be set more than once while induced sorting (fixed LCPs of S-type suffixes and 1st positions of buckets),
+//  and the radix sort is stable, so the last entry of each position is the one that was set last
+static void FinishLCPOverflows(){
+	LCPOverflowEntry *temp, *src, *dest;
+	unsigned int *counts;
+	unsigned int i, n, c, sum, shift;
+	if( numLCPOverflows == 0 ) return;
+	temp = (LCPOverflowEntry *)malloc(numLCPOverflows*sizeof(LCPOverflowEntry));
+	counts = (unsigned int *)malloc(65536*sizeof(unsigned int));
+	if( temp == NULL || counts == NULL ){
+		printf("\n> ERROR: Not enough memory to sort the oversized LCP values\n");
+		exit(-1);
+	}
+	src = LCPOverflows;
+	dest = temp;
+	for( shift = 0 ; shift < 32 ; shift += 16 ){
+		for( c = 0 ; c < 65536 ; c++ ) counts[c] = 0;
+		for( i = 0 ; i < numLCPOverflows ; i++ ) counts[ ((src[i].pos) >> shift) & 0xFFFF ]++;
+		sum = 0;
+		for( c = 0 ; c < 65536 ; c++ ){
+			i = counts[c];
+			counts[c] = sum;
+			sum += i;
+		}
+		for( i = 0 ; i < numLCPOverflows ; i++ ) dest[ counts[ ((src[i].pos) >> shift) & 0xFFFF ]++ ] = src[i];
+		src = dest;
+		dest = ( (dest == temp) ? LCPOverflows : temp );
+	}
+	free(counts);
+	free(temp);
+	n = 0;
+	for( i = 0 ; i < numLCPOverflows ; i++ ){
+		if( LCPOverflows[i].pos == 0 ) continue; // the 0-th position is not included
+		if( (i+1) < numLCPOverflows && LCPOverflows[(i+1)].pos == LCPOverflows[i].pos ) continue; // outdated value
+		if( LCPArray[ LCPOverflows[i].pos ] != UCHAR_MAX ) continue; // the position was overwritten with a small value
+		LCPOverflows[n++] = LCPOverflows[i];
+	}
+	numLCPOverflows = n;
+	maxLCPOverflows = (n+1);
+	LCPOverflows = (LCPOverflowEntry *)realloc(LCPOverflows,maxLCPOverflows*sizeof(LCPOverflowEntry));
+}
+
+#ifdef DEBUG_INDEX
+// Returns the exact LCP value at the given BWT position, searching the overflow table if the value was escaped
+static int GetEscapedLCP( unsigned int bwtPos ){
+	unsigned int left, right, middle;
+	if( LCPArray[bwtPos] != UCHAR_MAX ) return (int)LCPArray[bwtPos];
+	if( bwtPos == 0 ) return (-1);
+	left = 0;
+	right = numLCPOverflows;
+	while( left < right ){
+		middle = ( left + ( right - left ) / 2 );
+		if( LCPOverflows[middle].pos < bwtPos ) left = ( middle + 1 );
+		else right = middle;
+	}
+	return LCPOverflows[left].lcp;
+}
+#endif
+#endif
+
+// Returns 1 if the LCPs collected while building the index are exact, i.e., they never need to be recalculated from the text
+char FMI_HasExactLCPs(){
+	#if ( defined(BUILD_LCP) && ( defined(STREAM_LCP) || defined(UNBOUNDED_LCP) ) )
+	return 1;
+	#else
+	return 0;
+	#endif
+}
+
+// Returns the number of oversized LCPs (escaped as 255 in the LCP array) whose exact values were kept while building the index
+// NOTE: the values are sorted by BWT position, the 0-th position (LCP=-1) is not included, and only available with UNBOUNDED_LCP
+unsigned int FMI_GetNumLCPOverflows(){
+	#if ( defined(BUILD_LCP) && defined(UNBOUNDED_LCP) && !defined(STREAM_LCP) )
+	return numLCPOverflows;
+	#else
+	return 0;
+	#endif
+}
+
+// Returns the exact value of the n-th oversized LCP, and its BWT position in the argument
+int FMI_GetLCPOverflow( unsigned int n , unsigned int *bwtPos ){
+	#if ( defined(BUILD_LCP) && defined(UNBOUNDED_LCP) && !defined(STREAM_LCP) )
+	(*bwtPos) = LCPOverflows[n].pos;
+	return LCPOverflows[n].lcp;
+	#else
+	(*bwtPos) = n;
+	return (-1);
+	#endif
+}
+
+// Releases the memory used by the LCP samples (or the oversized LCPs table) collected while building the index
+void FMI_FreeLCPSamples(){
+	#ifdef STREAM_LCP
+	int streamId;
+	if( LCPStreams == NULL ) return;
+	for( streamId = 0 ; streamId < (2*ALPHABETSIZE) ; streamId++ ){
+		free(LCPStreams[streamId].samples);
+		free(LCPStreams[streamId].bigSamples);
+	}
+	free(LCPStreams);
+	LCPStreams = NULL;
+	free(LCPSampleMarks);
+	LCPSampleMarks = NULL;
+	#elif ( defined(BUILD_LCP) && defined(UNBOUNDED_LCP) )
+	if( LCPOverflows != NULL ) free(LCPOverflows);
+	LCPOverflows = NULL;
+	numLCPOverflows = 0;
+	maxLCPOverflows = 0;
+	#endif
+}
+
 void InducedSort( unsigned int *bucketSize , int *bucketStartPos , char verbose ){
 	int firstId[ALPHABETSIZE], lastId[ALPHABETSIZE], topSId[ALPHABETSIZE], bottomLId[ALPHABETSIZE];
 	int arrayPos, nextArrayPos, charId, leftCharId;
@@ -1047,7 +1435,8 @@ void InducedSort( unsigned int *bucketSize , int *bucketStartPos , char verbose
 	*/
 	bucketPointer[0] = 0; // pointers to the location in the suffix array that will be filled up next (for each letter)
 	for( charId = 1 ; charId < ALPHABETSIZE ; charId++ ) bucketPointer[charId] = ( bucketPointer[(charId-1)] + bucketSize[(charId-1)] ); // points to the first position in each bucket
-	#ifdef BUILD_LCP
+	#if ( defined(BUILD_LCP) && defined(STREAM_LCP) )
+	InitializeLCPStreams(bucketSize);
 	#endif
 	for( charId = 0 ; charId < ALPHABETSIZE ; charId++ ){ // initialize pointers that will be used
 		firstId[charId] = (-1); // pointers to start and end of array of L-type strings (at the top of buckets)
@@ -1093,8 +1482,10 @@ void InducedSort( unsigned int *bucketSize , int *bucketStartPos , char verbose
 				#endif
 				#ifdef BUILD_LCP
 				lcpValue = LMSArray[arrayPos].lcp;
-				#ifdef UNBOUNDED_LCP
-				LCPArray[ bucketPointer[charId] ] = lcpValue; // set lcp of L-type chars, since its correct value has already been calculated and stored before
+				#if defined(STREAM_LCP)
+				SetLCPInStream( &(LCPStreams[(2*charId)]) , bucketPointer[charId] , lcpValue ); // set lcp of L-type chars, since its correct value has already been calculated and stored before
+				#elif defined(UNBOUNDED_LCP)
+				SetEscapedLCP( bucketPointer[charId] , lcpValue ); // set lcp of L-type chars, since its correct value has already been calculated and stored before
 				#else
 				LCPArray[ bucketPointer[charId] ] = (lcpValue<UCHAR_MAX)?((unsigned char)lcpValue):(UCHAR_MAX);
 				#endif
@@ -1214,8 +1605,10 @@ void InducedSort( unsigned int *bucketSize , int *bucketStartPos , char verbose
 					}
 					LMSArray[arrayPos].lcp = lcpValue; // fix lcp value of this last S-type suffix
 				}
-				#ifdef UNBOUNDED_LCP
-				LCPArray[ bucketPointer[charId] ] = LMSArray[arrayPos].lcp; // set lcp of S-type chars, since its correct value has already been calculated and stored before
+				#if defined(STREAM_LCP)
+				SetLCPInStream( &(LCPStreams[(2*charId+1)]) , bucketPointer[charId] , LMSArray[arrayPos].lcp ); // set lcp of S-type chars, since its correct value has already been calculated and stored before
+				#elif defined(UNBOUNDED_LCP)
+				SetEscapedLCP( bucketPointer[charId] , LMSArray[arrayPos].lcp ); // set lcp of S-type chars, since its correct value has already been calculated and stored before
 				#else
 				lcpValue = LMSArray[arrayPos].lcp;
 				LCPArray[ bucketPointer[charId] ] = (lcpValue<UCHAR_MAX)?((unsigned char)lcpValue):(UCHAR_MAX);
@@ -1237,8 +1630,10 @@ void InducedSort( unsigned int *bucketSize , int *bucketStartPos , char verbose
 				if( prevLcpCharLMSPos[leftCharId] != (-1) ){ // update the lcp of the LMS with the last seen (bellow) occurrence of this same left char with the minimum in the interval until now (exclusive)
 					LMSArray[ prevLcpCharLMSPos[leftCharId] ].lcp = (prevMinLcpValue[leftCharId] + 1);
 					if( arrayPos == prevLcpCharLMSPos[leftCharId] ){ // if the LMS of the prev (bellow) left char is this one, we already set its value in the LCP array but it is outdated because this step should have been done before
-						#ifdef UNBOUNDED_LCP
-						LCPArray[ (bucketPointer[charId] + 1) ] = LMSArray[arrayPos].lcp; // fix the value
+						#if defined(STREAM_LCP)
+						UpdateLastLCPInStream( &(LCPStreams[(2*charId+1)]) , (bucketPointer[charId] + 1) , LMSArray[arrayPos].lcp ); // fix the value
+						#elif defined(UNBOUNDED_LCP)
+						SetEscapedLCP( (bucketPointer[charId] + 1) , LMSArray[arrayPos].lcp ); // fix the value
 						#else
 						lcpValue = LMSArray[arrayPos].lcp;
 						LCPArray[ (bucketPointer[charId] + 1) ] = (lcpValue<UCHAR_MAX)?((unsigned char)lcpValue):(UCHAR_MAX);
@@ -1292,16 +1687,19 @@ void InducedSort( unsigned int *bucketSize , int *bucketStartPos , char verbose
 		#endif
 	}
 	#ifdef BUILD_LCP
-	#ifdef UNBOUNDED_LCP
-	LCPArray[0] = (-1);
+	#ifdef STREAM_LCP
+	FinishLCPStreams(); // the LCPs of the 0-th position and of the 1st position of each bucket were already fixed when set
 	#else
-	LCPArray[0] = UCHAR_MAX;
-	#endif
+	LCPArray[0] = UCHAR_MAX; // the LCP of the 0-th position is always (-1)
 	textPos = 0; // set LCP of all 1st positions of all chars to 0, since the LCP of the 1st occurrence of each char in the BWT was never updated
 	for( charId = 0 ; charId < (ALPHABETSIZE-1) ; charId++ ){
 		textPos += bucketSize[charId];
 		if( textPos < bwtSize ) LCPArray[textPos] = 0;
 	}
+	#ifdef UNBOUNDED_LCP
+	FinishLCPOverflows(); // drop the values that were overwritten afterwards
+	#endif
+	#endif
 	#endif
 	if(verbose){
 		printf(" OK\n");
@@ -1315,7 +1713,9 @@ void InducedSort( unsigned int *bucketSize , int *bucketStartPos , char verbose
 //  - sort chars by number of occurrences (or just "$,N" the same, last 2 chars the most frequent ones)
 //  - variable length bits per char; process chars bottom up; depth-first while num chars in level is > 2; set chars bit to 0/1 at level
 //  - level_size=bwt_size; k=(alphabet_size-1); n=sorted_counts[k]; while(n<(level_size/2)) n+=sorted_counts[--k]; ...
-void FMI_BuildIndex(char **inputTexts, unsigned int *inputTextSizes, unsigned int inputNumTexts, unsigned char **lcpArrayPointer, char verbose){
+// NOTE: the build itself uses global state, so only one index can be built at a time (but the returned index handle can be used concurrently)
+FMIndex *FMI_BuildIndex(char **inputTexts, unsigned int *inputTextSizes, unsigned int inputNumTexts, unsigned char **lcpArrayPointer, char verbose){
+	FMIndex *fmi;
 	unsigned int letterId, i, n;
 	unsigned int textPos, samplePos;
 	unsigned int *letterCounts, *letterStartPos;
@@ -1385,7 +1785,6 @@ void FMI_BuildIndex(char **inputTexts, unsigned int *inputTextSizes, unsigned in
 		bwtSize = InitializeMultiStringArrays(inputTexts, inputTextSizes, inputNumTexts);
 		GetTextCharId = GetTextCharIdFromMultipleStrings;
 	}
-	InitializeIndexArrays(); // initialize letter ids array
 	letterCounts = (unsigned int *)malloc(ALPHABETSIZE*sizeof(unsigned int));
 	letterLMSStartPos = (int *)malloc(ALPHABETSIZE*sizeof(int));
 
@@ -1423,10 +1822,13 @@ void FMI_BuildIndex(char **inputTexts, unsigned int *inputTextSizes, unsigned in
 	#endif
 
 	#ifdef BUILD_LCP
-	#ifdef UNBOUNDED_LCP
-	LCPArray = (int *)malloc(bwtSize*sizeof(int));
+	#if defined(STREAM_LCP)
+	LCPArray = NULL; // only the LCP samples are kept, and they can be read with FMI_GetNextLCPSample()
 	(*lcpArrayPointer) = NULL;
 	#else
+	#ifdef UNBOUNDED_LCP
+	FMI_FreeLCPSamples(); // reset the table with the exact values of the escaped LCPs
+	#endif
 	LCPArray = (unsigned char *)malloc(bwtSize*sizeof(unsigned char));
 	(*lcpArrayPointer) = LCPArray; // output LCP array as pointer in argument
 	#endif
@@ -1467,7 +1869,7 @@ void FMI_BuildIndex(char **inputTexts, unsigned int *inputTextSizes, unsigned in
 			}
 		}
 		#ifdef FILL_INDEX
-		letterId = GetCharIdAtBWTPos(n);
+		letterId = GetCharIdAtBWTPos(Index,n);
 		#else
 		letterId = GetPackedNumber(packedBwt,n);
 		#endif
@@ -1516,8 +1918,8 @@ void FMI_BuildIndex(char **inputTexts, unsigned int *inputTextSizes, unsigned in
 			(Index[samplePos].textPositionSample) = textPos;
 		}
 		if(textPos==0) break;
-		i = GetCharIdAtBWTPos(n); // get char at this BWT position (in the left)
-		n = FMI_LetterJump(i,n); // follow the letter backwards to go to next position in the BWT
+		i = GetCharIdAtBWTPos(Index,n); // get char at this BWT position (in the left)
+		n = FMI_LetterJump(Index,i,n); // follow the letter backwards to go to next position in the BWT
 		textPos--;
 	}
 	if(verbose){
@@ -1532,11 +1934,16 @@ void FMI_BuildIndex(char **inputTexts, unsigned int *inputTextSizes, unsigned in
 		#endif
 		fflush(stdout);	
 	}
+	fmi = (FMIndex *)malloc(sizeof(FMIndex)); // hand over the index blocks to the new index handle
+	(fmi->blocks) = Index;
+	(fmi->bwtSize) = bwtSize;
+	(fmi->numSamples) = numSamples;
+	(fmi->isAttached) = 0;
 	#ifdef DEBUG_INDEX
-	if(bwtSize<100) PrintBWT(letterStartPos);
+	if(bwtSize<100) PrintBWT(fmi,letterStartPos);
 	if(verbose){
 		printf("> Checking BWT ");
-		#if ( defined(BUILD_LCP) && defined(UNBOUNDED_LCP) )
+		#if ( defined(BUILD_LCP) && defined(UNBOUNDED_LCP) && !defined(STREAM_LCP) )
 		printf("and LCP ");
 		#endif
 		fflush(stdout);
@@ -1548,7 +1955,7 @@ void FMI_BuildIndex(char **inputTexts, unsigned int *inputTextSizes, unsigned in
 	longestRun=0;
 	runSizesCount=(unsigned int *)malloc(1*sizeof(unsigned int));
 	runSizesCount[0]=0;
-	k = FMI_PositionInText(0); // position in the text of the top BWT position (should be equal to (bwtSize-1))
+	k = FMI_PositionInText(fmi,0); // position in the text of the top BWT position (should be equal to (bwtSize-1))
 	for(bwtPos=1;bwtPos<bwtSize;bwtPos++){ // compare current position with position above
 		if(verbose){
 			progressCounter++;
@@ -1558,16 +1965,16 @@ void FMI_BuildIndex(char **inputTexts, unsigned int *inputTextSizes, unsigned in
 				progressCounter=0;
 			}
 		}
-		i = FMI_PositionInText(bwtPos); // position in the text of the suffix in this row
+		i = FMI_PositionInText(fmi,bwtPos); // position in the text of the suffix in this row
 		n = 0; // current suffix depth
 		while( (prevLetterId=GetTextCharId((k+n))) == (letterId=GetTextCharId((i+n))) ) n++; // keep following suffix chars to the right while their letters are equal
-		#if ( defined(BUILD_LCP) && defined(UNBOUNDED_LCP) )
-		if( (int)LCPArray[bwtPos] != (int)n ){
-			printf("\n> ERROR: LCP[%u]=%d =!= %d\n",bwtPos,(int)LCPArray[bwtPos],(int)n);
-			printf("\t[%c] %c|",GetCharType(k),LETTERCHARS[GetCharIdAtBWTPos((bwtPos-1))]);
+		#if ( defined(BUILD_LCP) && defined(UNBOUNDED_LCP) && !defined(STREAM_LCP) )
+		if( GetEscapedLCP(bwtPos) != (int)n ){
+			printf("\n> ERROR: LCP[%u]=%d =!= %d\n",bwtPos,GetEscapedLCP(bwtPos),(int)n);
+			printf("\t[%c] %c|",GetCharType(k),LETTERCHARS[GetCharIdAtBWTPos(Index,(bwtPos-1))]);
 			for( textPos=k ; textPos<=(k+n) ; textPos++ ) putchar(LETTERCHARS[GetTextCharId(textPos)]);
 			putchar('\n');
-			printf("\t[%c] %c|",GetCharType(i),LETTERCHARS[GetCharIdAtBWTPos(bwtPos)]);
+			printf("\t[%c] %c|",GetCharType(i),LETTERCHARS[GetCharIdAtBWTPos(Index,bwtPos)]);
 			for( textPos=i ; textPos<=(i+n) ; textPos++ ) putchar(LETTERCHARS[GetTextCharId(textPos)]);
 			putchar('\n');
 			fflush(stdout);
@@ -1575,8 +1982,8 @@ void FMI_BuildIndex(char **inputTexts, unsigned int *inputTextSizes, unsigned in
 		}
 		#endif
 		if( prevLetterId > letterId ) break; // if the top letter is larger than the bottom letter, it is incorrectly sorted
-		prevLetterId = GetCharIdAtBWTPos((bwtPos-1)); // get statistics about run lengths
-		letterId = GetCharIdAtBWTPos(bwtPos);
+		prevLetterId = GetCharIdAtBWTPos(Index,(bwtPos-1)); // get statistics about run lengths
+		letterId = GetCharIdAtBWTPos(Index,bwtPos);
 		if( prevLetterId == letterId ) sizeRun++;
 		else {
 			if( sizeRun > longestRun ){
@@ -1632,10 +2039,10 @@ void FMI_BuildIndex(char **inputTexts, unsigned int *inputTextSizes, unsigned in
 			for(i=1;i<ALPHABETSIZE;i++) if( (Index[samplePos].letterJumpsSample[(i-1)]) != (letterCounts[i]) ) break;
 			if(i!=ALPHABETSIZE) break;
 		}
-		i=GetCharIdAtBWTPos(n); // get letter and update count
+		i=GetCharIdAtBWTPos(Index,n); // get letter and update count
 		letterCounts[i]++;
 		//if(i!=0) if( FMI_LetterJump(i,n) != letterCounts[i] ) break; // check if it is the terminator char because we cannot jump by it
-		for(i=1;i<ALPHABETSIZE;i++) if( FMI_LetterJump(i,n) != letterCounts[i] ) break;
+		for(i=1;i<ALPHABETSIZE;i++) if( FMI_LetterJump(Index,i,n) != letterCounts[i] ) break;
 	}
 	if(n!=bwtSize){
 		printf(" FAILED (error at BWT position %u)\n",n);
@@ -1665,7 +2072,7 @@ void FMI_BuildIndex(char **inputTexts, unsigned int *inputTextSizes, unsigned in
 			}
 		}
 		numBackSteps = 0;
-		if( FMI_PositionInText(n) != textPos ) break;
+		if( FMI_PositionInText(fmi,n) != textPos ) break;
 		if( numBackSteps > longestRun ) longestRun = numBackSteps;
 		numRuns += numBackSteps;
 		if( ( n & SAMPLEINTERVALMASK ) == 0 ){ // if there is a sample at this BWT position, check text position
@@ -1675,12 +2082,12 @@ void FMI_BuildIndex(char **inputTexts, unsigned int *inputTextSizes, unsigned in
 		if(textPos==0) break;
 		textPos--;
 		letterId=GetTextCharId(textPos);
-		i=GetCharIdAtBWTPos(n);
+		i=GetCharIdAtBWTPos(Index,n);
 		if(letterId!=i) break; // check if it is the same letter at the BWT and at the text
 		if(i==0) break; // check if it is the terminator char because it should not be here
-		n = FMI_LetterJump(i,n); // follow the letter backwards to go to next position in the BWT
+		n = FMI_LetterJump(Index,i,n); // follow the letter backwards to go to next position in the BWT
 	}
-	if( textPos!=0 || FMI_PositionInText(n)!=0 || letterId!=i || i==0 || GetCharIdAtBWTPos(n)!=0 ){
+	if( textPos!=0 || FMI_PositionInText(fmi,n)!=0 || letterId!=i || i==0 || GetCharIdAtBWTPos(Index,n)!=0 ){
 		printf(" FAILED (error at text position %u)\n",textPos);
 		getchar();
 		exit(-1);
@@ -1693,4 +2100,16 @@ void FMI_BuildIndex(char **inputTexts, unsigned int *inputTextSizes, unsigned in
 	#endif
 	free(letterCounts);
 	free(letterStartPos);
+	if(multiStringTexts!=NULL){ // the texts are not needed anymore after building the index
+		free(multiStringLastChar);
+		free(multiStringFirstPos);
+		free(multiStringIdInBlock);
+		multiStringLastChar=NULL;
+		multiStringFirstPos=NULL;
+		multiStringIdInBlock=NULL;
+		multiStringTexts=NULL;
+	}
+	text = NULL;
+	Index = NULL; // the index blocks now belong to the index handle
+	return fmi;
 }
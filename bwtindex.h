@@ -1,10 +1,21 @@
-unsigned int FMI_PositionInText( unsigned int bwtpos );
-unsigned int FMI_FollowLetter( char c , unsigned int *topPointer , unsigned int *bottomPointer );
-unsigned int FMI_LeftJump( unsigned int bwtpos );
-char FMI_GetCharAtBWTPos( unsigned int bwtpos );
-void FMI_GetCharCountsAtBWTInterval( unsigned int topPtr , unsigned int bottomPtr , int *counts );
-void FMI_FreeIndex();
-void FMI_BuildIndex(char **inputTexts, unsigned int *inputTextSizes, unsigned int inputNumTexts, unsigned char **lcpArrayPointer, char verbose);
-unsigned int FMI_GetTextSize();
-unsigned int FMI_GetBWTSize();
-char *FMI_GetTextFilename();
+typedef struct _FMIndex FMIndex;
+
+unsigned int FMI_PositionInText( FMIndex *fmi , unsigned int bwtpos );
+unsigned int FMI_FollowLetter( FMIndex *fmi , char c , unsigned int *topPointer , unsigned int *bottomPointer );
+unsigned int FMI_ExtendBidirectionalInterval( FMIndex *fmi , char c , char forward , unsigned int *topPointer , unsigned int *revTopPointer , unsigned int *intervalSize );
+unsigned int FMI_LeftJump( FMIndex *fmi , unsigned int bwtpos );
+char FMI_GetCharAtBWTPos( FMIndex *fmi , unsigned int bwtpos );
+void FMI_GetCharCountsAtBWTInterval( FMIndex *fmi , unsigned int topPtr , unsigned int bottomPtr , int *counts );
+void FMI_FreeIndex( FMIndex *fmi );
+FMIndex *FMI_BuildIndex(char **inputTexts, unsigned int *inputTextSizes, unsigned int inputNumTexts, unsigned char **lcpArrayPointer, char verbose);
+size_t FMI_WriteIndex( FMIndex *fmi , FILE *indexFile );
+FMIndex *FMI_AttachIndex( char *indexData , size_t dataSize , size_t *usedSize );
+unsigned int FMI_StartLCPSamplesReader( unsigned int *numBigSamples );
+int FMI_GetNextLCPSample( unsigned int *bwtPos );
+char FMI_HasExactLCPs();
+unsigned int FMI_GetNumLCPOverflows();
+int FMI_GetLCPOverflow( unsigned int n , unsigned int *bwtPos );
+void FMI_FreeLCPSamples();
+unsigned int FMI_GetTextSize( FMIndex *fmi );
+unsigned int FMI_GetBWTSize( FMIndex *fmi );
+char *FMI_GetTextFilename();
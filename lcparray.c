@@ -15,11 +15,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <limits.h>
-#include "lcparray.h"
+#include <pthread.h>
 #include "bwtindex.h"
+#include "lcparray.h"
 
 //#define DEBUGLCP 1
 //#define BUILDLCP 1 // if we want to build the LCP array here or use the lcparray passed as argument
+#define PLCP_OVERSIZED_LCPS 1 // calculate the oversized LCPs by text order, using the lower bounds given by the permuted LCP array (PLCP)
+#define LCPINTERVALCACHEBITS 16 // number of entries (log2) of each cache of enclosing intervals
 
 #ifdef DEBUGLCP
 #include <sys/timeb.h>
@@ -56,6 +59,19 @@ typedef struct _SampledPosMarks {	// each block corresponds to 64 positions in t
 	unsigned int marksCount;		// number of set bits before this block
 } SampledPosMarks;
 
+typedef struct _LCPIntervalCacheEntry {	// enclosing (parent) interval of a source interval
+	unsigned int topPtr, bottomPtr;
+	unsigned int parentTopPtr, parentBottomPtr;
+	int parentDepth;
+} LCPIntervalCacheEntry;
+
+struct _LCPIntervalCache {					// direct-mapped cache of enclosing intervals (one for each matching thread)
+	SampledLCPArray *lcpArray;				// sampled LCP array whose intervals are cached
+	LCPIntervalCacheEntry *entries;
+	unsigned int mask;
+	long long int numHits, numMisses;
+};
+
 #ifdef DEBUGLCP
 // test data structure if a representation by intervals was used instead
 typedef struct _LCPIntervalTreeBlock {
@@ -74,14 +90,65 @@ typedef struct _IntPair {
 	};
 } IntPair;
 
-static unsigned int bwtLength;
-static SampledPosMarks *bwtMarkedPositions;
-static unsigned int numLCPSamples;
-static LCPSamplesBlock *sampledLCPArray;
-static LCPSamplesBlock *lastLCPSamplesBlock;
-static int numOversizedLCPs, numOversizedPLPs;
-static int *extraLCPvalues;
-static unsigned int *extraPLPvalues;
+typedef struct _CornerInfo {
+	unsigned int bwtPos;	// BWT position of the corner
+	unsigned int lcpPos;	// position of the corner in the sampled LCP array
+	int lcpValue;
+} CornerInfo;
+
+typedef struct _SLCPBuildRange {				// range of BWT blocks processed by each thread when building the sampled LCP array
+	int id;
+	unsigned int firstBwtBlock, endBwtBlock;
+	unsigned int firstSample, endSample;		// range of positions in the sampled LCP array
+	unsigned int firstBigSample;				// number of oversized LCP samples in all previous ranges
+	unsigned int numSamples, numBigSamples;
+	IntPair *bigLCPs;							// real values of the truncated LCPs in this range
+	int numBigLCPs;
+	#ifdef PLCP_OVERSIZED_LCPS
+	unsigned int *bigLCPsTextPos;				// text positions of the suffixes at and before each truncated LCP position
+	unsigned int firstOversizedInfo, endOversizedInfo;
+	#endif
+	IntPair *bigPLPs;							// oversized prefix links set in this range
+	int numBigPLPs, maxBigPLPs;
+	CornerInfo *topCorners, *bottomCorners;		// corners left open at the end of this range
+	int numTopCorners, maxTopCorners, numBottomCorners, maxBottomCorners;
+	CornerInfo *topEvents, *bottomEvents;		// operations on the corners left open by the previous ranges
+	int numTopEvents, maxTopEvents, numBottomEvents, maxBottomEvents;
+	long long int sumValues, maxValue;
+} SLCPBuildRange;
+
+#ifdef PLCP_OVERSIZED_LCPS
+typedef struct _OversizedLCPInfo {
+	unsigned int textPos;		// text position of the suffix at the BWT position of the truncated LCP
+	unsigned int prevTextPos;	// text position of the suffix at the BWT position above, i.e. Phi[textPos]
+	int *lcpValue;				// where to store the calculated LCP value
+} OversizedLCPInfo;
+#endif
+
+// NOTE: the query functions only read the arrays through this handle, so several arrays can be queried at the same time by multiple threads
+struct _SampledLCPArray {
+	unsigned int bwtLength;
+	SampledPosMarks *bwtMarkedPositions;
+	unsigned int numLCPSamples;
+	LCPSamplesBlock *sampledLCPArray;
+	LCPSamplesBlock *lastLCPSamplesBlock;
+	int numOversizedLCPs, numOversizedPLPs;
+	int *extraLCPvalues;
+	unsigned int *extraPLPvalues;
+	int isAttached; // if the arrays belong to a (shared) mapped index file instead of being allocated here
+};
+
+static SampledLCPArray *buildSLCP; // array being built (only one can be built at a time)
+static FMIndex *buildIndex; // FM-index of the text of the array being built
+static char *buildText;
+static unsigned int buildTextSize;
+static unsigned char *buildLCPArray;
+static SLCPBuildRange *buildRanges;
+static int numBuildRanges;
+static int buildVerbose;
+#ifdef PLCP_OVERSIZED_LCPS
+static OversizedLCPInfo *oversizedLCPsInfo;
+#endif
 
 #ifdef DEBUGLCP
 // for debugging
@@ -91,22 +158,113 @@ long long int numParentCalls = 0;
 long long int testNumCalls = 0;
 long long int testNumFollowedPos = 0;
 long long int testMaxFollowedPos = 0;
+static unsigned int numLcpIntervals;
+static unsigned int numBigTopLcps, numBigTopPlps, numBigTopSizes;
+static unsigned int numSharedTopCorners, avgSharedTopCornersCount, maxSharedTopCornersCount;
+static unsigned int *sharedTopCornersCount;
+static unsigned int numIncompleteLcpIntervals;
+static unsigned char *charsInsideInterval;
+static unsigned int numOversizedBothValues;
 #endif
 
-static unsigned long long int *offsetMasks64bits;
+// Masks to select all the bits at and before the offset = ((1ULL<<(offset+1))-1ULL)
+static const unsigned long long int offsetMasks64bits[64] = {
+	0x0000000000000001ULL, // lower 1 positions
+	0x0000000000000003ULL, // lower 2 positions
+	0x0000000000000007ULL, // lower 3 positions
+	0x000000000000000FULL, // lower 4 positions
+	0x000000000000001FULL, // lower 5 positions
+	0x000000000000003FULL, // lower 6 positions
+	0x000000000000007FULL, // lower 7 positions
+	0x00000000000000FFULL, // lower 8 positions
+	0x00000000000001FFULL, // lower 9 positions
+	0x00000000000003FFULL, // lower 10 positions
+	0x00000000000007FFULL, // lower 11 positions
+	0x0000000000000FFFULL, // lower 12 positions
+	0x0000000000001FFFULL, // lower 13 positions
+	0x0000000000003FFFULL, // lower 14 positions
+	0x0000000000007FFFULL, // lower 15 positions
+	0x000000000000FFFFULL, // lower 16 positions
+	0x000000000001FFFFULL, // lower 17 positions
+	0x000000000003FFFFULL, // lower 18 positions
+	0x000000000007FFFFULL, // lower 19 positions
+	0x00000000000FFFFFULL, // lower 20 positions
+	0x00000000001FFFFFULL, // lower 21 positions
+	0x00000000003FFFFFULL, // lower 22 positions
+	0x00000000007FFFFFULL, // lower 23 positions
+	0x0000000000FFFFFFULL, // lower 24 positions
+	0x0000000001FFFFFFULL, // lower 25 positions
+	0x0000000003FFFFFFULL, // lower 26 positions
+	0x0000000007FFFFFFULL, // lower 27 positions
+	0x000000000FFFFFFFULL, // lower 28 positions
+	0x000000001FFFFFFFULL, // lower 29 positions
+	0x000000003FFFFFFFULL, // lower 30 positions
+	0x000000007FFFFFFFULL, // lower 31 positions
+	0x00000000FFFFFFFFULL, // lower 32 positions
+	0x00000001FFFFFFFFULL, // lower 33 positions
+	0x00000003FFFFFFFFULL, // lower 34 positions
+	0x00000007FFFFFFFFULL, // lower 35 positions
+	0x0000000FFFFFFFFFULL, // lower 36 positions
+	0x0000001FFFFFFFFFULL, // lower 37 positions
+	0x0000003FFFFFFFFFULL, // lower 38 positions
+	0x0000007FFFFFFFFFULL, // lower 39 positions
+	0x000000FFFFFFFFFFULL, // lower 40 positions
+	0x000001FFFFFFFFFFULL, // lower 41 positions
+	0x000003FFFFFFFFFFULL, // lower 42 positions
+	0x000007FFFFFFFFFFULL, // lower 43 positions
+	0x00000FFFFFFFFFFFULL, // lower 44 positions
+	0x00001FFFFFFFFFFFULL, // lower 45 positions
+	0x00003FFFFFFFFFFFULL, // lower 46 positions
+	0x00007FFFFFFFFFFFULL, // lower 47 positions
+	0x0000FFFFFFFFFFFFULL, // lower 48 positions
+	0x0001FFFFFFFFFFFFULL, // lower 49 positions
+	0x0003FFFFFFFFFFFFULL, // lower 50 positions
+	0x0007FFFFFFFFFFFFULL, // lower 51 positions
+	0x000FFFFFFFFFFFFFULL, // lower 52 positions
+	0x001FFFFFFFFFFFFFULL, // lower 53 positions
+	0x003FFFFFFFFFFFFFULL, // lower 54 positions
+	0x007FFFFFFFFFFFFFULL, // lower 55 positions
+	0x00FFFFFFFFFFFFFFULL, // lower 56 positions
+	0x01FFFFFFFFFFFFFFULL, // lower 57 positions
+	0x03FFFFFFFFFFFFFFULL, // lower 58 positions
+	0x07FFFFFFFFFFFFFFULL, // lower 59 positions
+	0x0FFFFFFFFFFFFFFFULL, // lower 60 positions
+	0x1FFFFFFFFFFFFFFFULL, // lower 61 positions
+	0x3FFFFFFFFFFFFFFFULL, // lower 62 positions
+	0x7FFFFFFFFFFFFFFFULL, // lower 63 positions
+	0xFFFFFFFFFFFFFFFFULL  // lower 64 positions
+};
 #if !( defined(__GNUC__) && defined(__SSE4_2__) )
-static int *perByteCounts;
+// Number of bits set in each byte value
+static const int perByteCounts[256] = {
+	0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4, // 0x00-0x0F
+	1,2,2,3,2,3,3,4,2,3,3,4,3,4,4,5, // 0x10-0x1F
+	1,2,2,3,2,3,3,4,2,3,3,4,3,4,4,5, // 0x20-0x2F
+	2,3,3,4,3,4,4,5,3,4,4,5,4,5,5,6, // 0x30-0x3F
+	1,2,2,3,2,3,3,4,2,3,3,4,3,4,4,5, // 0x40-0x4F
+	2,3,3,4,3,4,4,5,3,4,4,5,4,5,5,6, // 0x50-0x5F
+	2,3,3,4,3,4,4,5,3,4,4,5,4,5,5,6, // 0x60-0x6F
+	3,4,4,5,4,5,5,6,4,5,5,6,5,6,6,7, // 0x70-0x7F
+	1,2,2,3,2,3,3,4,2,3,3,4,3,4,4,5, // 0x80-0x8F
+	2,3,3,4,3,4,4,5,3,4,4,5,4,5,5,6, // 0x90-0x9F
+	2,3,3,4,3,4,4,5,3,4,4,5,4,5,5,6, // 0xA0-0xAF
+	3,4,4,5,4,5,5,6,4,5,5,6,5,6,6,7, // 0xB0-0xBF
+	2,3,3,4,3,4,4,5,3,4,4,5,4,5,5,6, // 0xC0-0xCF
+	3,4,4,5,4,5,5,6,4,5,5,6,5,6,6,7, // 0xD0-0xDF
+	3,4,4,5,4,5,5,6,4,5,5,6,5,6,6,7, // 0xE0-0xEF
+	4,5,5,6,5,6,6,7,5,6,6,7,6,7,7,8  // 0xF0-0xFF
+};
 #endif
 
-void FreeSampledSuffixArray(){
-	free(offsetMasks64bits);
-	#if !( defined(__GNUC__) && defined(__SSE4_2__) )
-	free(perByteCounts);
-	#endif
-	free(bwtMarkedPositions);
-	free(sampledLCPArray);
-	free(extraLCPvalues);
-	free(extraPLPvalues);
+void FreeSampledSuffixArray(SampledLCPArray *slcp){
+	if( slcp == NULL ) return;
+	if(!(slcp->isAttached)){
+		free(slcp->bwtMarkedPositions);
+		free(slcp->sampledLCPArray);
+		free(slcp->extraLCPvalues);
+		free(slcp->extraPLPvalues);
+	}
+	free(slcp);
 #ifdef DEBUGLCP
 	printf(":: Number of parent calls = %lld\n",numParentCalls);
 #endif
@@ -116,10 +274,10 @@ static
 #ifndef DEBUGLCP
 __inline
 #endif
-unsigned int GetLcpPosFromBwtPos(unsigned int pos){
+unsigned int GetLcpPosFromBwtPos(SampledLCPArray *slcp, unsigned int pos){
 	SampledPosMarks *bwtBlock;
 	unsigned long long int bitsArray;
-	bwtBlock = &(bwtMarkedPositions[ (pos >> BWTBLOCKSHIFT) ]);
+	bwtBlock = &((slcp->bwtMarkedPositions)[ (pos >> BWTBLOCKSHIFT) ]);
 	bitsArray = (bwtBlock->bits) & offsetMasks64bits[ (pos & BWTBLOCKMASK) ]; // mask = ( 1<<(offset+1) - 1 ) = 0^(64-offset-1)1^(offset+1)
 	pos = (bwtBlock->marksCount); // the count is up to but NOT including the 0-th position
 	/*
@@ -159,14 +317,14 @@ static
 #ifndef DEBUGLCP
 __inline
 #endif
-int GetLcpValueFromLcpPos(unsigned int pos){
+int GetLcpValueFromLcpPos(SampledLCPArray *slcp, unsigned int pos){
 	LCPSamplesBlock *lcpBlock;
 	int lcp, extraPos;
-	lcpBlock = &(sampledLCPArray[ (pos >> BLOCKSHIFT) ]);
+	lcpBlock = &((slcp->sampledLCPArray)[ (pos >> BLOCKSHIFT) ]);
 	pos = (pos & BLOCKMASK);
 	lcp = (int)(lcpBlock->sourceLCP[pos]);
 	if( lcp != (int)UCHAR_MAX ) return lcp; // if not oversized value, return directly
-	if( (pos < BLOCKHALF) || (lcpBlock == lastLCPSamplesBlock) ){ // position in the 1st half of the block
+	if( (pos < BLOCKHALF) || (lcpBlock == (slcp->lastLCPSamplesBlock)) ){ // position in the 1st half of the block
 		extraPos = (lcpBlock->bigLCPsCount); // the count is up to but NOT including the 0-th position
 		pos++; // to include the 0-th position
 		while( pos ){
@@ -181,47 +339,47 @@ int GetLcpValueFromLcpPos(unsigned int pos){
 			pos++;
 		}
 	}
-	return extraLCPvalues[extraPos];
+	return (slcp->extraLCPvalues)[extraPos];
 }
 
-int GetLCP(unsigned int bwtpos){
-	unsigned int lcpPos = GetLcpPosFromBwtPos(bwtpos);
-	if( !(bwtMarkedPositions[(bwtpos>>BWTBLOCKSHIFT)].bits & (1ULL<<(bwtpos&BWTBLOCKMASK))) ) lcpPos++; // if the position is not marked, its LCP is equal to the one of the marked position ahead
-	return GetLcpValueFromLcpPos(lcpPos);
+int GetLCP(SampledLCPArray *slcp, unsigned int bwtpos){
+	unsigned int lcpPos = GetLcpPosFromBwtPos(slcp,bwtpos);
+	if( !((slcp->bwtMarkedPositions)[(bwtpos>>BWTBLOCKSHIFT)].bits & (1ULL<<(bwtpos&BWTBLOCKMASK))) ) lcpPos++; // if the position is not marked, its LCP is equal to the one of the marked position ahead
+	return GetLcpValueFromLcpPos(slcp,lcpPos);
 }
 
 /*
 int GetDepth(unsigned int lcpPos){
 	int lcp, nextlcp;
-	lcp = GetLcpValueFromLcpPos(lcpPos);
+	lcp = GetLcpValueFromLcpPos(slcp,lcpPos);
 	lcpPos++;
-	if( lcpPos == numLCPSamples ) return lcp;
-	nextlcp = GetLcpValueFromLcpPos(lcpPos);
+	if( lcpPos == (slcp->numLCPSamples) ) return lcp;
+	nextlcp = GetLcpValueFromLcpPos(slcp,lcpPos);
 	if( nextlcp > lcp ) return nextlcp;
 	return lcp;
 }
 */
 
-int IsTopCorner(unsigned int lcpPos){
-	return ( (lcpPos != (numLCPSamples-1)) && (GetLcpValueFromLcpPos(lcpPos) < GetLcpValueFromLcpPos(lcpPos+1)) );
+int IsTopCorner(SampledLCPArray *slcp, unsigned int lcpPos){
+	return ( (lcpPos != ((slcp->numLCPSamples)-1)) && (GetLcpValueFromLcpPos(slcp,lcpPos) < GetLcpValueFromLcpPos(slcp,lcpPos+1)) );
 }
 
 /*
 int IsBottomCorner(int lcpPos){
-	return ( (lcpPos == (numLCPSamples-1)) || (GetLcpValueFromLcpPos(lcpPos) > GetLcpValueFromLcpPos(lcpPos+1)) );
+	return ( (lcpPos == ((slcp->numLCPSamples)-1)) || (GetLcpValueFromLcpPos(slcp,lcpPos) > GetLcpValueFromLcpPos(slcp,lcpPos+1)) );
 }
 */
 
 /*
 // Retrieves the position in the full array (BWT) of a position in the sampled array, with the help of a closer known BWT position
-int GetBwtPosFromLcpPos(int lcpPos, int bwtPos){
+int GetBwtPosFromLcpPos(SampledLCPArray *slcp, int lcpPos, int bwtPos){
 	SampledPosMarks *bwtBlock;
 	unsigned long long int bitMask;
 	bwtPos = (bwtPos >> BWTBLOCKSHIFT); // block number
-	bwtBlock = &(bwtMarkedPositions[bwtPos]);
+	bwtBlock = &((slcp->bwtMarkedPositions)[bwtPos]);
 	bwtPos = (bwtPos << BWTBLOCKSHIFT); // position at the beginning of the block
 	if( lcpPos > (bwtBlock->marksCount) ){ // search down/ahead
-		while( (bwtPos < bwtLength) && ((bwtBlock->marksCount) < lcpPos) ){ // get the block with the cumulative lcp count closer to our lcp position
+		while( (bwtPos < (slcp->bwtLength)) && ((bwtBlock->marksCount) < lcpPos) ){ // get the block with the cumulative lcp count closer to our lcp position
 			bwtBlock++;
 			bwtPos += BWTBLOCKSIZE;
 		}
@@ -248,19 +406,19 @@ int GetBwtPosFromLcpPos(int lcpPos, int bwtPos){
 */
 
 // Retrieves the position in the full array (BWT) of a position in the sampled array
-unsigned int GetBwtPosFromLcpPos(unsigned int lcpPos){
+unsigned int GetBwtPosFromLcpPos(SampledLCPArray *slcp, unsigned int lcpPos){
 	LCPSamplesBlock *lcpBlock;
 	SampledPosMarks *bwtBlock;
 	unsigned long long int bitMask;
 	unsigned int bwtPos;
-	lcpBlock = &(sampledLCPArray[ (lcpPos >> BLOCKSHIFT) ]);
+	lcpBlock = &((slcp->sampledLCPArray)[ (lcpPos >> BLOCKSHIFT) ]);
 	bwtPos = (lcpBlock->baseBwtPos); // BWT pos of the first LCP in this LCP block
 	bwtPos = (bwtPos >> BWTBLOCKSHIFT); // BWT block number
-	bwtBlock = &(bwtMarkedPositions[bwtPos]); // BWT block of that pos
+	bwtBlock = &((slcp->bwtMarkedPositions)[bwtPos]); // BWT block of that pos
 	bwtPos = (bwtPos << BWTBLOCKSHIFT); // position at the beginning of the block
 	bwtBlock++; // check the lcp count of the next block
 	bwtPos += BWTBLOCKSIZE;
-	if( (bwtPos >= bwtLength) || ((bwtBlock->marksCount) >= lcpPos) ){ // if the BWT position we want is in the initial block
+	if( (bwtPos >= (slcp->bwtLength)) || ((bwtBlock->marksCount) >= lcpPos) ){ // if the BWT position we want is in the initial block
 		bwtBlock--;
 		bwtPos = (lcpBlock->baseBwtPos); // start searching on the already known position
 		lcpPos = (lcpPos & BLOCKMASK); // how many marked positions do we want ahead of that one
@@ -268,7 +426,7 @@ unsigned int GetBwtPosFromLcpPos(unsigned int lcpPos){
 		bwtPos++; // that position had a sample, but it's not the one we want, so start searching on the next position (it will never be on the next block, othewise we would have (nextBwtBlock->marksCount)<lcpPos)
 		bitMask = ( 1ULL << (bwtPos & BWTBLOCKMASK) ); // set the bit mask for our starting position inside the block
 	} else { // the LCP sample we want is in a BWT block further ahead
-		while( (bwtPos < bwtLength) && ((bwtBlock->marksCount) < lcpPos) ){ // get the block with the cumulative lcp count closer to our lcp position
+		while( (bwtPos < (slcp->bwtLength)) && ((bwtBlock->marksCount) < lcpPos) ){ // get the block with the cumulative lcp count closer to our lcp position
 			bwtBlock++;
 			bwtPos += BWTBLOCKSIZE;
 		}
@@ -291,25 +449,25 @@ unsigned int GetBwtPosFromLcpPos(unsigned int lcpPos){
 /*
 void SetPrefixLinkPointer(unsigned int sourceBwtPos, unsigned int destBwtPos){
 	unsigned int lcpPos;
-	lcpPos = GetLcpPosFromBwtPos(sourceBwtPos);
-	( (sampledLCPArray[(lcpPos >> BLOCKSHIFT)]).prefixLinkPointer )[(lcpPos & BLOCKMASK)] = destBwtPos;
+	lcpPos = GetLcpPosFromBwtPos(slcp,sourceBwtPos);
+	( ((slcp->sampledLCPArray)[(lcpPos >> BLOCKSHIFT)]).prefixLinkPointer )[(lcpPos & BLOCKMASK)] = destBwtPos;
 }
 */
 
 // TODO: add bwtPos as argument to function, if NULL then calculate inside
 // Retrieves the prefix link pointer from the specified Sampled LCP Array position
-unsigned int GetPrefixLinkFromLcpPos(unsigned int pos){
+unsigned int GetPrefixLinkFromLcpPos(SampledLCPArray *slcp, unsigned int pos){
 	LCPSamplesBlock *lcpBlock;
 	int distance, extraPos;
 	unsigned int bwtPos;
-	lcpBlock = &(sampledLCPArray[ (pos >> BLOCKSHIFT) ]);
+	lcpBlock = &((slcp->sampledLCPArray)[ (pos >> BLOCKSHIFT) ]);
 	distance = (int)(lcpBlock->prefixLinkPointer[ (pos & BLOCKMASK) ]);
 	if(distance != 0){ // if not oversized value, add distance to position
-		bwtPos = GetBwtPosFromLcpPos(pos);
+		bwtPos = GetBwtPosFromLcpPos(slcp,pos);
 		return (unsigned int)( bwtPos + distance );
 	}
 	pos = (pos & BLOCKMASK); // get the large value from the extra array
-	if( (pos < BLOCKHALF) || (lcpBlock == lastLCPSamplesBlock) ){ // position in the 1st half of the block
+	if( (pos < BLOCKHALF) || (lcpBlock == (slcp->lastLCPSamplesBlock)) ){ // position in the 1st half of the block
 		extraPos = (lcpBlock->bigPLPsCount); // the count is up to but NOT including the 0-th position
 		pos++; // to include the 0-th position
 		while( pos ){
@@ -324,10 +482,10 @@ unsigned int GetPrefixLinkFromLcpPos(unsigned int pos){
 			pos++;
 		}
 	}
-	return extraPLPvalues[extraPos]; // directly output the final destination pointer (not a differential distance)
+	return (slcp->extraPLPvalues)[extraPos]; // directly output the final destination pointer (not a differential distance)
 }
 
-int GetEnclosingLCPInterval(unsigned int *topptr, unsigned int *bottomptr){
+int GetEnclosingLCPInterval(SampledLCPArray *slcp, unsigned int *topptr, unsigned int *bottomptr){
 	unsigned int lcpPos;
 	int destDepth, n;
 	unsigned int destTopPtr, destBottomPtr;
@@ -336,13 +494,13 @@ int GetEnclosingLCPInterval(unsigned int *topptr, unsigned int *bottomptr){
 	numParentCalls++;
 	#endif
 	if( (*topptr) != (*bottomptr) ){ // non unitary interval, enlarge the interval using the LCP prefix links
-		lcpPos = GetLcpPosFromBwtPos((*topptr));
-		destTopPtr = GetPrefixLinkFromLcpPos(lcpPos);
-		destDepth = GetLcpValueFromLcpPos(lcpPos); // destination depth = max( LCP(top) , LCP(bottom+1) )
-		lcpPos = GetLcpPosFromBwtPos((*bottomptr));
-		destBottomPtr = GetPrefixLinkFromLcpPos(lcpPos);
+		lcpPos = GetLcpPosFromBwtPos(slcp,(*topptr));
+		destTopPtr = GetPrefixLinkFromLcpPos(slcp,lcpPos);
+		destDepth = GetLcpValueFromLcpPos(slcp,lcpPos); // destination depth = max( LCP(top) , LCP(bottom+1) )
+		lcpPos = GetLcpPosFromBwtPos(slcp,(*bottomptr));
+		destBottomPtr = GetPrefixLinkFromLcpPos(slcp,lcpPos);
 		lcpPos++;
-		if( lcpPos != numLCPSamples ) n = GetLcpValueFromLcpPos(lcpPos); // depth of the bottom prefix link
+		if( lcpPos != (slcp->numLCPSamples) ) n = GetLcpValueFromLcpPos(slcp,lcpPos); // depth of the bottom prefix link
 		else n = (-1);
 		if( destDepth >= n ){ // follow the link with the highest depth and leave the other pointer as it is
 			(*topptr) = destTopPtr;
@@ -355,65 +513,65 @@ int GetEnclosingLCPInterval(unsigned int *topptr, unsigned int *bottomptr){
 	} // else it is an interval with a single position
 	destTopPtr = UINT_MAX;
 	destBottomPtr = UINT_MAX;
-	if( (bwtMarkedPositions[((*topptr) >> BWTBLOCKSHIFT)].bits) & (1ULL << ((*topptr) & BWTBLOCKMASK)) ){ // if this is a marked LCP position
-		lcpPos = GetLcpPosFromBwtPos((*topptr));
-		if( IsTopCorner(lcpPos) ){ // top corner
+	if( ((slcp->bwtMarkedPositions)[((*topptr) >> BWTBLOCKSHIFT)].bits) & (1ULL << ((*topptr) & BWTBLOCKMASK)) ){ // if this is a marked LCP position
+		lcpPos = GetLcpPosFromBwtPos(slcp,(*topptr));
+		if( IsTopCorner(slcp,lcpPos) ){ // top corner
 			destTopPtr = (*topptr);
-			destDepth = GetLcpValueFromLcpPos(lcpPos+1); // source depth of top corner = LCP(i+1)
+			destDepth = GetLcpValueFromLcpPos(slcp,lcpPos+1); // source depth of top corner = LCP(i+1)
 		} else { // bottom corner
 			destBottomPtr = (*topptr);
-			destDepth = GetLcpValueFromLcpPos(lcpPos); // source depth of bottom corner = LCP(i)
+			destDepth = GetLcpValueFromLcpPos(slcp,lcpPos); // source depth of bottom corner = LCP(i)
 		}
 	} else { // this bwt pos is not marked by a LCP
-		lcpPos = GetLcpPosFromBwtPos((*topptr)); // it will get the closest LCP before/above this bwt pos
-		destDepth = GetLcpValueFromLcpPos(lcpPos+1); // source depth is in the next LCP
-		if( IsTopCorner(lcpPos) ) destTopPtr = GetBwtPosFromLcpPos(lcpPos); // top corner at the left
-		else destBottomPtr = GetPrefixLinkFromLcpPos(lcpPos); // if it's a bottom corner from an interval at the left, set our destination bottom corner
+		lcpPos = GetLcpPosFromBwtPos(slcp,(*topptr)); // it will get the closest LCP before/above this bwt pos
+		destDepth = GetLcpValueFromLcpPos(slcp,lcpPos+1); // source depth is in the next LCP
+		if( IsTopCorner(slcp,lcpPos) ) destTopPtr = GetBwtPosFromLcpPos(slcp,lcpPos); // top corner at the left
+		else destBottomPtr = GetPrefixLinkFromLcpPos(slcp,lcpPos); // if it's a bottom corner from an interval at the left, set our destination bottom corner
 		lcpPos++; // check the next/bellow corner
-		if( IsTopCorner(lcpPos) ){ // top corner at the right
-			if(destTopPtr==UINT_MAX) destTopPtr = GetPrefixLinkFromLcpPos(lcpPos); // use the prefix link at this top corner at the right to set our top corner
+		if( IsTopCorner(slcp,lcpPos) ){ // top corner at the right
+			if(destTopPtr==UINT_MAX) destTopPtr = GetPrefixLinkFromLcpPos(slcp,lcpPos); // use the prefix link at this top corner at the right to set our top corner
 			lcpPos--; // set the LCP pos to the last (possibly only) defined corner
 		} else { // bottom corner at the right
-			if(destBottomPtr==UINT_MAX) destBottomPtr = GetBwtPosFromLcpPos(lcpPos); // if it's a bottom corner, from an interval at the left, set our destination bottom corner
+			if(destBottomPtr==UINT_MAX) destBottomPtr = GetBwtPosFromLcpPos(slcp,lcpPos); // if it's a bottom corner, from an interval at the left, set our destination bottom corner
 		}
 	}
 	if( destTopPtr == UINT_MAX ){ // if we still need to get the top pointer
 		lcpPos--; // we are at the bottom pointer, so, go to the left/above
 		/*
-		while( (n=GetLcpValueFromLcpPos(lcpPos)) > destDepth ) lcpPos--; // get the pos at the left with the LCP lower or equal to ours
-		if( n < destDepth ) destTopPtr = GetBwtPosFromLcpPos(lcpPos); // this is the top pos
-		else destTopPtr = GetPrefixLinkFromLcpPos(lcpPos); // if it has the same LCP as ours, use its prefix link pointer
+		while( (n=GetLcpValueFromLcpPos(slcp,lcpPos)) > destDepth ) lcpPos--; // get the pos at the left with the LCP lower or equal to ours
+		if( n < destDepth ) destTopPtr = GetBwtPosFromLcpPos(slcp,lcpPos); // this is the top pos
+		else destTopPtr = GetPrefixLinkFromLcpPos(slcp,lcpPos); // if it has the same LCP as ours, use its prefix link pointer
 		*/
-		while( !IsTopCorner(lcpPos) ) lcpPos--; // find the first top corner above
-		if( GetLcpValueFromLcpPos(lcpPos) < destDepth ) destTopPtr = GetBwtPosFromLcpPos(lcpPos); // check if the first found top corner is already the one we want
+		while( !IsTopCorner(slcp,lcpPos) ) lcpPos--; // find the first top corner above
+		if( GetLcpValueFromLcpPos(slcp,lcpPos) < destDepth ) destTopPtr = GetBwtPosFromLcpPos(slcp,lcpPos); // check if the first found top corner is already the one we want
 		else { // keep following prefix links until we find a top corner with an LCP value lower than our destination LCP
-			destTopPtr = GetPrefixLinkFromLcpPos(lcpPos);
-			lcpPos = GetLcpPosFromBwtPos(destTopPtr);
-			while( GetLcpValueFromLcpPos(lcpPos) >= destDepth ){
-				destTopPtr = GetPrefixLinkFromLcpPos(lcpPos);
-				lcpPos = GetLcpPosFromBwtPos(destTopPtr);
+			destTopPtr = GetPrefixLinkFromLcpPos(slcp,lcpPos);
+			lcpPos = GetLcpPosFromBwtPos(slcp,destTopPtr);
+			while( GetLcpValueFromLcpPos(slcp,lcpPos) >= destDepth ){
+				destTopPtr = GetPrefixLinkFromLcpPos(slcp,lcpPos);
+				lcpPos = GetLcpPosFromBwtPos(slcp,destTopPtr);
 			}
 		}
 	} else if( destBottomPtr == UINT_MAX ){ // if we still need to get the bottom pointer
 		lcpPos++; // we are at the top pointer, so, go to the right/bellow
 		/*
-		if( lcpPos != numLCPSamples ) lcpPos++; // if we are not at the last position, go another position to the right
+		if( lcpPos != (slcp->numLCPSamples) ) lcpPos++; // if we are not at the last position, go another position to the right
 		n = -1; // set in case we were at the 2 last positions
-		while( (lcpPos < numLCPSamples) && ((n=GetLcpValueFromLcpPos(lcpPos)) > destDepth) ) lcpPos++; // get the pos at the right with the LCP lower or equal to ours
-		if( (n < destDepth) || (lcpPos == numLCPSamples) ) destBottomPtr = GetBwtPosFromLcpPos((lcpPos-1)); // the previous pos is the top pos
+		while( (lcpPos < (slcp->numLCPSamples)) && ((n=GetLcpValueFromLcpPos(slcp,lcpPos)) > destDepth) ) lcpPos++; // get the pos at the right with the LCP lower or equal to ours
+		if( (n < destDepth) || (lcpPos == (slcp->numLCPSamples)) ) destBottomPtr = GetBwtPosFromLcpPos(slcp,(lcpPos-1)); // the previous pos is the top pos
 		else { // if it has the same LCP as ours
-			if( IsTopCorner(lcpPos) ) destBottomPtr = GetPrefixLinkFromLcpPos(lcpPos-1);// if it's a top corner, use the prefix link of the prev pos, which is a bottom corner
-			else destBottomPtr = GetBwtPosFromLcpPos(lcpPos); // if it's a bottom corner, use it
+			if( IsTopCorner(slcp,lcpPos) ) destBottomPtr = GetPrefixLinkFromLcpPos(slcp,lcpPos-1);// if it's a top corner, use the prefix link of the prev pos, which is a bottom corner
+			else destBottomPtr = GetBwtPosFromLcpPos(slcp,lcpPos); // if it's a bottom corner, use it
 		}
 		*/
-		while( IsTopCorner(lcpPos) ) lcpPos++; // find the first bottom corner bellow
-		if( (lcpPos == numLCPSamples) || (GetLcpValueFromLcpPos(lcpPos+1) < destDepth) ) destBottomPtr = GetBwtPosFromLcpPos(lcpPos); // check if the first found bottom corner is already the one we want
+		while( IsTopCorner(slcp,lcpPos) ) lcpPos++; // find the first bottom corner bellow
+		if( (lcpPos == (slcp->numLCPSamples)) || (GetLcpValueFromLcpPos(slcp,lcpPos+1) < destDepth) ) destBottomPtr = GetBwtPosFromLcpPos(slcp,lcpPos); // check if the first found bottom corner is already the one we want
 		else {
-			destBottomPtr = GetPrefixLinkFromLcpPos(lcpPos); // keep following prefix links until we find a bottom corner that has a position ahead with an LCP value lower than our destination LCP
-			lcpPos = GetLcpPosFromBwtPos(destBottomPtr);
-			while( (lcpPos != (numLCPSamples-1)) && (GetLcpValueFromLcpPos(lcpPos+1) >= destDepth) ){
-				destBottomPtr = GetPrefixLinkFromLcpPos(lcpPos);
-				lcpPos = GetLcpPosFromBwtPos(destBottomPtr);
+			destBottomPtr = GetPrefixLinkFromLcpPos(slcp,lcpPos); // keep following prefix links until we find a bottom corner that has a position ahead with an LCP value lower than our destination LCP
+			lcpPos = GetLcpPosFromBwtPos(slcp,destBottomPtr);
+			while( (lcpPos != ((slcp->numLCPSamples)-1)) && (GetLcpValueFromLcpPos(slcp,lcpPos+1) >= destDepth) ){
+				destBottomPtr = GetPrefixLinkFromLcpPos(slcp,lcpPos);
+				lcpPos = GetLcpPosFromBwtPos(slcp,destBottomPtr);
 			}
 		}
 	}
@@ -422,6 +580,62 @@ int GetEnclosingLCPInterval(unsigned int *topptr, unsigned int *bottomptr){
 	return destDepth;
 }
 
+LCPIntervalCache *NewLCPIntervalCache(SampledLCPArray *slcp){
+	LCPIntervalCache *cache;
+	unsigned int i, n;
+	n = ( 1U << LCPINTERVALCACHEBITS );
+	cache = (LCPIntervalCache *)malloc(sizeof(LCPIntervalCache));
+	if( cache != NULL ) (cache->entries) = (LCPIntervalCacheEntry *)malloc(n*sizeof(LCPIntervalCacheEntry));
+	if( cache == NULL || (cache->entries) == NULL ){
+		printf("\n> ERROR: Not enough memory to create the intervals cache\n");
+		exit(-1);
+	}
+	for( i=0 ; i<n ; i++ ){
+		(cache->entries)[i].topPtr = UINT_MAX; // empty entry (no interval starts at that position)
+		(cache->entries)[i].bottomPtr = UINT_MAX;
+	}
+	(cache->lcpArray) = slcp;
+	(cache->mask) = ( n - 1 );
+	(cache->numHits) = 0;
+	(cache->numMisses) = 0;
+	return cache;
+}
+
+void FreeLCPIntervalCache(LCPIntervalCache *cache){
+	free(cache->entries);
+	free(cache);
+}
+
+void GetLCPIntervalCacheStats(LCPIntervalCache *cache, long long int *numhits, long long int *numlookups){
+	(*numhits) = (cache->numHits);
+	(*numlookups) = ( (cache->numHits) + (cache->numMisses) );
+}
+
+// Same as GetEnclosingLCPInterval, but first checks if the parent of this interval was already calculated and stored in the cache
+// NOTE: when matching closely related sequences, the same deep intervals are enlarged again and again, and each single position
+//  call can take tens of random accesses to the sampled LCP array, while the cache lookup takes only one
+// NOTE: non unitary intervals only need two prefix links, so they are not cached, or they would evict most of the useful entries
+int GetCachedEnclosingLCPInterval(LCPIntervalCache *cache, unsigned int *topptr, unsigned int *bottomptr){
+	LCPIntervalCacheEntry *entry;
+	int depth;
+	if( (*topptr) != (*bottomptr) ) return GetEnclosingLCPInterval((cache->lcpArray),topptr,bottomptr);
+	entry = &((cache->entries)[ ( ( ((*topptr) * 0x9E3779B1U) ^ ((*bottomptr) * 0x85EBCA77U) ) >> (32-LCPINTERVALCACHEBITS) ) & (cache->mask) ]);
+	if( (entry->topPtr) == (*topptr) && (entry->bottomPtr) == (*bottomptr) ){
+		(cache->numHits)++;
+		(*topptr) = (entry->parentTopPtr);
+		(*bottomptr) = (entry->parentBottomPtr);
+		return (entry->parentDepth);
+	}
+	(cache->numMisses)++;
+	(entry->topPtr) = (*topptr);
+	(entry->bottomPtr) = (*bottomptr);
+	depth = GetEnclosingLCPInterval((cache->lcpArray),topptr,bottomptr);
+	(entry->parentTopPtr) = (*topptr);
+	(entry->parentBottomPtr) = (*bottomptr);
+	(entry->parentDepth) = depth;
+	return depth;
+}
+
 /*
 unsigned int GetLCPValuePositionInsideLCPInterval(int lcpvalue, unsigned int topptr, unsigned int bottomptr){
 	unsigned int startlcppos, endlcppos;
@@ -431,21 +645,21 @@ unsigned int GetLCPValuePositionInsideLCPInterval(int lcpvalue, unsigned int top
 	testCount++;
 	testNumFollowedPos++;
 	#endif
-	endlcppos=GetLcpPosFromBwtPos(bottomptr);
-	if(GetLcpValueFromLcpPos(endlcppos)==lcpvalue) return endlcppos;
+	endlcppos=GetLcpPosFromBwtPos(slcp,bottomptr);
+	if(GetLcpValueFromLcpPos(slcp,endlcppos)==lcpvalue) return endlcppos;
 	#ifdef DEBUGLCP
 	testCount++;
 	testNumFollowedPos++;
 	#endif
-	startlcppos=GetLcpPosFromBwtPos(topptr);
+	startlcppos=GetLcpPosFromBwtPos(slcp,topptr);
 	startlcppos++;
-	if(GetLcpValueFromLcpPos(startlcppos)==lcpvalue) return startlcppos;
+	if(GetLcpValueFromLcpPos(slcp,startlcppos)==lcpvalue) return startlcppos;
 	for( (++startlcppos) ; startlcppos<endlcppos ; startlcppos++ ){
 		#ifdef DEBUGLCP
 		testCount++;
 		testNumFollowedPos++;
 		#endif
-		if(GetLcpValueFromLcpPos(startlcppos)==lcpvalue){
+		if(GetLcpValueFromLcpPos(slcp,startlcppos)==lcpvalue){
 			#ifdef DEBUGLCP
 			if(testCount>testMaxFollowedPos) testMaxFollowedPos=testCount;
 			#endif
@@ -458,37 +672,37 @@ unsigned int GetLCPValuePositionInsideLCPInterval(int lcpvalue, unsigned int top
 
 #ifdef DEBUGLCP
 // Get the interval whose depth is equal to the LCP value at lcpPos and that contains that BWT position
-int GetEnclosingLCPIntervalFromLCPPos(unsigned int lcpPos, unsigned int *topptr, unsigned int *bottomptr){
+int GetEnclosingLCPIntervalFromLCPPos(SampledLCPArray *slcp, unsigned int lcpPos, unsigned int *topptr, unsigned int *bottomptr){
 	int destDepth;
 	unsigned int destTopPtr, destBottomPtr;
 	destTopPtr = UINT_MAX;
 	destBottomPtr = UINT_MAX;
-	destDepth = GetLcpValueFromLcpPos(lcpPos);
-	if (IsTopCorner(lcpPos)){ // pos is a top corner
-		destTopPtr = GetPrefixLinkFromLcpPos(lcpPos); // the top corner of the interval is found by following the prefix link
+	destDepth = GetLcpValueFromLcpPos(slcp,lcpPos);
+	if (IsTopCorner(slcp,lcpPos)){ // pos is a top corner
+		destTopPtr = GetPrefixLinkFromLcpPos(slcp,lcpPos); // the top corner of the interval is found by following the prefix link
 		lcpPos++; // we are at the top pointer, so, go to the right/down
-		while (IsTopCorner(lcpPos)) lcpPos++; // find the first bottom corner bellow
-		if ((lcpPos == numLCPSamples) || (GetLcpValueFromLcpPos(lcpPos + 1) < destDepth)) destBottomPtr = GetBwtPosFromLcpPos(lcpPos); // check if the first found bottom corner is already the one we want
+		while (IsTopCorner(slcp,lcpPos)) lcpPos++; // find the first bottom corner bellow
+		if ((lcpPos == (slcp->numLCPSamples)) || (GetLcpValueFromLcpPos(slcp,lcpPos + 1) < destDepth)) destBottomPtr = GetBwtPosFromLcpPos(slcp,lcpPos); // check if the first found bottom corner is already the one we want
 		else {
-			destBottomPtr = GetPrefixLinkFromLcpPos(lcpPos); // keep following prefix links until we find a bottom corner that has a position ahead with an LCP value lower than our destination LCP
-			lcpPos = GetLcpPosFromBwtPos(destBottomPtr);
-			while ((lcpPos != (numLCPSamples - 1)) && (GetLcpValueFromLcpPos(lcpPos + 1) >= destDepth)){
-				destBottomPtr = GetPrefixLinkFromLcpPos(lcpPos);
-				lcpPos = GetLcpPosFromBwtPos(destBottomPtr);
+			destBottomPtr = GetPrefixLinkFromLcpPos(slcp,lcpPos); // keep following prefix links until we find a bottom corner that has a position ahead with an LCP value lower than our destination LCP
+			lcpPos = GetLcpPosFromBwtPos(slcp,destBottomPtr);
+			while ((lcpPos != ((slcp->numLCPSamples) - 1)) && (GetLcpValueFromLcpPos(slcp,lcpPos + 1) >= destDepth)){
+				destBottomPtr = GetPrefixLinkFromLcpPos(slcp,lcpPos);
+				lcpPos = GetLcpPosFromBwtPos(slcp,destBottomPtr);
 			}
 		}
 	}
 	else { // pos is a bottom corner
-		destBottomPtr = GetBwtPosFromLcpPos(lcpPos); // this is already the bottom corner of the interval
+		destBottomPtr = GetBwtPosFromLcpPos(slcp,lcpPos); // this is already the bottom corner of the interval
 		lcpPos--; // we are at the bottom pointer, so, go to the left/up
-		while (!IsTopCorner(lcpPos)) lcpPos--; // find the first top corner above
-		if (GetLcpValueFromLcpPos(lcpPos) < destDepth) destTopPtr = GetBwtPosFromLcpPos(lcpPos); // check if the first found top corner is already the one we want
+		while (!IsTopCorner(slcp,lcpPos)) lcpPos--; // find the first top corner above
+		if (GetLcpValueFromLcpPos(slcp,lcpPos) < destDepth) destTopPtr = GetBwtPosFromLcpPos(slcp,lcpPos); // check if the first found top corner is already the one we want
 		else { // keep following prefix links until we find a top corner with an LCP value lower than our destination LCP
-			destTopPtr = GetPrefixLinkFromLcpPos(lcpPos);
-			lcpPos = GetLcpPosFromBwtPos(destTopPtr);
-			while (GetLcpValueFromLcpPos(lcpPos) >= destDepth){
-				destTopPtr = GetPrefixLinkFromLcpPos(lcpPos);
-				lcpPos = GetLcpPosFromBwtPos(destTopPtr);
+			destTopPtr = GetPrefixLinkFromLcpPos(slcp,lcpPos);
+			lcpPos = GetLcpPosFromBwtPos(slcp,destTopPtr);
+			while (GetLcpValueFromLcpPos(slcp,lcpPos) >= destDepth){
+				destTopPtr = GetPrefixLinkFromLcpPos(slcp,lcpPos);
+				lcpPos = GetLcpPosFromBwtPos(slcp,destTopPtr);
 			}
 		}
 	}
@@ -501,7 +715,7 @@ int GetTrueDepth(unsigned int topptr, unsigned int bottomptr){
 	int depth; // non-singular interval: source depth = min( LCP[top+1] , LCP[bottom] )
 	depth=fullLCPArray[bottomptr];
 	topptr++;
-	if( topptr!=bwtLength ){
+	if( topptr!=(buildSLCP->bwtLength) ){
 		if( (++bottomptr)==topptr ){
 			if( fullLCPArray[topptr]>depth ) depth=fullLCPArray[topptr]; // single position: source depth = max( LCP[pos] , LCP[pos+1] )
 		} else {
@@ -515,16 +729,16 @@ int GetTrueEnclosingLCPInterval(unsigned int *topptr, unsigned int *bottomptr){
 	int destdepth; // destination (parent) depth = max( LCP[top] , LCP[bottom+1] )
 	destdepth=fullLCPArray[(*topptr)];
 	(*bottomptr)++;
-	if( (*bottomptr)!=bwtLength && fullLCPArray[(*bottomptr)]>destdepth ) destdepth=fullLCPArray[(*bottomptr)];
+	if( (*bottomptr)!=(buildSLCP->bwtLength) && fullLCPArray[(*bottomptr)]>destdepth ) destdepth=fullLCPArray[(*bottomptr)];
 	while( fullLCPArray[(*topptr)]>=destdepth ) (*topptr)--; // find closest pos above with an LCP value lower than this one
-	while( (*bottomptr)!=bwtLength && fullLCPArray[(*bottomptr)]>=destdepth) (*bottomptr)++; // find closest pos bellow with an LCP value lower than this one
+	while( (*bottomptr)!=(buildSLCP->bwtLength) && fullLCPArray[(*bottomptr)]>=destdepth) (*bottomptr)++; // find closest pos bellow with an LCP value lower than this one
 	(*bottomptr)--; // go back/up one pos
 	return destdepth;
 }
 
 int GetTrueEnclosingLCPIntervalWithLcpValue(int lcp, unsigned int *topptr, unsigned int *bottomptr){
 	while( (*topptr)!=0 && fullLCPArray[(*topptr)]>=lcp ) (*topptr)--; // find closest pos above with an LCP value lower than this one
-	while( (*bottomptr)!=bwtLength && fullLCPArray[(*bottomptr)]>=lcp) (*bottomptr)++; // find closest pos bellow with an LCP value lower than this one
+	while( (*bottomptr)!=(buildSLCP->bwtLength) && fullLCPArray[(*bottomptr)]>=lcp) (*bottomptr)++; // find closest pos bellow with an LCP value lower than this one
 	(*bottomptr)--; // go back/up one pos
 	return lcp;
 }
@@ -534,267 +748,370 @@ int CompareUnsignedIntPair(const void *a, const void * b){
 	return (int)( (((IntPair *)a)->pos) - (((IntPair *)b)->pos) );
 }
 
-// TODO: create function that combines returning both LCP and SV simultaneously or that accepts bwtPos as argument (to prevent unneeded calls)
-// TODO: get statistics for number of sampled positions (not intervals) with lcp<minlcp and that do not include all the chars of the alphabet in its BWT range
-// TODO: implement SLCP+SV as "lcp-interval-tree":
-//  - store info of top corners only
-//  - multiple entries if it's a shared top corner
-//  - check (parentDistance==0) to distinguish between new corner or next entry of same corner
-//  - lcp-value(s), interval size(s), distance(s) to parent interval's pos in BWT (if deep corner, parentDistance=0)
-//  - benchmark avg+max results for these 3 fields on large datasets
-int BuildSampledLCPArray(char *text, unsigned int textsize, unsigned char *lcparray, int minlcp, int verbose){
-	unsigned int textpos, prevtextpos;
-	char *topstring, *bottomstring;
-	#if !( defined(__GNUC__) && defined(__SSE4_2__) )
-	unsigned char byte;
-	#endif
-	unsigned int bwtpos, lcppos, i;
-	int k, lcp, prevlcp, nextlcp;
-	int numTopCorners, numBottomCorners;
-	int maxTopCorners, maxBottomCorners;
-	IntPair *topCorners, *bottomCorners;
-	IntPair *oversizedCorners;
-	unsigned long long int mask;
-	SampledPosMarks *bwtBlock;
-	LCPSamplesBlock *lcpBlock;
-	unsigned int maxNumLCPSamples;
-	int maxNumOversizedValues;
-	long long int sumValues;
-	long long int maxValue, prefixLinkDistance;
-	int progressCounter, progressStep;
-	#ifdef DEBUGLCP
-	unsigned int topptr, bottomptr;
-	unsigned int stopptr, sbottomptr;
-	struct timeb startTime, endTime;
-	double elapsedTime;
-	unsigned int numLcpIntervals;
-	unsigned int numBigTopLcps, numBigTopPlps, numBigTopSizes;
-	unsigned int numSharedTopCorners, avgSharedTopCornersCount, maxSharedTopCornersCount;
-	unsigned int *sharedTopCornersCount;
-	unsigned int numIncompleteLcpIntervals;
-	unsigned char *charsInsideInterval;
-	unsigned char bwtCharMask;
-	unsigned int numOversizedBothValues;
-	#endif
-	offsetMasks64bits = (unsigned long long int *)malloc(64*sizeof(unsigned long long int));
-	mask = 1ULL;
-	for(i=0;i<64;i++){
-		offsetMasks64bits[i] = mask;
-		mask <<= 1;
-		mask |= 1ULL;
+// Prints a progress dot every 10% of the range processed by the first thread
+#define PRINTRANGEPROGRESS(range) \
+	if( (range->id)==0 && buildVerbose ){ \
+		if(progressCounter==progressStep){ \
+			putchar('.'); \
+			fflush(stdout); \
+			progressCounter=0; \
+		} else progressCounter++; \
+	}
+
+#ifdef BUILDLCP
+#define ISTRUNCATEDLCP(bwtpos) (1)
+#else
+#define ISTRUNCATEDLCP(bwtpos) ( buildLCPArray[(bwtpos)] == UCHAR_MAX )
+#endif
+
+static
+__inline
+unsigned int GetRangeEndBwtPos(SLCPBuildRange *range){
+	unsigned int endpos;
+	endpos = ( (range->endBwtBlock) << BWTBLOCKSHIFT );
+	if( endpos > (buildSLCP->bwtLength) ) endpos = (buildSLCP->bwtLength);
+	return endpos;
+}
+
+// Adds a new element to the end of a dynamically allocated array of corners
+static void PushCorner(CornerInfo **corners, int *numcorners, int *maxcorners, unsigned int bwtpos, unsigned int lcppos, int lcpvalue){
+	if( (*numcorners) == (*maxcorners) ){
+		(*maxcorners) += 1024;
+		(*corners) = (CornerInfo *)realloc((*corners),(*maxcorners)*sizeof(CornerInfo));
+	}
+	(*corners)[(*numcorners)].bwtPos = bwtpos;
+	(*corners)[(*numcorners)].lcpPos = lcppos;
+	(*corners)[(*numcorners)].lcpValue = lcpvalue;
+	(*numcorners)++;
+}
+
+// Runs the given function over all the build ranges, each one in its own thread
+static void RunOnAllBuildRanges(void *(*rangefunction)(void *)){
+	pthread_t *threads;
+	int t;
+	if( numBuildRanges == 1 ){
+		rangefunction((void *)&(buildRanges[0]));
+		return;
 	}
-	#if !( defined(__GNUC__) && defined(__SSE4_2__) )
-	perByteCounts = (int *)malloc(256*sizeof(int));
-	for(i=0;i<256;i++){
-		k = 0;
-		byte = (unsigned char)i;
-		while( byte ){
-			k++;
-			byte &= ( byte - (unsigned char)1 );
+	threads = (pthread_t *)malloc(numBuildRanges*sizeof(pthread_t));
+	for( t=0 ; t<numBuildRanges ; t++ ){
+		if( pthread_create(&(threads[t]),NULL,rangefunction,(void *)&(buildRanges[t])) != 0 ){
+			printf("\n> ERROR: Failed to create thread #%d\n",(t+1));
+			exit(-1);
 		}
-		perByteCounts[i] = k;
 	}
+	for( t=0 ; t<numBuildRanges ; t++ ) pthread_join(threads[t],NULL);
+	free(threads);
+}
+
+#ifdef BUILDLCP
+#define MINOVERSIZEDLCP 0
+#else
+#define MINOVERSIZEDLCP ((int)UCHAR_MAX) // start checking matches 255 positions ahead
+#endif
+
+#ifdef PLCP_OVERSIZED_LCPS
+// Sorts the truncated LCPs info by the text position of their suffixes (radix sort with two 16 bit digits)
+static void SortOversizedLCPsInfo(OversizedLCPInfo *array, unsigned int n){
+	OversizedLCPInfo *temp, *src, *dest;
+	unsigned int *counts;
+	unsigned int i, c, sum, shift;
+	temp = (OversizedLCPInfo *)malloc(n*sizeof(OversizedLCPInfo));
+	counts = (unsigned int *)malloc(65536*sizeof(unsigned int));
+	if( temp==NULL || counts==NULL ){
+		printf("\n> ERROR: Not enough memory to sort the oversized LCPs\n");
+		exit(-1);
+	}
+	src = array;
+	dest = temp;
+	for( shift=0 ; shift<32 ; shift+=16 ){
+		for( c=0 ; c<65536 ; c++ ) counts[c] = 0;
+		for( i=0 ; i<n ; i++ ) counts[ ((src[i].textPos) >> shift) & 0xFFFF ]++;
+		sum = 0;
+		for( c=0 ; c<65536 ; c++ ){
+			i = counts[c];
+			counts[c] = sum;
+			sum += i;
+		}
+		for( i=0 ; i<n ; i++ ) dest[ counts[ ((src[i].textPos) >> shift) & 0xFFFF ]++ ] = src[i];
+		src = dest;
+		dest = ( (dest==temp) ? array : temp );
+	}
+	free(counts);
+	free(temp); // after an even number of passes the sorted values are back in the original array
+}
+
+// Calculates the real values of the truncated LCPs in this range of the text ordered array
+// NOTE: since PLCP[i+k] >= PLCP[i]-k , the LCP of each suffix does not need to be checked from the start, but only from where the
+//  the lower bound given by the previous suffix in text order ends
+static void *CalculateOversizedLCPsInRange(void *arg){
+	SLCPBuildRange *range;
+	OversizedLCPInfo *info;
+	unsigned int n, textpos, prevtextpos, maxtextpos, lasttextpos;
+	long long int lcp, lastlcp;
+	range = (SLCPBuildRange *)arg;
+	lasttextpos = 0;
+	lastlcp = 0;
+	for( n=(range->firstOversizedInfo) ; n<(range->endOversizedInfo) ; n++ ){
+		info = &(oversizedLCPsInfo[n]);
+		textpos = (info->textPos);
+		prevtextpos = (info->prevTextPos);
+		maxtextpos = ( (textpos>prevtextpos) ? textpos : prevtextpos ); // use to check when we reach the end of the text
+		lcp = ( lastlcp - (long long int)(textpos-lasttextpos) ); // lower bound given by the last calculated suffix
+		if( lcp < MINOVERSIZEDLCP ) lcp = MINOVERSIZEDLCP;
+		while( ( (maxtextpos+lcp) < buildTextSize ) && ( buildText[(prevtextpos+lcp)] == buildText[(textpos+lcp)] ) ) lcp++;
+		(*(info->lcpValue)) = (int)lcp;
+		lasttextpos = textpos;
+		lastlcp = lcp;
+	}
+	return NULL;
+}
+#endif
+
+// Calculates the real values of all the truncated (255) LCPs inside this range of BWT positions
+// NOTE: with PLCP_OVERSIZED_LCPS, only the text positions of both suffixes are collected here, and the values are calculated later
+static void *CollectOversizedLCPsInRange(void *arg){
+	SLCPBuildRange *range;
+	unsigned int bwtpos, endpos, textpos, prevtextpos;
+	int maxbiglcps;
+	int progressCounter, progressStep;
+	#ifdef PLCP_OVERSIZED_LCPS
+	unsigned int lastbwtpos;
+	#else
+	char *topstring, *bottomstring;
+	int lcp;
 	#endif
-	bwtLength = (textsize+1);
-	k = (((bwtLength-1)>>BWTBLOCKSHIFT)+1); // last valid pos, quotient, add one
-	bwtMarkedPositions = (SampledPosMarks *)malloc(k*sizeof(SampledPosMarks));
-	sampledLCPArray = (LCPSamplesBlock *)malloc(1*sizeof(LCPSamplesBlock));
-	extraLCPvalues = (int *)malloc(1*sizeof(int));
-	#ifdef BUILDLCP
-	lcparray = NULL; // to fix compiler unused variable warning
-	#endif
-	if(verbose){ printf("> Building Sampled LCP Array "); fflush(stdout); }
-	sumValues=0;
-	maxValue=0;
-	#ifdef DEBUGLCP
-	fullLCPArray=(int *)malloc(bwtLength*sizeof(int));
-	fullLCPArray[0]=(-1);
+	range = (SLCPBuildRange *)arg;
+	bwtpos = ( (range->firstBwtBlock) << BWTBLOCKSHIFT );
+	endpos = GetRangeEndBwtPos(range);
+	progressStep = ((endpos-bwtpos)/10);
+	progressCounter = 0;
+	range->bigLCPs = NULL;
+	range->numBigLCPs = 0;
+	maxbiglcps = 0;
+	#ifdef PLCP_OVERSIZED_LCPS
+	range->bigLCPsTextPos = NULL;
+	lastbwtpos = 0;
+	textpos = 0;
 	#endif
-	progressStep=(bwtLength/10);
-	progressCounter=0;
-	k=(-1); // current bwt block id
-	bwtBlock=&(bwtMarkedPositions[0]); // first bwt block
-	mask=0ULL; // current position mask inside the current bwt block
-	lcpBlock=&(sampledLCPArray[0]); // current lcp block
-	numLCPSamples=0;
-	lastLCPSamplesBlock=0;
-	numOversizedLCPs=0;
-	maxNumLCPSamples=0;
-	maxNumOversizedValues=0;
-	prevlcp=(-1); // at the 0-th position there's no position before
-	prevtextpos=textsize; // the 0-th BWT position corresponds to the terminator symbol at the last text position
-	textpos=0;
-	for(bwtpos=1;bwtpos<=bwtLength;bwtpos++){ // all BWT positions and one fake next-to-last position to fill last position
-		if(verbose){
-			if(progressCounter==progressStep){ // print progress dots
-				putchar('.');
-				fflush(stdout);
-				progressCounter=0;
-			} else progressCounter++;
+	if( bwtpos == 0 ) bwtpos = 1; // the 0-th position has no position before
+	for( ; bwtpos<endpos ; bwtpos++ ){
+		PRINTRANGEPROGRESS(range);
+		if( !ISTRUNCATEDLCP(bwtpos) ) continue;
+		#ifdef PLCP_OVERSIZED_LCPS
+		if( (lastbwtpos+1) == bwtpos && lastbwtpos != 0 ) prevtextpos = textpos; // in runs of truncated LCPs, each suffix is only located once
+		else prevtextpos = FMI_PositionInText(buildIndex,(bwtpos-1));
+		textpos = FMI_PositionInText(buildIndex,bwtpos);
+		lastbwtpos = bwtpos;
+		if( (range->numBigLCPs) == maxbiglcps ){
+			maxbiglcps += 1024;
+			range->bigLCPs = (IntPair *)realloc((range->bigLCPs),maxbiglcps*sizeof(IntPair));
+			range->bigLCPsTextPos = (unsigned int *)realloc((range->bigLCPsTextPos),2*maxbiglcps*sizeof(unsigned int));
 		}
-		if(bwtpos!=bwtLength){
-			#ifdef BUILDLCP
-			textpos=FMI_PositionInText(bwtpos);
-			topstring=(char *)(text+prevtextpos);
-			bottomstring=(char *)(text+textpos);
-			lcp=0;
-			if(textpos>prevtextpos) prevtextpos=textpos; // use this temporary variable to check when we reach the end of the text, because the '\0' terminator might not be present
-			while(((*topstring)==(*bottomstring)) && (prevtextpos!=textsize)){
-				topstring++;
-				bottomstring++;
-				lcp++;
-				prevtextpos++;
-			}
-			#else
-			lcp = (int)lcparray[bwtpos];
-			if( lcp == (int)UCHAR_MAX ){ // if it is a large (>255) lcp, calculate its value
-				prevtextpos=FMI_PositionInText((bwtpos-1));
-				textpos=FMI_PositionInText(bwtpos);
-				topstring=(char *)( text + prevtextpos + (unsigned int)UCHAR_MAX ); // start checking matches 255 positions ahead
-				bottomstring=(char *)( text + textpos + (unsigned int)UCHAR_MAX );
-				if(textpos>prevtextpos) prevtextpos=textpos; // use to check when we reach the end of the text, because the '\0' terminator might not be present
-				while(((*topstring)==(*bottomstring)) && (prevtextpos!=textsize)){
-					topstring++;
-					bottomstring++;
-					lcp++;
-					prevtextpos++;
-				}
-			}
-			#endif
-			#ifdef DEBUGLCP
-			fullLCPArray[bwtpos]=lcp; // longest common prefix between positions (bwtpos) and (bwtpos-1)
-			#endif
-		} else lcp=(-1); // fake next-to-last position
-		sumValues+=lcp;
-		if(lcp>maxValue) maxValue=lcp;
-		if(mask==0ULL){ // advance to new block
-			k++;
-			if(k!=0) bwtBlock++; // k starts at -1 and we already have the 0-th block loaded
-			(bwtBlock->bits)=0ULL; // reset block
-			(bwtBlock->marksCount)=(numLCPSamples-1); // the 0-th block is initialized with (-1) here
-			mask=1ULL; // in the bit array, this is the position of (bwtpos-1); it will only be incremented at the end of the loop
+		range->bigLCPs[(range->numBigLCPs)].pos = bwtpos;
+		range->bigLCPsTextPos[(2*(range->numBigLCPs))] = textpos;
+		range->bigLCPsTextPos[(2*(range->numBigLCPs)+1)] = prevtextpos;
+		(range->numBigLCPs)++;
+		#else
+		prevtextpos = FMI_PositionInText(buildIndex,(bwtpos-1));
+		textpos = FMI_PositionInText(buildIndex,bwtpos);
+		lcp = MINOVERSIZEDLCP;
+		topstring = (char *)( buildText + prevtextpos + (unsigned int)lcp );
+		bottomstring = (char *)( buildText + textpos + (unsigned int)lcp );
+		if(textpos>prevtextpos) prevtextpos=textpos; // use to check when we reach the end of the text, because the '\0' terminator might not be present
+		while(((*topstring)==(*bottomstring)) && (prevtextpos!=buildTextSize)){
+			topstring++;
+			bottomstring++;
+			lcp++;
+			prevtextpos++;
 		}
-		if(lcp!=prevlcp){ // set lcp (in the sampled LCP array) of previous position, (bwtpos-1)
-			(bwtBlock->bits) |= mask; // mark position (bwtpos-1) as having a sample
-			if((numLCPSamples & BLOCKMASK)==0){ // create new lcp block if needed
-				if(numLCPSamples==maxNumLCPSamples){
-					maxNumLCPSamples += ( (textsize/10) & (~BLOCKMASK) ); // alloc 10% of the text size extra samples each time, and aligned to the block size
-					sampledLCPArray = (LCPSamplesBlock *)realloc(sampledLCPArray,((maxNumLCPSamples >> BLOCKSHIFT)+1)*sizeof(LCPSamplesBlock));
-				}
-				lcpBlock=&(sampledLCPArray[(numLCPSamples >> BLOCKSHIFT)]); // lcpBlock++ would not work because the memory was re-allocated
-				(lcpBlock->bigLCPsCount)=(numOversizedLCPs-1);
-				(lcpBlock->baseBwtPos)=(bwtpos-1);
+		if( (range->numBigLCPs) == maxbiglcps ){
+			maxbiglcps += 1024;
+			range->bigLCPs = (IntPair *)realloc((range->bigLCPs),maxbiglcps*sizeof(IntPair));
+		}
+		range->bigLCPs[(range->numBigLCPs)].pos = bwtpos;
+		range->bigLCPs[(range->numBigLCPs)].lcpvalue = lcp;
+		(range->numBigLCPs)++;
+		#endif
+	}
+	return NULL;
+}
+
+// Marks the BWT positions whose LCP differs from the next one, and counts the number of (oversized) samples in this range
+static void *MarkLCPSamplesInRange(void *arg){
+	SLCPBuildRange *range, *nextrange;
+	SampledPosMarks *bwtBlock;
+	unsigned long long int mask;
+	unsigned int bwtpos, endpos;
+	int lcp, nextlcp, bigpos;
+	range = (SLCPBuildRange *)arg;
+	bwtpos = ( (range->firstBwtBlock) << BWTBLOCKSHIFT );
+	endpos = GetRangeEndBwtPos(range);
+	range->numSamples = 0;
+	range->numBigSamples = 0;
+	range->sumValues = 0;
+	range->maxValue = 0;
+	bigpos = 0;
+	if( bwtpos == 0 ) lcp = (-1); // at the 0-th position there's no position before
+	else if( ISTRUNCATEDLCP(bwtpos) ) lcp = range->bigLCPs[bigpos++].lcpvalue;
+	else lcp = (int)buildLCPArray[bwtpos];
+	bwtBlock = NULL;
+	mask = 0ULL;
+	for( ; bwtpos<endpos ; bwtpos++ ){
+		if( (bwtpos & BWTBLOCKMASK) == 0 ){ // advance to new block
+			bwtBlock = &((buildSLCP->bwtMarkedPositions)[(bwtpos >> BWTBLOCKSHIFT)]);
+			(bwtBlock->bits) = 0ULL;
+			mask = 1ULL;
+		}
+		if( (bwtpos+1) == (buildSLCP->bwtLength) ) nextlcp = (-1); // fake next-to-last position
+		else if( (bwtpos+1) == endpos ){ // the next position belongs to the next range
+			nextrange = (range+1);
+			if( ISTRUNCATEDLCP(endpos) ) nextlcp = nextrange->bigLCPs[0].lcpvalue;
+			else nextlcp = (int)buildLCPArray[endpos];
+		}
+		else if( ISTRUNCATEDLCP(bwtpos+1) ) nextlcp = range->bigLCPs[bigpos++].lcpvalue;
+		else nextlcp = (int)buildLCPArray[(bwtpos+1)];
+		#ifdef DEBUGLCP
+		if( (bwtpos+1) != (buildSLCP->bwtLength) ) fullLCPArray[(bwtpos+1)] = nextlcp; // longest common prefix between positions (bwtpos+1) and (bwtpos)
+		#endif
+		range->sumValues += nextlcp;
+		if( nextlcp > range->maxValue ) range->maxValue = nextlcp;
+		if( nextlcp != lcp ){ // the LCP at this position will be sampled
+			(bwtBlock->bits) |= mask;
+			(range->numSamples)++;
+			if( lcp == (-1) || lcp >= UCHAR_MAX ) (range->numBigSamples)++;
+		}
+		mask <<= 1;
+		lcp = nextlcp;
+	}
+	return NULL;
+}
+
+// Stores the LCP samples of this range in their final positions, already known from the counts of the previous ranges
+static void *StoreLCPSamplesInRange(void *arg){
+	SLCPBuildRange *range;
+	SampledPosMarks *bwtBlock;
+	LCPSamplesBlock *lcpBlock;
+	unsigned long long int mask;
+	unsigned int bwtpos, endpos, lcppos, bigsample;
+	int lcp, bigpos;
+	range = (SLCPBuildRange *)arg;
+	bwtpos = ( (range->firstBwtBlock) << BWTBLOCKSHIFT );
+	endpos = GetRangeEndBwtPos(range);
+	lcppos = (range->firstSample);
+	bigsample = (range->firstBigSample);
+	bigpos = 0;
+	bwtBlock = NULL;
+	mask = 0ULL;
+	for( ; bwtpos<endpos ; bwtpos++ ){
+		if( (bwtpos & BWTBLOCKMASK) == 0 ){ // advance to new block
+			bwtBlock = &((buildSLCP->bwtMarkedPositions)[(bwtpos >> BWTBLOCKSHIFT)]);
+			(bwtBlock->marksCount) = (lcppos-1); // the 0-th block is initialized with (-1) here
+			mask = 1ULL;
+		}
+		if( bwtpos == 0 ) lcp = (-1);
+		else if( ISTRUNCATEDLCP(bwtpos) ) lcp = range->bigLCPs[bigpos++].lcpvalue;
+		else lcp = (int)buildLCPArray[bwtpos];
+		if( (bwtBlock->bits) & mask ){
+			lcpBlock = &((buildSLCP->sampledLCPArray)[(lcppos >> BLOCKSHIFT)]);
+			if( (lcppos & BLOCKMASK) == 0 ){ // new lcp block
+				(lcpBlock->bigLCPsCount) = (int)(bigsample-1);
+				(lcpBlock->baseBwtPos) = bwtpos;
 			}
-			if(prevlcp!=(-1) && prevlcp<UCHAR_MAX) (lcpBlock->sourceLCP)[(numLCPSamples & BLOCKMASK)]=(unsigned char)prevlcp;
+			if( lcp != (-1) && lcp < UCHAR_MAX ) (lcpBlock->sourceLCP)[(lcppos & BLOCKMASK)] = (unsigned char)lcp;
 			else { // store oversized lcps in a separate array
-				(lcpBlock->sourceLCP)[(numLCPSamples & BLOCKMASK)]=UCHAR_MAX;
-				if(numOversizedLCPs==maxNumOversizedValues){
-					maxNumOversizedValues += (textsize/200); // alloc 0.5% of the text size extra samples each time
-					extraLCPvalues=(int *)realloc(extraLCPvalues,(maxNumOversizedValues+1)*sizeof(int));
-				}
-				extraLCPvalues[numOversizedLCPs]=prevlcp;
-				numOversizedLCPs++;
+				(lcpBlock->sourceLCP)[(lcppos & BLOCKMASK)] = UCHAR_MAX;
+				(buildSLCP->extraLCPvalues)[bigsample] = lcp;
+				bigsample++;
 			}
-			numLCPSamples++;
+			lcppos++;
 		}
 		mask <<= 1;
-		prevlcp=lcp;
-		prevtextpos=textpos;
-	}
-	sampledLCPArray = (LCPSamplesBlock *)realloc(sampledLCPArray,((numLCPSamples >> BLOCKSHIFT)+1)*sizeof(LCPSamplesBlock));
-	extraLCPvalues=(int *)realloc(extraLCPvalues,numOversizedLCPs*sizeof(int)); // shrink the allocated arrays to fit the final number of samples
-	lastLCPSamplesBlock = &(sampledLCPArray[(numLCPSamples >> BLOCKSHIFT)]);
-	if(verbose){
-		printf(" OK\n");
-		printf(":: %.2lf%% samples (%u of %u)\n",((double)numLCPSamples/(double)bwtLength)*100.0,numLCPSamples,bwtLength);
-		printf(":: %.2lf%% oversized samples (%d of %u)\n",((double)numOversizedLCPs/(double)numLCPSamples)*100.0,numOversizedLCPs,numLCPSamples);
-		printf(":: Average LCP value = %d (max=%lld)\n",(int)(sumValues/(long long int)bwtLength),maxValue);
 	}
+	free(range->bigLCPs); // not needed anymore
+	range->bigLCPs = NULL;
+	return NULL;
+}
+
+// Links the LCP sample at position lcppos (and at BWT position srcbwtpos) to the BWT position of its previous/next smaller value
+static long long int SetPrefixLink(SLCPBuildRange *range, unsigned int lcppos, unsigned int srcbwtpos, unsigned int destbwtpos){
+	LCPSamplesBlock *lcpBlock;
+	long long int prefixLinkDistance;
+	lcpBlock = &((buildSLCP->sampledLCPArray)[(lcppos >> BLOCKSHIFT)]);
 	#ifdef DEBUGLCP
-	if(verbose){ printf("> Testing Sampled LCP Array "); fflush(stdout); }
-	ftime(&startTime);
-	i=0;
-	for(bwtpos=0;bwtpos<bwtLength;bwtpos++){
-		if(verbose){
-			if(progressCounter==progressStep){ // print progress dots
-				putchar('.');
-				fflush(stdout);
-				progressCounter=0;
-			} else progressCounter++;
-		}
-		if(GetLCP(bwtpos)!=fullLCPArray[bwtpos]) break;
-		if(((bwtpos+1)==bwtLength) || (fullLCPArray[bwtpos]!=fullLCPArray[bwtpos+1])){ // only check marked positions
-			i=GetLcpPosFromBwtPos(bwtpos);
-			if(GetBwtPosFromLcpPos(i)!=bwtpos) break;
-		}
-	}
-	if((bwtpos==bwtLength) && (i==(numLCPSamples-1))){
-		ftime(&endTime);
-		elapsedTime = ( ((endTime.time) + (endTime.millitm)/1000.0) - ((startTime.time) + (startTime.millitm)/1000.0) );
-		if(verbose){
-			printf(" OK\n");
-			printf(":: Done in %.3lf seconds\n",elapsedTime);
+	fullPLPArray[lcppos] = destbwtpos;
+	#endif
+	prefixLinkDistance = ( (long long int)destbwtpos - (long long int)srcbwtpos ); // =(destination-source)
+	if( (prefixLinkDistance>(-128)) && (prefixLinkDistance<128) ) (lcpBlock->prefixLinkPointer)[(lcppos & BLOCKMASK)] = (signed char)prefixLinkDistance;
+	else { // if value is <=(-128) or >=(+128) store it in the extra array
+		(lcpBlock->prefixLinkPointer)[(lcppos & BLOCKMASK)] = 0; // mark as oversized corner prefix link
+		#ifdef DEBUGLCP
+		if((lcpBlock->sourceLCP[(lcppos & BLOCKMASK)])==UCHAR_MAX) numOversizedBothValues++;
+		#endif
+		if( (range->numBigPLPs) == (range->maxBigPLPs) ){
+			(range->maxBigPLPs) += 1024;
+			range->bigPLPs = (IntPair *)realloc((range->bigPLPs),(range->maxBigPLPs)*sizeof(IntPair));
 		}
+		range->bigPLPs[(range->numBigPLPs)].pos = lcppos;
+		range->bigPLPs[(range->numBigPLPs)].distvalue = destbwtpos;
+		(range->numBigPLPs)++;
 	}
-	else printf("\n> ERROR: sampledLCP[%u]=%d =!= fullLCP[%u]=%d (bwtPos=%u->lcpPos=%d->bwtPos=%d) \n",bwtpos,GetLCP(bwtpos),bwtpos,fullLCPArray[bwtpos],bwtpos,i,GetBwtPosFromLcpPos(i));
-	#endif
-	if(verbose){ printf("> Collecting Previous/Next Smaller Values "); fflush(stdout); }
+	if(prefixLinkDistance<0) prefixLinkDistance=(-prefixLinkDistance);
+	if(prefixLinkDistance>(range->maxValue)) (range->maxValue)=prefixLinkDistance;
+	(range->sumValues)+=prefixLinkDistance;
+	return prefixLinkDistance;
+}
+
+// Links the corners of this range to their previous/next smaller values; the corners that need values outside this range are kept in the
+//  corners lists and in the events lists, to be processed later in order
+// NOTE: a top event with (lcpPos!=UINT_MAX) is a query for the last open top corner, and with (lcpPos==UINT_MAX) it is the removal of all
+//  the top corners with (lcpValue>=v) ; a bottom event is the removal (and linking to bwtPos) of all the bottom corners with (lcpValue>v)
+static void *CollectSmallerValuesInRange(void *arg){
+	SLCPBuildRange *range;
+	SampledPosMarks *bwtBlock;
+	unsigned long long int mask;
+	unsigned int bwtpos, lcppos;
+	int k, lcp, nextlcp;
+	int progressCounter, progressStep;
 	#ifdef DEBUGLCP
-	fullPLPArray=(unsigned int *)malloc(numLCPSamples*sizeof(unsigned int));
-	fullPLPArray[0]=0;
-	fullPLPArray[(numLCPSamples-1)]=(bwtLength-1);
+	long long int prefixLinkDistance;
+	unsigned char bwtCharMask;
+	unsigned int i;
 	#endif
-	progressStep=(numLCPSamples/10);
-	progressCounter=0;
-	maxNumOversizedValues=((numLCPSamples/100)+1); // allocate 1% of the total number of sampled values
-	oversizedCorners=(IntPair *)malloc((maxNumOversizedValues+1)*sizeof(IntPair)); // +1 above if textsize is <100 and value above gives 0 ; +1 here because last pos numOversizedPLPs=1 will be used later
-	sampledLCPArray[0].prefixLinkPointer[0]=0; // set value for first pos
-	//sampledLCPArray[0].bigPLPsCount=(-1); // this will be set later together with all the other values
-	oversizedCorners[0].pos=0;
-	oversizedCorners[0].distvalue=0;
-	numOversizedPLPs=1; // first value already set
-	sumValues=0;
-	maxValue=0;
-	maxTopCorners=1;
-	maxBottomCorners=1;
-	topCorners=(IntPair *)malloc(maxTopCorners*sizeof(IntPair));
-	bottomCorners=(IntPair *)malloc(maxBottomCorners*sizeof(IntPair));
-	numTopCorners = 0;
-	numBottomCorners = 0;
+	range = (SLCPBuildRange *)arg;
+	range->numBigPLPs = 0;
+	range->maxBigPLPs = 0;
+	range->bigPLPs = NULL;
+	range->sumValues = 0;
+	range->maxValue = 0;
+	range->numTopCorners = 0;
+	range->maxTopCorners = 0;
+	range->topCorners = NULL;
+	range->numBottomCorners = 0;
+	range->maxBottomCorners = 0;
+	range->bottomCorners = NULL;
+	range->numTopEvents = 0;
+	range->maxTopEvents = 0;
+	range->topEvents = NULL;
+	range->numBottomEvents = 0;
+	range->maxBottomEvents = 0;
+	range->bottomEvents = NULL;
+	lcppos = (range->firstSample);
+	if( lcppos == (range->endSample) ) return NULL; // no samples in this range
+	progressStep = (((range->endSample)-lcppos)/10);
+	progressCounter = 0;
+	bwtpos = ( (range->firstBwtBlock) << BWTBLOCKSHIFT );
+	bwtBlock = &((buildSLCP->bwtMarkedPositions)[(range->firstBwtBlock)]);
+	mask = 1ULL; // mask for offset in current BWT block
+	nextlcp = GetLcpValueFromLcpPos(buildSLCP,lcppos);
 	#ifdef DEBUGLCP
-	numLcpIntervals=0;
-	numIncompleteLcpIntervals=0;
-	numBigTopLcps=0;
-	numBigTopPlps=0;
-	numBigTopSizes=0;
-	numSharedTopCorners=0;
-	avgSharedTopCornersCount=0;
-	maxSharedTopCornersCount=0;
-	sharedTopCornersCount=(unsigned int *)malloc(maxTopCorners*sizeof(unsigned int));
-	charsInsideInterval=(unsigned char *)malloc(maxTopCorners*sizeof(unsigned char));
-	prefixLinkDistance=0;
-	numOversizedBothValues=0;
+	prefixLinkDistance = 0;
 	#endif
-	bwtBlock=&(bwtMarkedPositions[0]);
-	mask=1ULL; // mask for offset in current BWT block
-	nextlcp=(-1); // this will be the lcp at the 0-th position
-	bwtpos=0;
-	for( lcppos=0 ; lcppos<numLCPSamples ; lcppos++ ){ // process all LCP samples
-		if(verbose){
-			if(progressCounter==progressStep){ // print progress dots
-				putchar('.');
-				fflush(stdout);
-				progressCounter=0;
-			} else progressCounter++;
-		}
+	for( ; lcppos<(range->endSample) ; lcppos++ ){ // process all LCP samples of this range
+		PRINTRANGEPROGRESS(range);
 		lcp = nextlcp;
-		if(lcppos!=(numLCPSamples-1)) nextlcp = GetLcpValueFromLcpPos(lcppos+1);
+		if(lcppos!=((buildSLCP->numLCPSamples)-1)) nextlcp = GetLcpValueFromLcpPos(buildSLCP,lcppos+1);
 		else nextlcp=(-1); // simulate next to last LCP
-		/*
-		if( (lcppos & BLOCKMASK) == 0 ){ // if we are at a new LCP block, save the current extra oversized values count
-			if(lcppos!=0) sampledLCPArray[(lcppos >> BLOCKSHIFT)].bigPLPsCount = (numOversizedPLPs-1); // -1 to set the last used position ;  the 0-th position will have (-1) and it was already set before
-		}
-		*/
 		while( ((bwtBlock->bits) & mask)==0 ){ // advance to next marked BWT position
 			if(mask==0ULL){
 				bwtBlock++;
@@ -802,125 +1119,58 @@ int BuildSampledLCPArray(char *text, unsigned int textsize, unsigned char *lcpar
 				continue;
 			}
 			#ifdef DEBUGLCP
-			bwtCharMask=(unsigned char)FMI_GetCharAtBWTPos(bwtpos);
+			bwtCharMask=(unsigned char)FMI_GetCharAtBWTPos(buildIndex,bwtpos);
 			if(bwtCharMask=='A') bwtCharMask=0x03;
 			else if(bwtCharMask=='C') bwtCharMask=0x0C;
 			else if(bwtCharMask=='G') bwtCharMask=0x30;
 			else if(bwtCharMask=='T') bwtCharMask=0xC0;
 			else bwtCharMask=0x00;
-			k=(numTopCorners-1);
+			k=((range->numTopCorners)-1);
 			while( k!=(-1) && charsInsideInterval[k]!=0xFF ) charsInsideInterval[k--]|=bwtCharMask;
 			#endif
 			mask<<=1;
 			bwtpos++;
 		}
 		#ifdef DEBUGLCP
-		bwtCharMask=(unsigned char)FMI_GetCharAtBWTPos(bwtpos);
+		bwtCharMask=(unsigned char)FMI_GetCharAtBWTPos(buildIndex,bwtpos);
 		if(bwtCharMask=='A') bwtCharMask=0x03;
 		else if(bwtCharMask=='C') bwtCharMask=0x0C;
 		else if(bwtCharMask=='G') bwtCharMask=0x30;
 		else if(bwtCharMask=='T') bwtCharMask=0xC0;
 		else bwtCharMask=0x00;
-		k=(numTopCorners-1);
+		k=((range->numTopCorners)-1);
 		while( k!=(-1) && charsInsideInterval[k]!=0xFF ) charsInsideInterval[k--]|=bwtCharMask;
 		#endif
 		if( nextlcp > lcp ){ // top corner
-			lcpBlock = &(sampledLCPArray[(lcppos >> BLOCKSHIFT)]);
-			i = (lcppos & BLOCKMASK);
-			k = (numTopCorners-1); // the closer upper pos with LCP lower than current LCP is always the last one in the array, because if the LCP was >= it was already removed when going through the bottom corners
-			/*
-			while( k!=-1 && topCornersLcp[k]>=lcp ) k--; // get closer upper pos with LCP lower than current LCP
-			*/
-			if( k!=-1 ){ // if we are not at the first position (LCP[0]=-1)
-				#ifdef DEBUGLCP
-				fullPLPArray[lcppos]=(topCorners[k].pos);
-				#endif
-				//(lcpBlock->prefixLinkPointer)[i] = topCornersPos[k]; // link current pos with LCP pos above
-				prefixLinkDistance = ( (long long int)topCorners[k].pos - (long long int)bwtpos ); // =(destination-source)<0
-				if( (prefixLinkDistance>(-128)) && (prefixLinkDistance<128) ) (lcpBlock->prefixLinkPointer)[i] = (signed char)prefixLinkDistance; // link current pos with LCP pos above
-				else { // if value is <=(-128) or >=(+128) store it in the extra array
-					if( numOversizedPLPs == maxNumOversizedValues ){ // realloc array if needed
-						maxNumOversizedValues += ((numLCPSamples/100)+1); // allocate 1% of the total number of sampled values each time
-						oversizedCorners = (IntPair *)realloc(oversizedCorners,(maxNumOversizedValues+1)*sizeof(IntPair));
-					}
-					(lcpBlock->prefixLinkPointer)[i] = 0; // mark as oversized corner prefix link
-					#ifdef DEBUGLCP
-					if((lcpBlock->sourceLCP[i])==UCHAR_MAX) numOversizedBothValues++;
-					#endif
-					oversizedCorners[numOversizedPLPs].pos = lcppos;
-					oversizedCorners[numOversizedPLPs].distvalue = topCorners[k].pos; // add oversized prefix links to separate array
-					numOversizedPLPs++;
-				}
-				if(prefixLinkDistance<0) prefixLinkDistance=(-prefixLinkDistance);
-				if(prefixLinkDistance>maxValue) maxValue=prefixLinkDistance;
-				sumValues+=prefixLinkDistance;
-				//SetPrefixLinkPointer(bwtpos,topCornersPos[k]); // link current pos with lower LCP pos
-				//indexLCPInfo[bwtpos].prefixLinkPointer = topCornersPos[k]; // link current pos with lower LCP pos
-				//indexLCPInfo[bwtpos].destinationLCP = lcp; // the destination LCP is the highest among the two
-			}
-			if( numTopCorners == maxTopCorners ){ // realloc arrays if needed
-				maxTopCorners++;
-				topCorners=(IntPair *)realloc(topCorners,maxTopCorners*sizeof(IntPair));
+			k = ((range->numTopCorners)-1); // the closer upper pos with LCP lower than current LCP is always the last one in the array, because if the LCP was >= it was already removed when going through the bottom corners
+			if( k!=-1 ){
 				#ifdef DEBUGLCP
-				sharedTopCornersCount=(unsigned int *)realloc(sharedTopCornersCount,maxTopCorners*sizeof(unsigned int));
-				charsInsideInterval=(unsigned char *)realloc(charsInsideInterval,maxTopCorners*sizeof(unsigned char));
+				prefixLinkDistance =
 				#endif
-			}
-			topCorners[numTopCorners].pos = bwtpos; // add this pos to the list of top corners
-			topCorners[numTopCorners].lcpvalue = lcp;
+				SetPrefixLink(range,lcppos,bwtpos,(range->topCorners[k].bwtPos)); // link current pos with LCP pos above
+			} else PushCorner(&(range->topEvents),&(range->numTopEvents),&(range->maxTopEvents),bwtpos,lcppos,lcp); // the pos above is in a previous range
 			#ifdef DEBUGLCP
-			sharedTopCornersCount[numTopCorners]=0;
-			charsInsideInterval[numTopCorners]=bwtCharMask;
+			sharedTopCornersCount[(range->numTopCorners)]=0;
+			charsInsideInterval[(range->numTopCorners)]=bwtCharMask;
 			if(prefixLinkDistance>=255) numBigTopPlps++;
 			#endif
-			numTopCorners++;
+			PushCorner(&(range->topCorners),&(range->numTopCorners),&(range->maxTopCorners),bwtpos,lcppos,lcp); // add this pos to the list of top corners
 		} else if( nextlcp < lcp ){ // bottom corner
 			lcp = nextlcp; // now the LCP to consider is the next/bottom one
-			k = (numBottomCorners-1);
-			while( k!=-1 && (bottomCorners[k].lcpvalue)>lcp ){ // get all pos behind/above with LCP higher than current LCP
-				i = GetLcpPosFromBwtPos((bottomCorners[k].pos));
-				oversizedCorners[numOversizedPLPs].pos = i; // set this here to prevent another call to get the SLCP position; if the PLP is not oversized, it will be replaced by the next oversized one
-				#ifdef DEBUGLCP
-				fullPLPArray[i]=bwtpos;
-				#endif
-				lcpBlock = &(sampledLCPArray[(i >> BLOCKSHIFT)]);
-				i = (i & BLOCKMASK);
-				//(lcpBlock->prefixLinkPointer)[i] = bwtpos; // link LCP pos above with current pos
-				prefixLinkDistance = ( (long long int)bwtpos - (long long int)(bottomCorners[k].pos) ); // =(destination-source)>0
-				if( (prefixLinkDistance>(-128)) && (prefixLinkDistance<128) ) (lcpBlock->prefixLinkPointer)[i] = (signed char)prefixLinkDistance; // link LCP pos above with current pos
-				else { // if value is <=(-128) or >=(+128) store it in the extra array
-					if( numOversizedPLPs == maxNumOversizedValues ){ // realloc array if needed
-						maxNumOversizedValues += ((numLCPSamples/100)+1); // allocate 1% of the total number of sampled values each time
-						oversizedCorners = (IntPair *)realloc(oversizedCorners,(maxNumOversizedValues+1)*sizeof(IntPair));
-					}
-					(lcpBlock->prefixLinkPointer)[i] = 0; // mark as oversized corner prefix link
-					#ifdef DEBUGLCP
-					if((lcpBlock->sourceLCP[i])==UCHAR_MAX) numOversizedBothValues++;
-					#endif
-					//oversizedCorners[numOversizedPLPs].pos = GetLcpPosFromBwtPos((unsigned int)(bottomCorners[k].pos)); // already set above
-					oversizedCorners[numOversizedPLPs].distvalue = bwtpos; // add oversized prefix links to separate array
-					numOversizedPLPs++;
-				}
-				if(prefixLinkDistance<0) prefixLinkDistance=(-prefixLinkDistance);
-				if(prefixLinkDistance>maxValue) maxValue=prefixLinkDistance;
-				sumValues+=prefixLinkDistance;
-				//SetPrefixLinkPointer(bottomCornersPos[k],bwtpos); // link higher LCP pos with current pos
-				//indexLCPInfo[(bottomCornersPos[k])].prefixLinkPointer = bwtpos; // link higher LCP pos with current pos
-				//indexLCPInfo[(bottomCornersPos[k])].destinationLCP = bottomCornersLcp[k]; // the destination LCP is the highest among the two
-				numBottomCorners--; // delete this corner because it has already been linked to another, and no other is going to link to him
+			k = ((range->numBottomCorners)-1);
+			while( k!=-1 && (range->bottomCorners[k].lcpValue)>lcp ){ // get all pos behind/above with LCP higher than current LCP
+				SetPrefixLink(range,(range->bottomCorners[k].lcpPos),(range->bottomCorners[k].bwtPos),bwtpos); // link LCP pos above with current pos
+				(range->numBottomCorners)--; // delete this corner because it has already been linked to another, and no other is going to link to him
 				k--;
 			}
-			if( numBottomCorners == maxBottomCorners ){ // realloc arrays if needed
-				maxBottomCorners++;
-				bottomCorners=(IntPair *)realloc(bottomCorners,maxBottomCorners*sizeof(IntPair));
-			}
-			bottomCorners[numBottomCorners].pos = bwtpos; // add this pos to the list of bottom corners
-			bottomCorners[numBottomCorners].lcpvalue = lcp;
-			numBottomCorners++;
+			if( k==-1 ) PushCorner(&(range->bottomEvents),&(range->numBottomEvents),&(range->maxBottomEvents),bwtpos,UINT_MAX,lcp); // more corners above might be in previous ranges
+			PushCorner(&(range->bottomCorners),&(range->numBottomCorners),&(range->maxBottomCorners),bwtpos,lcppos,lcp); // add this pos to the list of bottom corners
+			#ifdef DEBUGLCP
 			i = 0; // number of deleted top corners this time
-			k = (numTopCorners-1);
-			while( k!=-1 && (topCorners[k].lcpvalue)>=lcp ){ // get all top corner pos behind/above with LCP higher or equal than current LCP
-				numTopCorners--; // delete this top corner because it has already been linked to another, and no other is going to link to him
+			#endif
+			k = ((range->numTopCorners)-1);
+			while( k!=-1 && (range->topCorners[k].lcpValue)>=lcp ){ // get all top corner pos behind/above with LCP higher or equal than current LCP
+				(range->numTopCorners)--; // delete this top corner because it has already been linked to another, and no other is going to link to him
 				#ifdef DEBUGLCP
 				sharedTopCornersCount[k]++;
 				if(sharedTopCornersCount[k]!=1){
@@ -928,32 +1178,371 @@ int BuildSampledLCPArray(char *text, unsigned int textsize, unsigned char *lcpar
 					avgSharedTopCornersCount+=sharedTopCornersCount[k];
 					if(sharedTopCornersCount[k]>maxSharedTopCornersCount) maxSharedTopCornersCount=sharedTopCornersCount[k];
 				}
-				if(topCorners[k].lcpvalue>=255) numBigTopLcps++;
-				if((bwtpos-topCorners[k].pos)>=255) numBigTopSizes++;
+				if(range->topCorners[k].lcpValue>=255) numBigTopLcps++;
+				if((bwtpos-range->topCorners[k].bwtPos)>=255) numBigTopSizes++;
 				if(charsInsideInterval[k]!=0xFF) numIncompleteLcpIntervals++;
+				i++;
 				#endif
 				k--;
-				i++;
 			}
+			if( k==-1 ) PushCorner(&(range->topEvents),&(range->numTopEvents),&(range->maxTopEvents),bwtpos,UINT_MAX,lcp); // more corners above might be in previous ranges
 			#ifdef DEBUGLCP
 			numLcpIntervals += i; // if we deleted i top corners, it means i intervals were closed
-			if( i==0 || (topCorners[k+1].lcpvalue)!=lcp ){ // if it's a shared top margin, it's not deleted yet (i=0), but we closed another interval
+			if( k!=-1 && ( i==0 || (range->topCorners[k+1].lcpValue)!=lcp ) ){ // if it's a shared top margin, it's not deleted yet (i=0), but we closed another interval
 				numLcpIntervals++; // if we did not end at the same level as the last deleted top margin, we are in the middle of another (shared) top margin, which means another interval
 				sharedTopCornersCount[k]++;
-				if(topCorners[k].lcpvalue>=255) numBigTopLcps++;
-				if((bwtpos-topCorners[k].pos)>=255) numBigTopSizes++;
+				if(range->topCorners[k].lcpValue>=255) numBigTopLcps++;
+				if((bwtpos-range->topCorners[k].bwtPos)>=255) numBigTopSizes++;
 			}
 			#endif
 		}
-		/*
-		else { // lcp == nextlcp
-			//indexLCPInfo[bwtpos].prefixLinkPointer = -1; // undefined values
-			//indexLCPInfo[bwtpos].destinationLCP = -1;
-		}
-		*/
 		mask <<= 1;
 		bwtpos++;
 	}
+	return NULL;
+}
+
+// Gets the exact values of the truncated (255) LCPs that were kept while building the index, and splits them by the build ranges
+// NOTE: the values are sorted by BWT position, so the text is not needed here
+static void LoadOversizedLCPsFromIndex(){
+	SLCPBuildRange *range;
+	unsigned int n, firstn, numoverflows, bwtpos, endpos;
+	int t, k;
+	numoverflows = FMI_GetNumLCPOverflows();
+	n = 0;
+	for( t=0 ; t<numBuildRanges ; t++ ){
+		range = &(buildRanges[t]);
+		endpos = GetRangeEndBwtPos(range);
+		firstn = n;
+		while( n<numoverflows ){
+			FMI_GetLCPOverflow(n,&bwtpos);
+			if( bwtpos >= endpos ) break;
+			n++;
+		}
+		(range->numBigLCPs) = (int)(n-firstn);
+		range->bigLCPs = (IntPair *)malloc(((range->numBigLCPs)+1)*sizeof(IntPair));
+		if( range->bigLCPs == NULL ){
+			printf("\n> ERROR: Not enough memory to load the oversized LCPs\n");
+			exit(-1);
+		}
+		for( k=0 ; k<(range->numBigLCPs) ; k++ ){
+			range->bigLCPs[k].lcpvalue = FMI_GetLCPOverflow((firstn+(unsigned int)k),&bwtpos);
+			range->bigLCPs[k].pos = bwtpos;
+		}
+	}
+	FMI_FreeLCPSamples();
+}
+
+// Calculates the real values of the truncated (255) LCPs from the text, in parallel over all the build ranges
+static void CalculateOversizedLCPs(){
+	#ifdef PLCP_OVERSIZED_LCPS
+	SLCPBuildRange *range;
+	unsigned int i, numOversizedInfo;
+	int t, k;
+	#endif
+	if( buildText == NULL ){
+		printf("\n> ERROR: The text is needed to calculate the oversized LCPs\n");
+		exit(-1);
+	}
+	RunOnAllBuildRanges(CollectOversizedLCPsInRange);
+	#ifdef PLCP_OVERSIZED_LCPS
+	numOversizedInfo = 0;
+	for( t=0 ; t<numBuildRanges ; t++ ) numOversizedInfo += (unsigned int)(buildRanges[t].numBigLCPs);
+	oversizedLCPsInfo = (OversizedLCPInfo *)malloc((numOversizedInfo+1)*sizeof(OversizedLCPInfo));
+	if( oversizedLCPsInfo==NULL ){
+		printf("\n> ERROR: Not enough memory to calculate the oversized LCPs\n");
+		exit(-1);
+	}
+	i = 0;
+	for( t=0 ; t<numBuildRanges ; t++ ){ // join the info of all ranges to sort it by text position
+		range = &(buildRanges[t]);
+		for( k=0 ; k<(range->numBigLCPs) ; k++ ){
+			oversizedLCPsInfo[i].textPos = range->bigLCPsTextPos[(2*k)];
+			oversizedLCPsInfo[i].prevTextPos = range->bigLCPsTextPos[(2*k+1)];
+			oversizedLCPsInfo[i].lcpValue = &(range->bigLCPs[k].lcpvalue);
+			i++;
+		}
+		free(range->bigLCPsTextPos);
+		range->bigLCPsTextPos = NULL;
+	}
+	SortOversizedLCPsInfo(oversizedLCPsInfo,numOversizedInfo);
+	for( t=0 ; t<numBuildRanges ; t++ ){ // split the sorted array evenly by all threads
+		range = &(buildRanges[t]);
+		(range->firstOversizedInfo) = (unsigned int)( ((long long int)numOversizedInfo * (long long int)t) / (long long int)numBuildRanges );
+		(range->endOversizedInfo) = (unsigned int)( ((long long int)numOversizedInfo * (long long int)(t+1)) / (long long int)numBuildRanges );
+	}
+	RunOnAllBuildRanges(CalculateOversizedLCPsInRange);
+	free(oversizedLCPsInfo);
+	oversizedLCPsInfo = NULL;
+	#endif
+}
+
+// Collects the LCP samples from the full (truncated) LCP array, in parallel over all the build ranges
+static void CollectLCPSamplesFromArray(long long int *sumvalues, long long int *maxvalue){
+	SLCPBuildRange *range;
+	int t;
+	#ifndef BUILDLCP
+	if( FMI_HasExactLCPs() ) LoadOversizedLCPsFromIndex(); // the truncated LCPs were escaped and their values kept by the index
+	else
+	#endif
+	CalculateOversizedLCPs();
+	RunOnAllBuildRanges(MarkLCPSamplesInRange);
+	(buildSLCP->numLCPSamples) = 0;
+	(buildSLCP->numOversizedLCPs) = 0;
+	(*sumvalues) = 0;
+	(*maxvalue) = 0;
+	for( t=0 ; t<numBuildRanges ; t++ ){ // the samples of each range start after the ones of all the previous ranges
+		range = &(buildRanges[t]);
+		(range->firstSample) = (buildSLCP->numLCPSamples);
+		(range->firstBigSample) = (unsigned int)(buildSLCP->numOversizedLCPs);
+		(buildSLCP->numLCPSamples) += (range->numSamples);
+		(buildSLCP->numOversizedLCPs) += (int)(range->numBigSamples);
+		(range->endSample) = (buildSLCP->numLCPSamples);
+		(*sumvalues) += (range->sumValues);
+		if( (range->maxValue) > (*maxvalue) ) (*maxvalue) = (range->maxValue);
+	}
+	(buildSLCP->sampledLCPArray) = (LCPSamplesBlock *)malloc((((buildSLCP->numLCPSamples) >> BLOCKSHIFT)+1)*sizeof(LCPSamplesBlock));
+	(buildSLCP->extraLCPvalues) = (int *)malloc((buildSLCP->numOversizedLCPs)*sizeof(int));
+	RunOnAllBuildRanges(StoreLCPSamplesInRange);
+}
+
+// Reads the LCP samples that were already collected by the index while induced sorting the suffixes
+static void LoadLCPSamplesFromIndex(long long int *sumvalues, long long int *maxvalue){
+	SampledPosMarks *bwtBlock;
+	LCPSamplesBlock *lcpBlock;
+	SLCPBuildRange *range;
+	unsigned int bwtpos, prevbwtpos, lcppos, bigsample, bwtblockid, numbigsamples;
+	int t, lcp;
+	int progressCounter, progressStep;
+	(buildSLCP->numLCPSamples) = FMI_StartLCPSamplesReader(&numbigsamples);
+	(buildSLCP->numOversizedLCPs) = (int)numbigsamples;
+	(buildSLCP->sampledLCPArray) = (LCPSamplesBlock *)malloc((((buildSLCP->numLCPSamples) >> BLOCKSHIFT)+1)*sizeof(LCPSamplesBlock));
+	(buildSLCP->extraLCPvalues) = (int *)malloc(((buildSLCP->numOversizedLCPs)+1)*sizeof(int));
+	if( (buildSLCP->sampledLCPArray)==NULL || (buildSLCP->extraLCPvalues)==NULL ){
+		printf("\n> ERROR: Not enough memory to build the sampled LCP array\n");
+		exit(-1);
+	}
+	progressStep = ((buildSLCP->numLCPSamples)/10);
+	progressCounter = 0;
+	(*sumvalues) = 0;
+	(*maxvalue) = 0;
+	bwtblockid = 0;
+	bwtBlock = &((buildSLCP->bwtMarkedPositions)[0]);
+	(bwtBlock->bits) = 0ULL;
+	(bwtBlock->marksCount) = (unsigned int)(-1);
+	prevbwtpos = 0;
+	bigsample = 0;
+	for( lcppos=0 ; lcppos<(buildSLCP->numLCPSamples) ; lcppos++ ){
+		if(buildVerbose){
+			if(progressCounter==progressStep){ // print progress dots
+				putchar('.');
+				fflush(stdout);
+				progressCounter=0;
+			} else progressCounter++;
+		}
+		lcp = FMI_GetNextLCPSample(&bwtpos);
+		while( bwtblockid != (bwtpos >> BWTBLOCKSHIFT) ){ // advance to the block of this position
+			bwtblockid++;
+			bwtBlock = &((buildSLCP->bwtMarkedPositions)[bwtblockid]);
+			(bwtBlock->bits) = 0ULL;
+			(bwtBlock->marksCount) = (lcppos-1);
+		}
+		(bwtBlock->bits) |= ( 1ULL << (bwtpos & BWTBLOCKMASK) );
+		lcpBlock = &((buildSLCP->sampledLCPArray)[(lcppos >> BLOCKSHIFT)]);
+		if( (lcppos & BLOCKMASK) == 0 ){ // new lcp block
+			(lcpBlock->bigLCPsCount) = (int)(bigsample-1);
+			(lcpBlock->baseBwtPos) = bwtpos;
+		}
+		if( lcp != (-1) && lcp < UCHAR_MAX ) (lcpBlock->sourceLCP)[(lcppos & BLOCKMASK)] = (unsigned char)lcp;
+		else { // store oversized lcps in a separate array
+			(lcpBlock->sourceLCP)[(lcppos & BLOCKMASK)] = UCHAR_MAX;
+			(buildSLCP->extraLCPvalues)[bigsample] = lcp;
+			bigsample++;
+		}
+		if( bwtpos != 0 ){ // all the positions after the previous sample have the same LCP as this one
+			(*sumvalues) += ( (long long int)lcp * (long long int)(bwtpos-prevbwtpos) );
+			if( lcp > (*maxvalue) ) (*maxvalue) = lcp;
+			#ifdef DEBUGLCP
+			while( prevbwtpos != bwtpos ) fullLCPArray[++prevbwtpos] = lcp;
+			#endif
+		}
+		prevbwtpos = bwtpos;
+	}
+	(*sumvalues) += (-1); // fake next-to-last position
+	while( bwtblockid != (((buildSLCP->bwtLength)-1) >> BWTBLOCKSHIFT) ){ // fill the remaining blocks, if any
+		bwtblockid++;
+		(buildSLCP->bwtMarkedPositions)[bwtblockid].bits = 0ULL;
+		(buildSLCP->bwtMarkedPositions)[bwtblockid].marksCount = ((buildSLCP->numLCPSamples)-1);
+	}
+	FMI_FreeLCPSamples();
+	for( t=0 ; t<numBuildRanges ; t++ ){ // set the samples of each range, used when collecting the smaller values
+		range = &(buildRanges[t]);
+		(range->firstSample) = ( (buildSLCP->bwtMarkedPositions)[(range->firstBwtBlock)].marksCount + 1 );
+		if( t != 0 ) (buildRanges[(t-1)].endSample) = (range->firstSample);
+	}
+	buildRanges[(numBuildRanges-1)].endSample = (buildSLCP->numLCPSamples);
+}
+
+// TODO: create function that combines returning both LCP and SV simultaneously or that accepts bwtPos as argument (to prevent unneeded calls)
+// TODO: get statistics for number of sampled positions (not intervals) with lcp<minlcp and that do not include all the chars of the alphabet in its BWT range
+// TODO: implement SLCP+SV as "lcp-interval-tree":
+//  - store info of top corners only
+//  - multiple entries if it's a shared top corner
+//  - check (parentDistance==0) to distinguish between new corner or next entry of same corner
+//  - lcp-value(s), interval size(s), distance(s) to parent interval's pos in BWT (if deep corner, parentDistance=0)
+//  - benchmark avg+max results for these 3 fields on large datasets
+// NOTE: the BWT is split in (numthreads) ranges aligned to the BWT blocks, and each step is run in parallel over all the ranges; the
+//  previous/next smaller values that cross the ranges boundaries are resolved at the end, sequentially, from the corners left open in each range
+SampledLCPArray *BuildSampledLCPArray(FMIndex *fmi, char *text, unsigned int textsize, unsigned char *lcparray, int minlcp, int numthreads, int verbose){
+	unsigned int lcppos, i;
+	int k, t;
+	int numTopCorners, numBottomCorners;
+	int maxTopCorners, maxBottomCorners;
+	CornerInfo *topCorners, *bottomCorners, *event;
+	IntPair *oversizedCorners;
+	LCPSamplesBlock *lcpBlock;
+	SLCPBuildRange *range, *linksRange;
+	unsigned int numBwtBlocks, blocksPerRange;
+	SampledLCPArray *slcp;
+	long long int sumValues;
+	long long int maxValue;
+	#ifdef DEBUGLCP
+	unsigned int topptr, bottomptr;
+	unsigned int stopptr, sbottomptr;
+	struct timeb startTime, endTime;
+	double elapsedTime;
+	int progressCounter, progressStep;
+	unsigned int bwtpos;
+	int lcp;
+	#endif
+	buildSLCP = (SampledLCPArray *)calloc(1,sizeof(SampledLCPArray));
+	buildIndex = fmi;
+	#ifdef DEBUGLCP
+	numthreads = 1; // the debug statistics are collected over the whole array at once
+	#endif
+	if( numthreads < 1 ) numthreads = 1;
+	(buildSLCP->bwtLength) = (textsize+1);
+	numBwtBlocks = ((((buildSLCP->bwtLength)-1)>>BWTBLOCKSHIFT)+1); // last valid pos, quotient, add one
+	(buildSLCP->bwtMarkedPositions) = (SampledPosMarks *)malloc(numBwtBlocks*sizeof(SampledPosMarks));
+	blocksPerRange = ((numBwtBlocks-1)/(unsigned int)numthreads)+1;
+	numBuildRanges = (int)(((numBwtBlocks-1)/blocksPerRange)+1);
+	buildRanges = (SLCPBuildRange *)calloc((numBuildRanges+1),sizeof(SLCPBuildRange)); // +1 for the links set between ranges
+	for( t=0 ; t<numBuildRanges ; t++ ){
+		range = &(buildRanges[t]);
+		(range->id) = t;
+		(range->firstBwtBlock) = ( (unsigned int)t * blocksPerRange );
+		(range->endBwtBlock) = ( (range->firstBwtBlock) + blocksPerRange );
+		if( (range->endBwtBlock) > numBwtBlocks ) (range->endBwtBlock) = numBwtBlocks;
+	}
+	linksRange = &(buildRanges[numBuildRanges]);
+	(linksRange->id) = numBuildRanges;
+	buildText = text;
+	buildTextSize = textsize;
+	buildLCPArray = lcparray;
+	buildVerbose = verbose;
+	#ifdef BUILDLCP
+	lcparray = NULL; // to fix compiler unused variable warning
+	#endif
+	if(verbose){ printf("> Building Sampled LCP Array "); fflush(stdout); }
+	#ifdef DEBUGLCP
+	fullLCPArray=(int *)malloc((buildSLCP->bwtLength)*sizeof(int));
+	fullLCPArray[0]=(-1);
+	#endif
+	#ifndef BUILDLCP
+	if( lcparray == NULL ) LoadLCPSamplesFromIndex(&sumValues,&maxValue); // the samples were collected while building the index
+	else
+	#endif
+	CollectLCPSamplesFromArray(&sumValues,&maxValue);
+	(buildSLCP->lastLCPSamplesBlock) = &((buildSLCP->sampledLCPArray)[((buildSLCP->numLCPSamples) >> BLOCKSHIFT)]);
+	if( ((buildSLCP->numLCPSamples) & BLOCKMASK) == 0 ){ // if the last block is empty, it is only used to get the counts of the block before
+		((buildSLCP->lastLCPSamplesBlock)->bigLCPsCount) = ((buildSLCP->numOversizedLCPs)-1);
+		((buildSLCP->lastLCPSamplesBlock)->baseBwtPos) = (buildSLCP->bwtLength);
+	}
+	if(verbose){
+		printf(" OK\n");
+		printf(":: %.2lf%% samples (%u of %u)\n",((double)(buildSLCP->numLCPSamples)/(double)(buildSLCP->bwtLength))*100.0,(buildSLCP->numLCPSamples),(buildSLCP->bwtLength));
+		printf(":: %.2lf%% oversized samples (%d of %u)\n",((double)(buildSLCP->numOversizedLCPs)/(double)(buildSLCP->numLCPSamples))*100.0,(buildSLCP->numOversizedLCPs),(buildSLCP->numLCPSamples));
+		printf(":: Average LCP value = %d (max=%lld)\n",(int)(sumValues/(long long int)(buildSLCP->bwtLength)),maxValue);
+	}
+	#ifdef DEBUGLCP
+	if(verbose){ printf("> Testing Sampled LCP Array "); fflush(stdout); }
+	ftime(&startTime);
+	progressStep=((buildSLCP->bwtLength)/10);
+	progressCounter=0;
+	i=0;
+	for(bwtpos=0;bwtpos<(buildSLCP->bwtLength);bwtpos++){
+		if(verbose){
+			if(progressCounter==progressStep){ // print progress dots
+				putchar('.');
+				fflush(stdout);
+				progressCounter=0;
+			} else progressCounter++;
+		}
+		if(GetLCP(buildSLCP,bwtpos)!=fullLCPArray[bwtpos]) break;
+		if(((bwtpos+1)==(buildSLCP->bwtLength)) || (fullLCPArray[bwtpos]!=fullLCPArray[bwtpos+1])){ // only check marked positions
+			i=GetLcpPosFromBwtPos(buildSLCP,bwtpos);
+			if(GetBwtPosFromLcpPos(buildSLCP,i)!=bwtpos) break;
+		}
+	}
+	if((bwtpos==(buildSLCP->bwtLength)) && (i==((buildSLCP->numLCPSamples)-1))){
+		ftime(&endTime);
+		elapsedTime = ( ((endTime.time) + (endTime.millitm)/1000.0) - ((startTime.time) + (startTime.millitm)/1000.0) );
+		if(verbose){
+			printf(" OK\n");
+			printf(":: Done in %.3lf seconds\n",elapsedTime);
+		}
+	}
+	else printf("\n> ERROR: sampledLCP[%u]=%d =!= fullLCP[%u]=%d (bwtPos=%u->lcpPos=%d->bwtPos=%d) \n",bwtpos,GetLCP(buildSLCP,bwtpos),bwtpos,fullLCPArray[bwtpos],bwtpos,i,GetBwtPosFromLcpPos(buildSLCP,i));
+	#endif
+	if(verbose){ printf("> Collecting Previous/Next Smaller Values "); fflush(stdout); }
+	#ifdef DEBUGLCP
+	fullPLPArray=(unsigned int *)malloc((buildSLCP->numLCPSamples)*sizeof(unsigned int));
+	fullPLPArray[0]=0;
+	fullPLPArray[((buildSLCP->numLCPSamples)-1)]=((buildSLCP->bwtLength)-1);
+	numLcpIntervals=0;
+	numIncompleteLcpIntervals=0;
+	numBigTopLcps=0;
+	numBigTopPlps=0;
+	numBigTopSizes=0;
+	numSharedTopCorners=0;
+	avgSharedTopCornersCount=0;
+	maxSharedTopCornersCount=0;
+	sharedTopCornersCount=(unsigned int *)malloc(((buildSLCP->numLCPSamples)+1)*sizeof(unsigned int));
+	charsInsideInterval=(unsigned char *)malloc(((buildSLCP->numLCPSamples)+1)*sizeof(unsigned char));
+	numOversizedBothValues=0;
+	#endif
+	(buildSLCP->sampledLCPArray)[0].prefixLinkPointer[0]=0; // set value for first pos
+	RunOnAllBuildRanges(CollectSmallerValuesInRange);
+	maxTopCorners=0;
+	maxBottomCorners=0;
+	topCorners=NULL;
+	bottomCorners=NULL;
+	numTopCorners = 0;
+	numBottomCorners = 0;
+	for( t=0 ; t<numBuildRanges ; t++ ){ // replay the operations of each range on the corners left open by all the previous ranges
+		range = &(buildRanges[t]);
+		for( k=0 ; k<(range->numTopEvents) ; k++ ){
+			event = &(range->topEvents[k]);
+			if( (event->lcpPos) != UINT_MAX ){ // link to the closer upper pos with LCP lower than this one
+				if( numTopCorners != 0 ) SetPrefixLink(linksRange,(event->lcpPos),(event->bwtPos),(topCorners[(numTopCorners-1)].bwtPos));
+			} else {
+				while( numTopCorners != 0 && (topCorners[(numTopCorners-1)].lcpValue) >= (event->lcpValue) ) numTopCorners--;
+			}
+		}
+		for( k=0 ; k<(range->numTopCorners) ; k++ ) PushCorner(&topCorners,&numTopCorners,&maxTopCorners,(range->topCorners[k].bwtPos),(range->topCorners[k].lcpPos),(range->topCorners[k].lcpValue));
+		for( k=0 ; k<(range->numBottomEvents) ; k++ ){
+			event = &(range->bottomEvents[k]);
+			while( numBottomCorners != 0 && (bottomCorners[(numBottomCorners-1)].lcpValue) > (event->lcpValue) ){
+				SetPrefixLink(linksRange,(bottomCorners[(numBottomCorners-1)].lcpPos),(bottomCorners[(numBottomCorners-1)].bwtPos),(event->bwtPos));
+				numBottomCorners--;
+			}
+		}
+		for( k=0 ; k<(range->numBottomCorners) ; k++ ) PushCorner(&bottomCorners,&numBottomCorners,&maxBottomCorners,(range->bottomCorners[k].bwtPos),(range->bottomCorners[k].lcpPos),(range->bottomCorners[k].lcpValue));
+		free(range->topEvents);
+		free(range->bottomEvents);
+		free(range->topCorners);
+		free(range->bottomCorners);
+	}
 	if( numTopCorners!=0 || numBottomCorners!=1 ){
 		printf("\n> ERROR: Bad corners connection\n");
 	}
@@ -963,17 +1552,36 @@ int BuildSampledLCPArray(char *text, unsigned int textsize, unsigned char *lcpar
 	free(sharedTopCornersCount);
 	free(charsInsideInterval);
 	#endif
-	lcppos = (numLCPSamples-1);  // set value for last pos
-	sampledLCPArray[(lcppos >> BLOCKSHIFT)].prefixLinkPointer[(lcppos & BLOCKMASK)] = 0;
-	oversizedCorners[numOversizedPLPs].pos = lcppos;
-	oversizedCorners[numOversizedPLPs].distvalue = (bwtLength-1); // zero distance from (bwtLength-1);
-	numOversizedPLPs++;
-	qsort(oversizedCorners,numOversizedPLPs,sizeof(IntPair),CompareUnsignedIntPair); // sort oversized PLP values by their position in the SLCP array
-	extraPLPvalues = (unsigned int *)malloc(numOversizedPLPs*sizeof(unsigned int)); // final array of oversized values
+	lcppos = ((buildSLCP->numLCPSamples)-1);  // set value for last pos
+	(buildSLCP->sampledLCPArray)[(lcppos >> BLOCKSHIFT)].prefixLinkPointer[(lcppos & BLOCKMASK)] = 0;
+	(buildSLCP->numOversizedPLPs) = 2; // first and last pos
+	sumValues = 0;
+	maxValue = 0;
+	for( t=0 ; t<=numBuildRanges ; t++ ){
+		range = &(buildRanges[t]);
+		(buildSLCP->numOversizedPLPs) += (range->numBigPLPs);
+		sumValues += (range->sumValues);
+		if( (range->maxValue) > maxValue ) maxValue = (range->maxValue);
+	}
+	oversizedCorners = (IntPair *)malloc((buildSLCP->numOversizedPLPs)*sizeof(IntPair));
+	oversizedCorners[0].pos = 0;
+	oversizedCorners[0].distvalue = 0; // zero distance from 0
+	oversizedCorners[1].pos = lcppos;
+	oversizedCorners[1].distvalue = ((buildSLCP->bwtLength)-1); // zero distance from (bwtLength-1)
+	k = 2;
+	for( t=0 ; t<=numBuildRanges ; t++ ){
+		range = &(buildRanges[t]);
+		for( i=0 ; i<(unsigned int)(range->numBigPLPs) ; i++ ) oversizedCorners[k++] = range->bigPLPs[i];
+		free(range->bigPLPs);
+	}
+	free(buildRanges);
+	buildRanges = NULL;
+	qsort(oversizedCorners,(buildSLCP->numOversizedPLPs),sizeof(IntPair),CompareUnsignedIntPair); // sort oversized PLP values by their position in the SLCP array
+	(buildSLCP->extraPLPvalues) = (unsigned int *)malloc((buildSLCP->numOversizedPLPs)*sizeof(unsigned int)); // final array of oversized values
 	lcppos = 0;
-	lcpBlock = &(sampledLCPArray[0]);
-	for( k=0 ; k<numOversizedPLPs ; k++ ){ // fill the extra values array and the current extra values count on each LCP block
-		extraPLPvalues[k] = oversizedCorners[k].distvalue;
+	lcpBlock = &((buildSLCP->sampledLCPArray)[0]);
+	for( k=0 ; k<(buildSLCP->numOversizedPLPs) ; k++ ){ // fill the extra values array and the current extra values count on each LCP block
+		(buildSLCP->extraPLPvalues)[k] = oversizedCorners[k].distvalue;
 		i = oversizedCorners[k].pos;
 		while( lcppos <= i ){ // save the current count of oversized PLPs in all blocks before this oversized PLP position
 			(lcpBlock->bigPLPsCount) = (k-1); // the blocks before or at the k-th oversized value , will have the (k-1)-th entry stored, the previous oversized position behind
@@ -981,40 +1589,33 @@ int BuildSampledLCPArray(char *text, unsigned int textsize, unsigned char *lcpar
 			lcpBlock++;
 		}
 	}
-	while( lcppos < numLCPSamples ){ // although never used, fill the remaining oversized PLP counts in all blocks until the end of the sampled LCP array
-		(lcpBlock->bigPLPsCount) = (numOversizedPLPs-1);
+	while( lcppos <= (buildSLCP->numLCPSamples) ){ // although never used, fill the remaining oversized PLP counts in all blocks until the end of the sampled LCP array (including the extra last block)
+		(lcpBlock->bigPLPsCount) = ((buildSLCP->numOversizedPLPs)-1);
 		lcppos += BLOCKSIZE;
 		lcpBlock++;
 	}
 	free(oversizedCorners);
-	//SetPrefixLinkPointer(0,0);
-	//SetPrefixLinkPointer(textsize,textsize);
-	//indexLCPInfo[0].sourceLCP = 0; // set first and last pos values
-	//indexLCPInfo[0].destinationLCP = 0;
-	//indexLCPInfo[0].prefixLinkPointer = 0;
-	//indexLCPInfo[textsize].destinationLCP = 0;
-	//indexLCPInfo[textsize].prefixLinkPointer = textsize;
 	if(verbose){
 		printf(" OK\n");
-		printf(":: %.2lf%% oversized values (%d of %u)\n",((double)numOversizedPLPs/(double)numLCPSamples)*100.0,numOversizedPLPs,numLCPSamples);
-		printf(":: Average SV distance = %.2lf (max=%lld)\n",((double)sumValues/(double)numLCPSamples),maxValue);
-		sumValues = (long long int)( sizeof(*bwtMarkedPositions)*(((bwtLength-1)>>BWTBLOCKSHIFT)+1) + sizeof(*sampledLCPArray)*(((numLCPSamples-1)>>BLOCKSHIFT)+1) + sizeof(*extraLCPvalues)*numOversizedLCPs + sizeof(*extraPLPvalues)*numOversizedPLPs );
-		printf(":: Total SLCP+SV structure size = %.1lf MB (%.1lf bytes/char)\n",((double)sumValues)/((double)1000000U),((double)sumValues)/((double)bwtLength));
+		printf(":: %.2lf%% oversized values (%d of %u)\n",((double)(buildSLCP->numOversizedPLPs)/(double)(buildSLCP->numLCPSamples))*100.0,(buildSLCP->numOversizedPLPs),(buildSLCP->numLCPSamples));
+		printf(":: Average SV distance = %.2lf (max=%lld)\n",((double)sumValues/(double)(buildSLCP->numLCPSamples)),maxValue);
+		sumValues = (long long int)( sizeof(*(buildSLCP->bwtMarkedPositions))*((((buildSLCP->bwtLength)-1)>>BWTBLOCKSHIFT)+1) + sizeof(*(buildSLCP->sampledLCPArray))*((((buildSLCP->numLCPSamples)-1)>>BLOCKSHIFT)+1) + sizeof(*(buildSLCP->extraLCPvalues))*(buildSLCP->numOversizedLCPs) + sizeof(*(buildSLCP->extraPLPvalues))*(buildSLCP->numOversizedPLPs) );
+		printf(":: Total SLCP+SV structure size = %.1lf MB (%.1lf bytes/char)\n",((double)sumValues)/((double)1000000U),((double)sumValues)/((double)(buildSLCP->bwtLength)));
 		#ifdef DEBUGLCP
-		sumValues = (long long int)( sizeof(SampledPosMarks)*(((bwtLength-1)>>BWTBLOCKSHIFT)+1) + sizeof(LCPIntervalTreeBlock)*((numLcpIntervals>>BLOCKSHIFT)+1) + sizeof(*extraLCPvalues)*numOversizedLCPs + sizeof(int)*(numBigTopLcps+numBigTopPlps+numBigTopSizes) );
+		sumValues = (long long int)( sizeof(SampledPosMarks)*((((buildSLCP->bwtLength)-1)>>BWTBLOCKSHIFT)+1) + sizeof(LCPIntervalTreeBlock)*((numLcpIntervals>>BLOCKSHIFT)+1) + sizeof(*(buildSLCP->extraLCPvalues))*(buildSLCP->numOversizedLCPs) + sizeof(int)*(numBigTopLcps+numBigTopPlps+numBigTopSizes) );
 		printf(":: %u lcp-intervals (tree representation = %.1lf MB)\n",numLcpIntervals, ((double)sumValues)/((double)1000000) );
 		printf(":: %.2lf%% with at least one alphabet letter missing\n",((double)numIncompleteLcpIntervals/(double)numLcpIntervals)*100.0);
 		printf(":: %u shared top corners (avg count = %u , max count = %u)\n",numSharedTopCorners,(avgSharedTopCornersCount/numSharedTopCorners),maxSharedTopCornersCount);
-		i = (((numLCPSamples-1)>>BLOCKSHIFT)+1);
-		k = (numOversizedLCPs+numOversizedPLPs);
+		i = ((((buildSLCP->numLCPSamples)-1)>>BLOCKSHIFT)+1);
+		k = ((buildSLCP->numOversizedLCPs)+(buildSLCP->numOversizedPLPs));
 		printf(":: Number of oversized counters usage: 2singles = %luMB ; 1joint = %luMB (%u shared)\n", (2*i+k*1)*sizeof(unsigned int)/1000000U , (1*i+(k-numOversizedBothValues)*2)*sizeof(unsigned int)/1000000U , numOversizedBothValues );
 		#endif
 	}
 	#ifdef DEBUGLCP
 	if(verbose){ printf("> Testing Sampled Smaller Values "); fflush(stdout); }
-	progressStep=(numLCPSamples/10);
+	progressStep=((buildSLCP->numLCPSamples)/10);
 	progressCounter=0;
-	for(lcppos=0;lcppos<numLCPSamples;lcppos++){
+	for(lcppos=0;lcppos<(buildSLCP->numLCPSamples);lcppos++){
 		if(verbose){
 			if(progressCounter==progressStep){ // print progress dots
 				putchar('.');
@@ -1022,20 +1623,20 @@ int BuildSampledLCPArray(char *text, unsigned int textsize, unsigned char *lcpar
 				progressCounter=0;
 			} else progressCounter++;
 		}
-		i=GetPrefixLinkFromLcpPos(lcppos);
+		i=GetPrefixLinkFromLcpPos(buildSLCP,lcppos);
 		if(i!=fullPLPArray[lcppos]) break;
 	}
-	if(lcppos==numLCPSamples){ if(verbose) printf(" OK\n"); }
+	if(lcppos==(buildSLCP->numLCPSamples)){ if(verbose) printf(" OK\n"); }
 	else printf("\n> ERROR: sampledPLP[%u:%u]=%u =!= fullPLP[%u]=%u\n",(lcppos>>BLOCKSHIFT),(lcppos&BLOCKMASK),i,lcppos,fullPLPArray[lcppos]);
 	if(verbose){ printf("> Testing Single Parent Intervals "); fflush(stdout); }
 	testNumCalls=0;
 	testNumFollowedPos=0;
 	testMaxFollowedPos=0;
-	progressStep=(numLCPSamples/10);
+	progressStep=((buildSLCP->numLCPSamples)/10);
 	progressCounter=0;
 	topptr=0; // prevent compiler warnings
 	bottomptr=0;
-	for(lcppos=0;lcppos<numLCPSamples;lcppos++){
+	for(lcppos=0;lcppos<(buildSLCP->numLCPSamples);lcppos++){
 		if(verbose){
 			if(progressCounter==progressStep){ // print progress dots
 				putchar('.');
@@ -1043,34 +1644,34 @@ int BuildSampledLCPArray(char *text, unsigned int textsize, unsigned char *lcpar
 				progressCounter=0;
 			} else progressCounter++;
 		}
-		bwtpos=GetBwtPosFromLcpPos(lcppos);
+		bwtpos=GetBwtPosFromLcpPos(buildSLCP,lcppos);
 		topptr=bwtpos;
 		bottomptr=bwtpos;
 		k=GetTrueEnclosingLCPInterval(&topptr,&bottomptr);
 		stopptr=bwtpos;
 		sbottomptr=bwtpos;
-		i=GetEnclosingLCPInterval(&stopptr,&sbottomptr);
+		i=GetEnclosingLCPInterval(buildSLCP,&stopptr,&sbottomptr);
 		if((int)i!=k || stopptr!=topptr || sbottomptr!=bottomptr) break;
-		lcp=GetLcpValueFromLcpPos(lcppos);
+		lcp=GetLcpValueFromLcpPos(buildSLCP,lcppos);
 		topptr=bwtpos;
 		bottomptr=bwtpos;
 		k=GetTrueEnclosingLCPIntervalWithLcpValue(lcp,&topptr,&bottomptr);
 		stopptr=bwtpos;
 		sbottomptr=bwtpos;
-		i=GetEnclosingLCPIntervalFromLCPPos(lcppos,&stopptr,&sbottomptr);
+		i=GetEnclosingLCPIntervalFromLCPPos(buildSLCP,lcppos,&stopptr,&sbottomptr);
 		if((int)i!=k || stopptr!=topptr || sbottomptr!=bottomptr) break;
 	}
-	if(lcppos==numLCPSamples){
+	if(lcppos==(buildSLCP->numLCPSamples)){
 		if(verbose) printf(" OK\n");
 	} else printf("\n> ERROR: sampledNPSV[%u]=(%d){%u,%u} =!= fullNPSV[%u]=(%d){%u,%u}\n",bwtpos,i,stopptr,sbottomptr,bwtpos,k,topptr,bottomptr);
 	printf(":: Average followed SLCP positions for Parent query = %lld (max=%lld)\n",(testNumFollowedPos/testNumCalls),testMaxFollowedPos);
 	/*
 	if(verbose){ printf("> Testing Full Parent Intervals "); fflush(stdout); }
-	progressStep=(bwtLength/10);
+	progressStep=((buildSLCP->bwtLength)/10);
 	progressCounter=0;
 	topptr=0;
 	bottomptr=0;
-	for(bwtpos=0;bwtpos<(unsigned int)bwtLength;bwtpos++){
+	for(bwtpos=0;bwtpos<(unsigned int)(buildSLCP->bwtLength);bwtpos++){
 		if(verbose){
 			if(progressCounter==progressStep){ // print progress dots
 				putchar('.');
@@ -1084,13 +1685,13 @@ int BuildSampledLCPArray(char *text, unsigned int textsize, unsigned char *lcpar
 		bottomptr=bwtpos;
 		k=INT_MAX;
 		while(k>0){
-			k=GetEnclosingLCPInterval(&stopptr,&sbottomptr);
+			k=GetEnclosingLCPInterval(buildSLCP,&stopptr,&sbottomptr);
 			i=GetTrueEnclosingLCPInterval(&topptr,&bottomptr);
 			if(k!=(int)i || stopptr!=topptr || sbottomptr!=bottomptr) break;
 		}
 		if(k!=(int)i || stopptr!=topptr || sbottomptr!=bottomptr) break;
 	}
-	if(bwtpos==(unsigned int)bwtLength){
+	if(bwtpos==(unsigned int)(buildSLCP->bwtLength)){
 		if(verbose) printf(" OK\n");
 	} else printf("\n> ERROR: sampledNPSV[%u]=(%d){%u,%u} =!= fullNPSV[%u]=(%d){%u,%u}\n",bwtpos,k,stopptr,sbottomptr,bwtpos,i,topptr,bottomptr);
 	*/
@@ -1098,9 +1699,73 @@ int BuildSampledLCPArray(char *text, unsigned int textsize, unsigned char *lcpar
 	free(fullPLPArray);
 	free(fullLCPArray);
 	#endif
-	return numLCPSamples;
+	slcp = buildSLCP; // the built array now belongs to the returned handle
+	buildSLCP = NULL;
+	buildIndex = NULL;
+	return slcp;
 	/**/
 	// TODO: remove this!
 	minlcp = minlcp;
 	/**/
 }
+
+// Writes the sampled LCP array (and the marks of the sampled BWT positions) to the current position of an index file, and
+//  returns the number of written bytes (or 0 on error)
+// NOTE: one extra oversized LCP value is written after the last one, because the last block of samples may point to it
+size_t WriteSampledLCPArray(SampledLCPArray *slcp, FILE *indexfile){
+	unsigned int sizes[4], numBwtBlocks, numLCPBlocks;
+	int zero;
+	size_t n;
+	if( slcp == NULL ) return 0;
+	sizes[0] = (slcp->bwtLength);
+	sizes[1] = (slcp->numLCPSamples);
+	sizes[2] = (unsigned int)(slcp->numOversizedLCPs);
+	sizes[3] = (unsigned int)(slcp->numOversizedPLPs);
+	numBwtBlocks = ((((slcp->bwtLength)-1)>>BWTBLOCKSHIFT)+1);
+	numLCPBlocks = (((slcp->numLCPSamples) >> BLOCKSHIFT)+1);
+	zero = 0;
+	n = 0;
+	n += fwrite(sizes,sizeof(unsigned int),(size_t)4,indexfile);
+	n += fwrite((slcp->bwtMarkedPositions),sizeof(SampledPosMarks),(size_t)numBwtBlocks,indexfile);
+	n += fwrite((slcp->sampledLCPArray),sizeof(LCPSamplesBlock),(size_t)numLCPBlocks,indexfile);
+	n += fwrite((slcp->extraLCPvalues),sizeof(int),(size_t)(slcp->numOversizedLCPs),indexfile);
+	n += fwrite(&zero,sizeof(int),(size_t)1,indexfile);
+	n += fwrite((slcp->extraPLPvalues),sizeof(unsigned int),(size_t)(slcp->numOversizedPLPs),indexfile);
+	if( n != ( 4 + (size_t)numBwtBlocks + (size_t)numLCPBlocks + (size_t)(slcp->numOversizedLCPs) + 1 + (size_t)(slcp->numOversizedPLPs) ) ) return 0;
+	return ( 4*sizeof(unsigned int) + (size_t)numBwtBlocks*sizeof(SampledPosMarks) + (size_t)numLCPBlocks*sizeof(LCPSamplesBlock)
+		+ ((size_t)(slcp->numOversizedLCPs)+1)*sizeof(int) + (size_t)(slcp->numOversizedPLPs)*sizeof(unsigned int) );
+}
+
+// Creates a sampled LCP array handle that uses the arrays stored in this (mapped) index file data directly, without copying them,
+//  and sets the number of used bytes (returns NULL if the data is invalid)
+// NOTE: the data must stay mapped until FreeSampledSuffixArray() is called, and it is only read, so it can be shared by multiple processes
+SampledLCPArray *AttachSampledLCPArray(FMIndex *fmi, char *indexdata, size_t datasize, size_t *usedsize){
+	SampledLCPArray *slcp;
+	unsigned int *sizes, numBwtBlocks, numLCPBlocks;
+	size_t n;
+	if( datasize < 4*sizeof(unsigned int) ) return NULL;
+	sizes = (unsigned int *)indexdata;
+	if( sizes[0] != FMI_GetBWTSize(fmi) || sizes[1] > sizes[0] || sizes[2] > sizes[1] || sizes[3] < 2 ) return NULL; // it must be the array of this index
+	numBwtBlocks = (((sizes[0]-1)>>BWTBLOCKSHIFT)+1);
+	numLCPBlocks = ((sizes[1] >> BLOCKSHIFT)+1);
+	n = ( 4*sizeof(unsigned int) + (size_t)numBwtBlocks*sizeof(SampledPosMarks) + (size_t)numLCPBlocks*sizeof(LCPSamplesBlock)
+		+ ((size_t)sizes[2]+1)*sizeof(int) + (size_t)sizes[3]*sizeof(unsigned int) );
+	if( n > datasize ) return NULL;
+	slcp = (SampledLCPArray *)malloc(sizeof(SampledLCPArray));
+	(slcp->bwtLength) = sizes[0];
+	(slcp->numLCPSamples) = sizes[1];
+	(slcp->numOversizedLCPs) = (int)sizes[2];
+	(slcp->numOversizedPLPs) = (int)sizes[3];
+	indexdata += 4*sizeof(unsigned int);
+	(slcp->bwtMarkedPositions) = (SampledPosMarks *)indexdata;
+	indexdata += (size_t)numBwtBlocks*sizeof(SampledPosMarks);
+	(slcp->sampledLCPArray) = (LCPSamplesBlock *)indexdata;
+	indexdata += (size_t)numLCPBlocks*sizeof(LCPSamplesBlock);
+	(slcp->extraLCPvalues) = (int *)indexdata;
+	indexdata += ((size_t)(slcp->numOversizedLCPs)+1)*sizeof(int);
+	(slcp->extraPLPvalues) = (unsigned int *)indexdata;
+	(slcp->lastLCPSamplesBlock) = &((slcp->sampledLCPArray)[((slcp->numLCPSamples) >> BLOCKSHIFT)]);
+	(slcp->isAttached) = 1;
+	(*usedsize) = n;
+	return slcp;
+}
@@ -1,4 +1,12 @@
-int BuildSampledLCPArray(char *text, unsigned int textsize, unsigned char *lcparray, int minlcp, int verbose);
-void FreeSampledSuffixArray();
-int GetLCP(unsigned int bwtpos);
-int GetEnclosingLCPInterval(unsigned int *topptr, unsigned int *bottomptr);
+typedef struct _SampledLCPArray SampledLCPArray;
+SampledLCPArray *BuildSampledLCPArray(FMIndex *fmi, char *text, unsigned int textsize, unsigned char *lcparray, int minlcp, int numthreads, int verbose);
+void FreeSampledSuffixArray(SampledLCPArray *slcp);
+int GetLCP(SampledLCPArray *slcp, unsigned int bwtpos);
+int GetEnclosingLCPInterval(SampledLCPArray *slcp, unsigned int *topptr, unsigned int *bottomptr);
+typedef struct _LCPIntervalCache LCPIntervalCache;
+LCPIntervalCache *NewLCPIntervalCache(SampledLCPArray *slcp);
+void FreeLCPIntervalCache(LCPIntervalCache *cache);
+void GetLCPIntervalCacheStats(LCPIntervalCache *cache, long long int *numhits, long long int *numlookups);
+int GetCachedEnclosingLCPInterval(LCPIntervalCache *cache, unsigned int *topptr, unsigned int *bottomptr);
+size_t WriteSampledLCPArray(SampledLCPArray *slcp, FILE *indexfile);
+SampledLCPArray *AttachSampledLCPArray(FMIndex *fmi, char *indexdata, size_t datasize, size_t *usedsize);
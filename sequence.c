@@ -14,14 +14,56 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <limits.h>
 #include "sequence.h"
 
-static FILE **seqFiles;
+#if defined(unix) || defined(__unix__) || defined(__APPLE__)
+#define MMAP_FILES 1 // map the sequence files to memory instead of reading their whole contents
+#define FASTA_INDEX_FILES 1 // get the sizes and offsets of the query sequences from FASTA index files (.fai), and create them if needed
+#define GZIP_FILES 1 // decompress gzip files (.gz) while loading them, with the blocks of bgzip files decompressed in parallel
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#ifdef GZIP_FILES
+#include <zlib.h>
+#include <pthread.h>
+#endif
+#if defined(__GNUC__) && defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+typedef struct _SequenceFile {
+	char *data; // contents of the whole file
+	size_t size;
+	char allocated; // if the contents were decompressed (or read) to an allocated array instead of mapped from the file
+	char compressed; // if the contents were decompressed from a gzip file
+} SequenceFile;
+
+static SequenceFile *seqFiles = NULL;
+
+#ifdef FASTA_INDEX_FILES
+typedef struct _FastaIndexEntry {	// line of a FASTA index file (.fai), as created by samtools faidx
+	unsigned long long int length;		// number of chars of the sequence (excluding newlines)
+	unsigned long long int offset;		// position in the file of the 1st char of the sequence
+	unsigned long long int nameoffset;	// position in the file of the 1st char of the header (not saved in the index file)
+	unsigned int linebases, linewidth;	// number of chars in each line, excluding and including the newline chars
+} FastaIndexEntry;
+#endif
 static unsigned char numFiles = 0;
 static char *charsTable = NULL;
 static int numMergedSeqs = 0;
 static unsigned int *mergedSeqsStartPos = NULL;
+static unsigned int *mergedSeqsIdInBlock = NULL;
+static unsigned int mergedSeqsPosShift = 0;
+static int numLoadingThreads = 0; // number of threads used to decompress bgzip files (0 for one per core)
+
+// Sets the number of threads used while loading the sequence files
+void SetSequenceLoadingThreads(int numthreads){
+	numLoadingThreads=numthreads;
+}
 
 Sequence *AddNewSequence(){
 	Sequence *newSeq;
@@ -33,6 +75,282 @@ Sequence *AddNewSequence(){
 	return newSeq;
 }
 
+#ifdef GZIP_FILES
+typedef struct _GzipBlock {
+	size_t inpos, insize;	// position and size of the compressed (raw deflate) data of the block in the file
+	size_t outpos, outsize;	// position and size of the decompressed data of the block
+	unsigned int crc;
+} GzipBlock;
+
+typedef struct _GzipBlocksRange {
+	unsigned char *indata;
+	char *outdata;
+	GzipBlock *blocks;
+	int startblock, endblock;
+	int ok;
+} GzipBlocksRange;
+
+static unsigned int GetLittleEndianInt(unsigned char *bytes){
+	return ((unsigned int)bytes[0]) | (((unsigned int)bytes[1])<<8) | (((unsigned int)bytes[2])<<16) | (((unsigned int)bytes[3])<<24);
+}
+
+// Checks if the gzip data is made of BGZF blocks (as created by bgzip), and returns their number, or 0 if it is a regular gzip file
+// NOTE: each BGZF block is a complete gzip member whose header stores its compressed size, so all the blocks can be located
+//  without decompressing anything, and each one can be decompressed independently to its final position
+static int GetBgzfBlocks(unsigned char *data, size_t size, GzipBlock **blocks){
+	GzipBlock *block;
+	size_t pos, blocksize, outpos;
+	unsigned int extrasize, k;
+	int numblocks, maxblocks;
+	(*blocks)=NULL;
+	numblocks=0;
+	maxblocks=0;
+	outpos=0;
+	pos=0;
+	while(pos!=size){
+		if((size-pos)<18 || data[pos]!=0x1f || data[(pos+1)]!=0x8b || data[(pos+2)]!=8 || (data[(pos+3)]&4)==0) break;
+		extrasize=((unsigned int)data[(pos+10)]) | (((unsigned int)data[(pos+11)])<<8);
+		if((size-pos)<(size_t)(12+extrasize)) break;
+		blocksize=0;
+		for(k=0;(k+4)<=extrasize;k+=(4+(((unsigned int)data[(pos+12+k+2)]) | (((unsigned int)data[(pos+12+k+3)])<<8)))){ // find the "BC" subfield
+			if(data[(pos+12+k)]=='B' && data[(pos+12+k+1)]=='C' && data[(pos+12+k+2)]==2 && data[(pos+12+k+3)]==0 && (k+6)<=extrasize){
+				blocksize=(size_t)(((unsigned int)data[(pos+12+k+4)]) | (((unsigned int)data[(pos+12+k+5)])<<8))+1;
+				break;
+			}
+		}
+		if(blocksize<(size_t)(20+extrasize) || blocksize>(size-pos)) break;
+		if(numblocks==maxblocks){
+			maxblocks+=1024;
+			(*blocks)=(GzipBlock *)realloc((*blocks),maxblocks*sizeof(GzipBlock));
+		}
+		block=&((*blocks)[numblocks]);
+		block->inpos=(pos+12+extrasize);
+		block->insize=(blocksize-extrasize-20);
+		block->crc=GetLittleEndianInt(data+pos+blocksize-8);
+		block->outsize=(size_t)GetLittleEndianInt(data+pos+blocksize-4);
+		block->outpos=outpos;
+		outpos+=(block->outsize);
+		numblocks++;
+		pos+=blocksize;
+	}
+	if(pos!=size){ // not a valid BGZF file
+		if((*blocks)!=NULL) free(*blocks);
+		(*blocks)=NULL;
+		return 0;
+	}
+	return numblocks;
+}
+
+// Decompresses a range of consecutive BGZF blocks, and checks the CRC of each one
+static void *InflateBgzfBlocksRange(void *arg){
+	GzipBlocksRange *range;
+	GzipBlock *block;
+	z_stream strm;
+	int b;
+	range=(GzipBlocksRange *)arg;
+	range->ok=0;
+	memset(&strm,0,sizeof(z_stream));
+	if(inflateInit2(&strm,-15)!=Z_OK) return NULL; // raw deflate data, without the gzip header
+	for(b=(range->startblock);b<(range->endblock);b++){
+		block=&((range->blocks)[b]);
+		if((block->outsize)==0) continue; // empty (end of file) block
+		inflateReset(&strm);
+		strm.next_in=((range->indata)+(block->inpos));
+		strm.avail_in=(uInt)(block->insize);
+		strm.next_out=(Bytef *)((range->outdata)+(block->outpos));
+		strm.avail_out=(uInt)(block->outsize);
+		if(inflate(&strm,Z_FINISH)!=Z_STREAM_END || strm.avail_out!=0) break;
+		if(crc32(0L,(Bytef *)((range->outdata)+(block->outpos)),(uInt)(block->outsize))!=(uLong)(block->crc)) break;
+	}
+	inflateEnd(&strm);
+	if(b==(range->endblock)) range->ok=1;
+	return NULL;
+}
+
+// Decompresses all the BGZF blocks in parallel, each thread decompressing a range of consecutive blocks
+static char *InflateBgzfData(unsigned char *data, GzipBlock *blocks, int numblocks, size_t *outsize){
+	GzipBlocksRange *ranges;
+	pthread_t *threads;
+	char *outdata;
+	int numthreads, t, ok;
+	(*outsize)=((blocks[(numblocks-1)].outpos)+(blocks[(numblocks-1)].outsize));
+	outdata=(char *)malloc(((*outsize)+1)*sizeof(char));
+	if(outdata==NULL) return NULL;
+	numthreads=numLoadingThreads;
+	#ifdef _SC_NPROCESSORS_ONLN
+	if(numthreads<1) numthreads=(int)sysconf(_SC_NPROCESSORS_ONLN);
+	#endif
+	if(numthreads>numblocks) numthreads=numblocks;
+	if(numthreads<1) numthreads=1;
+	ranges=(GzipBlocksRange *)malloc(numthreads*sizeof(GzipBlocksRange));
+	threads=(pthread_t *)malloc(numthreads*sizeof(pthread_t));
+	for(t=0;t<numthreads;t++){
+		ranges[t].indata=data;
+		ranges[t].outdata=outdata;
+		ranges[t].blocks=blocks;
+		ranges[t].startblock=(int)(((long long int)numblocks*t)/numthreads);
+		ranges[t].endblock=(int)(((long long int)numblocks*(t+1))/numthreads);
+		if(t!=0 && pthread_create(&(threads[t]),NULL,InflateBgzfBlocksRange,(void *)&(ranges[t]))!=0){
+			printf("\n> ERROR: Failed to create thread #%d\n",(t+1));
+			exit(-1);
+		}
+	}
+	InflateBgzfBlocksRange((void *)&(ranges[0])); // the first range is decompressed by this thread
+	ok=ranges[0].ok;
+	for(t=1;t<numthreads;t++){
+		pthread_join(threads[t],NULL);
+		if(!ranges[t].ok) ok=0;
+	}
+	free(threads);
+	free(ranges);
+	if(!ok){
+		free(outdata);
+		return NULL;
+	}
+	return outdata;
+}
+
+// Decompresses regular gzip data (possibly with multiple concatenated members) sequentially
+static char *InflateGzipData(unsigned char *data, size_t size, size_t *outsize){
+	z_stream strm;
+	char *outdata;
+	size_t inpos, outpos, allocsize, n, m;
+	int status;
+	allocsize=(size_t)GetLittleEndianInt(data+size-4); // uncompressed size (modulo 2^32) of the last member
+	if(allocsize<(4*size)) allocsize=(4*size);
+	outdata=(char *)malloc((allocsize+1)*sizeof(char));
+	if(outdata==NULL) return NULL;
+	memset(&strm,0,sizeof(z_stream));
+	if(inflateInit2(&strm,(15+16))!=Z_OK){ // +16 to decode the gzip header
+		free(outdata);
+		return NULL;
+	}
+	inpos=0;
+	outpos=0;
+	while(1){
+		if(strm.avail_in==0 && inpos!=size){ // the sizes in zlib are 32 bits, so large files are processed in chunks
+			n=(size-inpos);
+			if(n>(size_t)(1<<30)) n=(size_t)(1<<30);
+			strm.next_in=(data+inpos);
+			strm.avail_in=(uInt)n;
+			inpos+=n;
+		}
+		if(outpos==allocsize){
+			allocsize*=2;
+			outdata=(char *)realloc(outdata,(allocsize+1)*sizeof(char));
+			if(outdata==NULL) break;
+		}
+		m=(allocsize-outpos);
+		if(m>(size_t)(1<<30)) m=(size_t)(1<<30);
+		strm.next_out=(Bytef *)(outdata+outpos);
+		strm.avail_out=(uInt)m;
+		status=inflate(&strm,Z_NO_FLUSH);
+		outpos+=(m-(strm.avail_out));
+		if(status==Z_STREAM_END){ // check if another gzip member follows
+			n=(size_t)(strm.next_in-data);
+			if((size-n)<2 || data[n]!=0x1f || data[(n+1)]!=0x8b){
+				inflateEnd(&strm);
+				(*outsize)=outpos;
+				return outdata;
+			}
+			inflateReset(&strm);
+		} else if(status!=Z_OK && !(status==Z_BUF_ERROR && (strm.avail_in!=0 || inpos!=size))) break; // corrupted or truncated data
+	}
+	inflateEnd(&strm);
+	if(outdata!=NULL) free(outdata);
+	return NULL;
+}
+
+// Replaces the contents of a gzip file in memory by the decompressed contents, and sets the size to 0 if they could not be decompressed
+static void DecompressSequenceFile(SequenceFile *seqfile){
+	GzipBlock *blocks;
+	char *outdata;
+	size_t outsize;
+	int numblocks;
+	outsize=0;
+	numblocks=GetBgzfBlocks((unsigned char *)(seqfile->data),(seqfile->size),&blocks);
+	if(numblocks!=0){
+		outdata=InflateBgzfData((unsigned char *)(seqfile->data),blocks,numblocks,&outsize);
+		free(blocks);
+	} else outdata=InflateGzipData((unsigned char *)(seqfile->data),(seqfile->size),&outsize);
+	if(outdata==NULL){
+		printf("\n> WARNING: Invalid or corrupted gzip file\n");
+		outdata=(char *)malloc(sizeof(char));
+		outsize=0;
+	}
+	#ifdef MMAP_FILES
+	if(!(seqfile->allocated)) munmap((seqfile->data),(seqfile->size));
+	else
+	#endif
+	free(seqfile->data);
+	seqfile->data=outdata;
+	seqfile->size=outsize;
+	seqfile->allocated=1;
+	seqfile->compressed=1;
+}
+#endif
+
+// Maps (or reads) the whole contents of a sequence file to memory, and returns 0 if the file could not be opened
+// NOTE: gzip files are decompressed to memory
+int OpenSequenceFile(char *filename, SequenceFile *seqfile){
+	#ifdef MMAP_FILES
+	struct stat filestat;
+	int fd;
+	if((fd=open(filename,O_RDONLY))==(-1)) return 0;
+	if(fstat(fd,&filestat)==(-1) || !S_ISREG(filestat.st_mode)){
+		close(fd);
+		return 0;
+	}
+	seqfile->size=(size_t)(filestat.st_size);
+	seqfile->data=NULL;
+	seqfile->allocated=0;
+	if((seqfile->size)!=0){
+		seqfile->data=(char *)mmap(NULL,(seqfile->size),PROT_READ,MAP_PRIVATE,fd,0);
+		if((seqfile->data)==MAP_FAILED){
+			close(fd);
+			return 0;
+		}
+		#ifdef MADV_SEQUENTIAL
+		madvise((seqfile->data),(seqfile->size),MADV_SEQUENTIAL);
+		#endif
+	}
+	close(fd);
+	#else
+	FILE *file;
+	long int filesize;
+	if((file=fopen(filename,"rb"))==NULL) return 0;
+	fseek(file,0L,SEEK_END);
+	filesize=ftell(file);
+	rewind(file);
+	seqfile->data=(char *)malloc((filesize+1)*sizeof(char));
+	if((seqfile->data)==NULL){
+		fclose(file);
+		return 0;
+	}
+	seqfile->size=fread((seqfile->data),sizeof(char),(size_t)filesize,file);
+	seqfile->allocated=1;
+	fclose(file);
+	#endif
+	seqfile->compressed=0;
+	#ifdef GZIP_FILES
+	if((seqfile->size)>=18 && (unsigned char)(seqfile->data)[0]==0x1f && (unsigned char)(seqfile->data)[1]==0x8b) DecompressSequenceFile(seqfile);
+	#endif
+	return 1;
+}
+
+void CloseSequenceFile(SequenceFile *seqfile){
+	#ifdef MMAP_FILES
+	if((seqfile->data)!=NULL){
+		if(seqfile->allocated) free(seqfile->data);
+		else munmap((seqfile->data),(seqfile->size));
+	}
+	#else
+	if((seqfile->data)!=NULL) free(seqfile->data);
+	#endif
+	seqfile->data=NULL;
+	seqfile->size=0;
+}
+
 void DeleteAllSequences(){
 	Sequence *seq;
 	int i;
@@ -51,8 +369,10 @@ void DeleteAllSequences(){
 	charsTable=NULL;
 	if(mergedSeqsStartPos!=NULL) free(mergedSeqsStartPos);
 	mergedSeqsStartPos=NULL;
+	if(mergedSeqsIdInBlock!=NULL) free(mergedSeqsIdInBlock);
+	mergedSeqsIdInBlock=NULL;
 	numMergedSeqs=0;
-	for(i=0;i<numFiles;i++) fclose(seqFiles[i]);
+	for(i=0;i<numFiles;i++) CloseSequenceFile(&(seqFiles[i]));
 	if(seqFiles!=NULL) free(seqFiles);
 	seqFiles=NULL;
 	numFiles=0;
@@ -80,20 +400,265 @@ void InitCharsTable(int allowNs){
 	charsTable[(unsigned char)EOF]=(char)EOF;
 }
 
+// Returns the position where the chars of the sequence starting at this position end (the next '>' or the end of the file)
+char *GetSequenceCharsEnd(char *seqstart, char *fileend){
+	char *seqend;
+	seqend=(char *)memchr(seqstart,'>',(size_t)(fileend-seqstart));
+	if(seqend==NULL) seqend=fileend;
+	return seqend;
+}
+
+// Copies the chars in [src,srcend) to dest normalized by charsTable, skipping newlines and other invalid chars, and returns their number
+// NOTE: if dest is NULL, the valid chars are only counted, which allows to allocate the exact size of the sequence before loading it
+// NOTE: with SSE2, blocks of 16 chars that are all 'A','C','G' or 'T' (upper or lower case) are processed at once, and only
+//  the chars that are not (newlines, 'N's, ...) are processed one by one through charsTable
+size_t FilterSequenceChars(char *src, char *srcend, char *dest){
+	size_t n;
+	char c;
+	#if defined(__GNUC__) && defined(__SSE2__)
+	__m128i block, lowerblock, validmask, casebit, lowerA, lowerC, lowerG, lowerT;
+	char upperblock[16];
+	int mask, k;
+	casebit=_mm_set1_epi8(0x20);
+	lowerA=_mm_set1_epi8('a');
+	lowerC=_mm_set1_epi8('c');
+	lowerG=_mm_set1_epi8('g');
+	lowerT=_mm_set1_epi8('t');
+	#endif
+	n=0;
+	#if defined(__GNUC__) && defined(__SSE2__)
+	while((srcend-src)>=16){
+		block=_mm_loadu_si128((__m128i *)src);
+		lowerblock=_mm_or_si128(block,casebit); // only 'A' and 'a' are converted to 'a', and the same for the other 3 letters
+		validmask=_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(lowerblock,lowerA),_mm_cmpeq_epi8(lowerblock,lowerC)),_mm_or_si128(_mm_cmpeq_epi8(lowerblock,lowerG),_mm_cmpeq_epi8(lowerblock,lowerT)));
+		mask=_mm_movemask_epi8(validmask);
+		if(mask==0xFFFF){ // all the 16 chars are valid
+			if(dest!=NULL) _mm_storeu_si128((__m128i *)(dest+n),_mm_andnot_si128(casebit,block)); // convert to upper case
+			n+=16;
+			src+=16;
+			continue;
+		}
+		k=__builtin_ctz((unsigned int)(~mask)); // number of valid chars before the 1st invalid one
+		if(dest!=NULL && k!=0){ // the destination array has the exact size, so it cannot be written past the valid chars
+			_mm_storeu_si128((__m128i *)upperblock,_mm_andnot_si128(casebit,block));
+			memcpy((dest+n),upperblock,(size_t)k);
+		}
+		n+=k;
+		src+=k;
+		c=charsTable[(unsigned char)(*src++)]; // process the invalid char
+		if(c!=0){
+			if(dest!=NULL) dest[n]=c;
+			n++;
+		}
+	}
+	#endif
+	while(src!=srcend){
+		c=charsTable[(unsigned char)(*src++)];
+		if(c!=0){
+			if(dest!=NULL) dest[n]=c;
+			n++;
+		}
+	}
+	return n;
+}
+
+#ifdef FASTA_INDEX_FILES
+// Returns the name of the FASTA index file (.fai) of this FASTA file
+char *GetFastaIndexFilename(char *fastafilename){
+	char *faifilename;
+	size_t n;
+	n=strlen(fastafilename);
+	faifilename=(char *)malloc((n+5)*sizeof(char));
+	memcpy(faifilename,fastafilename,n);
+	memcpy((faifilename+n),".fai",5);
+	return faifilename;
+}
+
+// Returns the position in the file of the 1st char of the name of the sequence whose chars start at this offset
+size_t GetFastaIndexNameOffset(SequenceFile *seqfile, size_t offset){
+	if(offset!=0) offset--; // skip the end of line char
+	while(offset!=0 && (seqfile->data)[offset]!='>') offset--;
+	return (offset+1);
+}
+
+// Loads the FASTA index (.fai) of the file if it exists and is not older than the FASTA file, and returns the number of sequences
+// NOTE: returns (-1) if there is no valid index, and each entry is checked against the contents of the file
+int LoadFastaIndex(char *fastafilename, SequenceFile *seqfile, FastaIndexEntry **entries){
+	FILE *faifile;
+	char *faifilename;
+	struct stat fastastat, faistat;
+	FastaIndexEntry *entry;
+	unsigned long long int length, offset, span;
+	unsigned int linebases, linewidth;
+	int n, maxentries, c;
+	(*entries)=NULL;
+	faifilename=GetFastaIndexFilename(fastafilename);
+	if(stat(fastafilename,&fastastat)!=0 || stat(faifilename,&faistat)!=0 || (faistat.st_mtime)<(fastastat.st_mtime) || (faifile=fopen(faifilename,"r"))==NULL){
+		free(faifilename);
+		return (-1);
+	}
+	free(faifilename);
+	n=0;
+	maxentries=0;
+	while(1){
+		while((c=fgetc(faifile))!=EOF && c!='\t'); // skip the name
+		if(c==EOF) break;
+		if(fscanf(faifile,"%llu\t%llu\t%u\t%u",&length,&offset,&linebases,&linewidth)!=4) break;
+		while((c=fgetc(faifile))!=EOF && c!='\n'); // skip the rest of the line
+		if(offset>(unsigned long long int)(seqfile->size)) break;
+		if(offset!=0 && (seqfile->data)[(offset-1)]!='\n') break; // the sequence chars must start after a header line
+		if(length!=0){
+			if(linebases==0 || linewidth<linebases) break;
+			span=( ((length-1)/linebases)*linewidth + ((length-1)%linebases) + 1 ); // number of bytes until the last char of the sequence
+			if((offset+span)>(unsigned long long int)(seqfile->size)) break;
+			if((offset+span)!=(unsigned long long int)(seqfile->size) && (seqfile->data)[(offset+span)]!='\n' && (seqfile->data)[(offset+span)]!='\r') break;
+		}
+		if(n==maxentries){
+			maxentries+=1024;
+			(*entries)=(FastaIndexEntry *)realloc((*entries),maxentries*sizeof(FastaIndexEntry));
+		}
+		entry=&((*entries)[n++]);
+		entry->length=length;
+		entry->offset=offset;
+		entry->nameoffset=(unsigned long long int)GetFastaIndexNameOffset(seqfile,(size_t)offset);
+		entry->linebases=linebases;
+		entry->linewidth=linewidth;
+	}
+	if(c!=EOF || n==0){ // some line was invalid
+		fclose(faifile);
+		if((*entries)!=NULL) free(*entries);
+		(*entries)=NULL;
+		return (-1);
+	}
+	fclose(faifile);
+	return n;
+}
+
+// Builds the FASTA index of the file (the same as samtools faidx), and returns the number of sequences
+// NOTE: returns (-1) if the file cannot be indexed, i.e., if the lines of some sequence are not all of the same size (except the last one)
+//  or if they have chars that are not loaded (e.g. '-' or '*'), since then the lengths in the index would not be the sequence sizes
+int BuildFastaIndex(SequenceFile *seqfile, FastaIndexEntry **entries){
+	FastaIndexEntry *entry;
+	char *filepos, *fileend, *lineend;
+	unsigned int linebases, linewidth;
+	int n, maxentries, numlines, shortline;
+	(*entries)=NULL;
+	n=0;
+	maxentries=0;
+	filepos=(seqfile->data);
+	fileend=((seqfile->data)+(seqfile->size));
+	while(filepos!=fileend){
+		if((*filepos)!='>') break; // each sequence must start with a header line
+		if(n==maxentries){
+			maxentries+=1024;
+			(*entries)=(FastaIndexEntry *)realloc((*entries),maxentries*sizeof(FastaIndexEntry));
+		}
+		entry=&((*entries)[n++]);
+		entry->nameoffset=(unsigned long long int)((filepos+1)-(seqfile->data));
+		lineend=(char *)memchr(filepos,'\n',(size_t)(fileend-filepos));
+		filepos=((lineend==NULL)?(fileend):(lineend+1));
+		entry->offset=(unsigned long long int)(filepos-(seqfile->data));
+		entry->length=0;
+		entry->linebases=0;
+		entry->linewidth=0;
+		numlines=0;
+		shortline=0;
+		while(filepos!=fileend && (*filepos)!='>'){ // process all lines of the sequence
+			lineend=(char *)memchr(filepos,'\n',(size_t)(fileend-filepos));
+			if(lineend==NULL) lineend=fileend;
+			linewidth=(unsigned int)(lineend-filepos);
+			linebases=linewidth;
+			if(linebases!=0 && filepos[(linebases-1)]=='\r') linebases--;
+			if(lineend!=fileend) linewidth++;
+			if(memchr(filepos,'>',(size_t)linebases)!=NULL) break; // a header in the middle of a line cannot be indexed
+			if(FilterSequenceChars(filepos,(filepos+linebases),NULL)!=(size_t)linebases) break; // neither can chars that are dropped
+			if(numlines==0){
+				entry->linebases=linebases;
+				entry->linewidth=linewidth;
+			} else if(linebases!=0 && (shortline || linebases>(entry->linebases) || (lineend!=fileend && (linewidth-linebases)!=((entry->linewidth)-(entry->linebases))))) break; // only the last line can be shorter
+			if(linebases<(entry->linebases) || linebases==0) shortline=1;
+			entry->length+=linebases;
+			numlines++;
+			filepos=((lineend==fileend)?(fileend):(lineend+1));
+		}
+		if(filepos!=fileend && (*filepos)!='>') break;
+	}
+	if(filepos!=fileend){ // the file could not be indexed
+		if((*entries)!=NULL) free(*entries);
+		(*entries)=NULL;
+		return (-1);
+	}
+	return n;
+}
+
+// Saves the FASTA index next to the FASTA file, with the same format as samtools faidx (the name is the 1st word of the header)
+void SaveFastaIndex(char *fastafilename, SequenceFile *seqfile, FastaIndexEntry *entries, int numentries){
+	FILE *faifile;
+	char *faifilename, *name, c;
+	int n;
+	faifilename=GetFastaIndexFilename(fastafilename);
+	faifile=fopen(faifilename,"w");
+	free(faifilename);
+	if(faifile==NULL) return; // if the FASTA file is in a read-only location, the index is not saved
+	for(n=0;n<numentries;n++){
+		name=((seqfile->data)+(entries[n].nameoffset));
+		while((c=(*name))!='\n' && c!='\r' && c!=' ' && c!='\t'){
+			fputc(c,faifile);
+			name++;
+		}
+		fprintf(faifile,"\t%llu\t%llu\t%u\t%u\n",entries[n].length,entries[n].offset,entries[n].linebases,entries[n].linewidth);
+	}
+	fclose(faifile);
+}
+#endif
+
+// Creates a lookup table with the id of the merged seq at the first pos of each block of the global merged seq, like in the FM-Index
+// NOTE: the blocks have the size of the highest power of two not larger than the shortest seq, so each block has at most one seq
+//  start inside it, but the blocks are made larger if needed to keep the table size proportional to the number of seqs
+static void InitializeMergedSeqsLookupTable(unsigned int totalsize){
+	unsigned int seqid, pos, minsize, numblocks, block;
+	minsize=UINT_MAX; // size of the shortest seq (plus its separator)
+	for(seqid=0;seqid<(unsigned int)numMergedSeqs;seqid++){
+		pos=(mergedSeqsStartPos[(seqid+1)]-mergedSeqsStartPos[seqid]);
+		if(pos<minsize) minsize=pos;
+	}
+	mergedSeqsPosShift=0;
+	while((2UL<<mergedSeqsPosShift)<=(unsigned long)minsize && mergedSeqsPosShift<31) mergedSeqsPosShift++;
+	while((totalsize>>mergedSeqsPosShift)>(8U*(unsigned int)numMergedSeqs)) mergedSeqsPosShift++; // at most 8 blocks per seq
+	numblocks=((totalsize>>mergedSeqsPosShift)+1);
+	mergedSeqsIdInBlock=(unsigned int *)malloc(numblocks*sizeof(unsigned int));
+	seqid=0;
+	for(block=0;block<numblocks;block++){
+		pos=(block<<mergedSeqsPosShift);
+		while(pos>=mergedSeqsStartPos[(seqid+1)]) seqid++;
+		mergedSeqsIdInBlock[block]=seqid;
+	}
+}
+
 // TODO: allow "mergeseqs" to be used in all files, not only the 1st one (add "mergedSeqs" vars to Sequence struct)
 // NOTE: returns the number of valid sequences inside the file
 // NOTE: numSequences must be set to 0 before the first invocation of this function
 // NOTE: merging multiple sequence in a global one (mergeseqs) is only available for the first file
 // NOTE: if mergeseqs is set, the string of all the concatenated sequences is stored in the entry of the 1st sequence
 // NOTE: if seqnamestring is not NULL, only the sequences whose name constains that string (case-sensitive) are loaded
+// NOTE: the file is mapped to memory, the size of each sequence is counted first, and only then its chars are loaded to an array
+//  of the exact size (with merged sequences, the global array is only filled after all the sequences of the file were counted)
+// NOTE: if the chars are not loaded now and 'N's are kept, the sizes and offsets are taken from the FASTA index file (.fai), so the
+//  sequences are not scanned at all (the index is created if it does not exist yet, and used in the next runs)
+// NOTE: the lengths in a FASTA index not created here can also count chars that are not loaded (e.g. '-' or '*'), so the sizes of
+//  these sequences are only exact after their chars are loaded (and the minimum size must be checked again then)
 int LoadSequencesFromFile(char *inputfilename, int loadchars, int mergeseqs, int acgtonly, unsigned int minlength, char *seqnamestring){
-	FILE *file;
-	char c, *seqchars;
+	SequenceFile seqfile;
+	char c, *seqchars, *filepos, *fileend, *namestart, *seqstart, *seqend;
 	int k,numseqs,desclen,matchpos;
-	unsigned int seqsize,seqlen,maxseqlen;
-	long int filestart,fileend,filesize;
-	fpos_t startpos;
+	unsigned int seqsize,pos;
+	size_t charscount;
+	unsigned long long int seqlen,newseqlen;
 	Sequence *seq;
+	#ifdef FASTA_INDEX_FILES
+	FastaIndexEntry *faientries;
+	int numfaientries,faientryid;
+	#endif
 	if(numFiles==UCHAR_MAX){
 		printf("> WARNING: Loading more than %d files is not supported\n",(int)UCHAR_MAX);
 		return 0;
@@ -103,42 +668,56 @@ int LoadSequencesFromFile(char *inputfilename, int loadchars, int mergeseqs, int
 		return 0;
 	}
 	printf("> Loading sequences from file <%s> ... ",inputfilename);
-	if((file=fopen(inputfilename,"r"))==NULL){
+	if(!OpenSequenceFile(inputfilename,&seqfile)){
 		printf("\n> WARNING: Sequence file not found\n");
 		return 0;
 	}
-	filesize=0;
-	filestart=ftell(file);
-	fseek(file,0L,SEEK_END);
-	fileend=ftell(file);
-	filesize=(fileend-filestart);
-	rewind(file);
-	printf("(%ld bytes)\n",filesize);
-	c=fgetc(file);
-	//while(c!=EOF && c!='>') c=fgetc(file);
-	if(c!='>'){
+	printf("(%ld bytes)\n",(long int)(seqfile.size));
+	if((seqfile.size)==0 || (seqfile.data)[0]!='>'){
 		printf("> WARNING: Invalid FASTA file\n");
+		CloseSequenceFile(&seqfile);
 		return 0;
 	}
 	InitCharsTable(!acgtonly);
+	#ifdef FASTA_INDEX_FILES
+	faientries=NULL;
+	numfaientries=(-1);
+	faientryid=0;
+	if(!loadchars && !acgtonly){ // if 'N's are discarded, the sizes in the index are not the number of chars that will be loaded
+		numfaientries=LoadFastaIndex(inputfilename,&seqfile,&faientries);
+		if(numfaientries==(-1)){
+			numfaientries=BuildFastaIndex(&seqfile,&faientries);
+			if(numfaientries!=(-1) && !(seqfile.compressed)) SaveFastaIndex(inputfilename,&seqfile,faientries,numfaientries); // the offsets of a gzip file are not the ones samtools expects
+		}
+	}
+	#endif
 	numseqs=0; // number of sequences inside this file only
-	seqlen=0;
-	maxseqlen=0;
-	seqchars=NULL;
+	seqlen=0; // size of the concatenated global sequence
+	filepos=(seqfile.data);
+	fileend=((seqfile.data)+(seqfile.size));
 	while(1){ // loop for all sequences inside file
-		while(c!=EOF && c!='>') c=fgetc(file);
-		if(c==EOF) break;
-		fgetpos(file,&startpos); // save file position
+		#ifdef FASTA_INDEX_FILES
+		if(faientries!=NULL){ // get the position of the next header from the index
+			if(faientryid==numfaientries) break;
+			filepos=((seqfile.data)+(faientries[faientryid].nameoffset)-1);
+			faientryid++;
+		} else
+		#endif
+		filepos=(char *)memchr(filepos,'>',(size_t)(fileend-filepos));
+		if(filepos==NULL) break;
+		filepos++;
+		namestart=filepos;
 		printf("# %02d [",(numSequences+1));
 		matchpos=0;
 		desclen=0;
-		while((c=fgetc(file))!=EOF && c!='\n' && c!='\r'){
+		while(filepos!=fileend && (c=(*filepos))!='\n' && c!='\r'){
 			if(desclen<50) putchar(c);
 			if((seqnamestring!=NULL) && (seqnamestring[matchpos]!='\0')){ // check if sequence name contains string
 				if(seqnamestring[matchpos]==c) matchpos++;
 				else matchpos=0;
 			}
 			desclen++;
+			filepos++;
 		}
 		for(k=desclen;k<50;k++) putchar(' ');
 		printf("] ");
@@ -147,63 +726,46 @@ int LoadSequencesFromFile(char *inputfilename, int loadchars, int mergeseqs, int
 			printf("NAME DOES NOT MATCH\n");
 			continue;
 		}
-		seqsize=0; // size of the current single sequence only
-		if(!mergeseqs || numseqs==0){ // if merging sequences, do not reset these variables everytime, only the 1st time
-			seqlen=0; // stores the size of the concatenated global sequence
-			maxseqlen=0;
-			seqchars=NULL;
-		}
-		if(loadchars){
-			while((c=fgetc(file))!='>' && c!=EOF){
-				c=charsTable[(unsigned char)c]; // normalize char
-				if(c!=0){
-					if(seqlen==maxseqlen){
-						maxseqlen+=(1<<20); // allocate space in 1MB steps
-						seqchars=(char *)realloc(seqchars,maxseqlen*sizeof(char));
-						if(mergeseqs && numseqs!=0 && seqsize==0){ // when starting a new seq of the merged multi-seq string, separate seqs with an 'N' char
-							seqchars[seqlen++]='N'; // replace existing '\0' with an 'N'
-						}
-					}
-					seqchars[seqlen++]=c;
-					seqsize++;
-					if(seqlen==UINT_MAX) break;
-				}
-			}
-			if(seqlen!=0){
-				maxseqlen=seqlen;
-				seqchars=(char *)realloc(seqchars,(seqlen+1)*sizeof(char)); // shorten allocated space to fit real seq size
-				seqchars[seqlen]='\0';
-			}
+		if(filepos!=fileend) filepos++; // skip the end of line char
+		seqstart=filepos;
+		#ifdef FASTA_INDEX_FILES
+		if(faientries!=NULL){ // no need to scan the sequence chars
+			seqstart=((seqfile.data)+(faientries[(faientryid-1)].offset));
+			seqend=seqstart;
+			charscount=(size_t)(faientries[(faientryid-1)].length);
 		} else {
-			seqchars=NULL;
-			while((c=fgetc(file))!='>' && c!=EOF){
-				c=charsTable[(unsigned char)c];
-				if(c!=0){
-					seqsize++;
-					if(seqsize==UINT_MAX) break;
-				}
-			}
-			seqlen+=seqsize;
-		}
-		/*
-		while((c=fgetc(file))!=EOF && c!='>'){
-			if(c>='a' && c<='z') c-=32;
-			if(c>='A' && c<='Z') seqsize++;
+		#endif
+		seqend=GetSequenceCharsEnd(seqstart,fileend);
+		filepos=seqend;
+		charscount=FilterSequenceChars(seqstart,seqend,NULL); // size of the current single sequence only
+		#ifdef FASTA_INDEX_FILES
 		}
-		*/
-		if(seqsize==0){
+		#endif
+		if(charscount==0){
 			printf("EMPTY\n");
 			continue;
 		}
+		if(charscount>=(size_t)UINT_MAX){
+			printf("\n> WARNING: Sequence lengths of more than %u bp are not supported\n",UINT_MAX);
+			CloseSequenceFile(&seqfile);
+			return 0;
+		}
+		seqsize=(unsigned int)charscount;
 		if ((minlength!=0) && (seqsize<minlength)) {
 			printf("(%u bp) TOO SHORT\n",seqsize);
-			seqlen-=seqsize;
 			continue;
 		}
-		if(seqlen==UINT_MAX){
+		newseqlen=(unsigned long long int)seqsize;
+		if(mergeseqs){ // if merging sequences, separate seqs with an 'N' char
+			newseqlen+=seqlen;
+			if(loadchars && numseqs!=0) newseqlen++;
+		}
+		if(newseqlen>=(unsigned long long int)UINT_MAX){
 			printf("\n> WARNING: Sequence lengths of more than %u bp are not supported\n",UINT_MAX);
+			CloseSequenceFile(&seqfile);
 			return 0;
 		}
+		seqlen=newseqlen;
 		printf("(%u bp) ",seqsize);
 		fflush(stdout);
 		numseqs++;
@@ -211,93 +773,361 @@ int LoadSequencesFromFile(char *inputfilename, int loadchars, int mergeseqs, int
 		seq->size=seqsize;
 		seq->order=numSequences;
 		seq->name=(char *)malloc((desclen+1)*sizeof(char));
-		fsetpos(file,&startpos); // restore file position
-		k=0;
-		while((c=fgetc(file))!=EOF && c!='\n' && c!='\r') (seq->name)[k++]=c;
+		for(k=0;k<desclen;k++) (seq->name)[k]=namestart[k];
 		(seq->name)[k]='\0';
-		fgetpos(file,&startpos);
-		seq->sourcefilepos=startpos;
+		seq->sourcefilepos=(size_t)(seqstart-(seqfile.data));
 		seq->fileid=numFiles;
-		//seq->sourcefilename=inputfilename;
-		if(loadchars){
-			if(!mergeseqs) seq->chars=seqchars;
-			else seq->chars=NULL;
-			/*
-			(seq->chars)=(char *)malloc((seqlen+1)*sizeof(char));
-			k=0;
-			while((c=fgetc(file))!=EOF && c!='>'){
-				if(c>='a' && c<='z') c-=32;
-				if(c>='A' && c<='Z'){
-					if(c=='A' || c=='C' || c=='G' || c=='T') (seq->chars)[k++]=c;
-					else (seq->chars)[k++]='N';
-				}
-			}
-			(seq->chars)[k]='\0';
-			*/
-		} else {
-			seq->chars=NULL;
-			/*
-			k=0;
-			while(inputfilename[k]!='\0') k++;
-			seq->sourcefilename=(char *)malloc((k+1)*sizeof(char));
-			k=0;
-			while((c=inputfilename[k])!='\0') (seq->sourcefilename)[k++]=c;
-			(seq->sourcefilename)[k]='\0';
-			*/
-			//seq->sourcefile=fopen(inputfilename,"r");
-			//fsetpos(seq->sourcefile,&startpos);
-			while(c!=EOF && c!='>') c=fgetc(file);
+		seq->chars=NULL;
+		if(loadchars && !mergeseqs){
+			seq->chars=(char *)malloc((seqsize+1)*sizeof(char));
+			FilterSequenceChars(seqstart,seqend,(seq->chars));
+			(seq->chars)[seqsize]='\0';
 		}
 		printf("OK\n");
 		fflush(stdout);
 	}
+	#ifdef FASTA_INDEX_FILES
+	if(faientries!=NULL) free(faientries);
+	#endif
 	if(numseqs!=0){ // if seqs were present in the file
-		seqFiles=(FILE **)realloc(seqFiles,(numFiles+1)*sizeof(FILE *));
-		seqFiles[numFiles]=file;
+		seqFiles=(SequenceFile *)realloc(seqFiles,(numFiles+1)*sizeof(SequenceFile));
+		seqFiles[numFiles]=seqfile;
 		numFiles++;
 		if(mergeseqs){ // only allowed for the first file
 			numMergedSeqs=numseqs;
-			mergedSeqsStartPos=(unsigned int *)malloc(numseqs*sizeof(unsigned int));
+			mergedSeqsStartPos=(unsigned int *)malloc((numseqs+1)*sizeof(unsigned int));
 			mergedSeqsStartPos[0]=0; // save starting positions of each sequence inside the global merged sequence
 			for(k=1;k<numMergedSeqs;k++) mergedSeqsStartPos[k]= ( mergedSeqsStartPos[(k-1)] + (allSequences[(k-1)]->size) + 1 );
-			allSequences[0]->size=seqlen; // save the merged global sequence as the first sequence
+			mergedSeqsStartPos[numMergedSeqs]= ( mergedSeqsStartPos[(numMergedSeqs-1)] + (allSequences[(numMergedSeqs-1)]->size) + 1 ); // fake position after the last sequence
+			InitializeMergedSeqsLookupTable(mergedSeqsStartPos[numMergedSeqs]-1);
+			seqchars=NULL;
+			if(loadchars){ // now that the size of the global sequence is known, load the chars of all sequences
+				seqchars=(char *)malloc((seqlen+1)*sizeof(char));
+				if(seqchars==NULL){
+					printf("\n> ERROR: Not enough memory to load the merged sequences\n");
+					exit(-1);
+				}
+				for(k=0;k<numMergedSeqs;k++){
+					seq=allSequences[k];
+					pos=mergedSeqsStartPos[k];
+					if(k!=0) seqchars[(pos-1)]='N';
+					seqstart=((seqfile.data)+(seq->sourcefilepos));
+					FilterSequenceChars(seqstart,GetSequenceCharsEnd(seqstart,fileend),(seqchars+pos));
+				}
+				seqchars[seqlen]='\0';
+			}
+			allSequences[0]->size=(unsigned int)seqlen; // save the merged global sequence as the first sequence
 			allSequences[0]->chars=seqchars;
 		}
 	} else { // no seqs inside this file
-		fclose(file);
+		CloseSequenceFile(&seqfile);
 	}
 	return numseqs;
 }
 
+// NOTE: the chars are fetched directly from the mapped file at the saved offset, so multiple sequences can be loaded in parallel
 void LoadSequenceChars(Sequence *seq){
-	FILE *file;
-	unsigned int i;
-	char c;
+	SequenceFile *seqfile;
+	char *seqstart;
+	size_t i;
 	if((seq->chars)!=NULL) return;
-	file=seqFiles[(seq->fileid)];
-	//if((seq->chars)!=NULL || (seq->sourcefilename)==NULL) return;
-	//if((file=fopen((seq->sourcefilename),"r"))==NULL) return;
-	//if((seq->chars)!=NULL || (seq->sourcefile)==NULL) return;
-	//file=(seq->sourcefile);
-	fsetpos(file,&(seq->sourcefilepos));
+	seqfile=&(seqFiles[(seq->fileid)]);
+	seqstart=((seqfile->data)+(seq->sourcefilepos));
 	(seq->chars)=(char *)malloc(((seq->size)+1)*sizeof(char));
-	/*
-	i=0;
-	while((c=fgetc(file))!=EOF && c!='>'){
-		if(c>='a' && c<='z') c-=32;
-		if(c>='A' && c<='Z' && i<seqsize){
-			if(c=='A' || c=='C' || c=='G' || c=='T') (seq->chars)[i++]=c;
-			else (seq->chars)[i++]='N';
+	i=FilterSequenceChars(seqstart,GetSequenceCharsEnd(seqstart,((seqfile->data)+(seqfile->size))),(seq->chars));
+	(seq->chars)[i]='\0';
+	seq->size=(unsigned int)i; // the size from the FASTA index also counts invalid chars (e.g. '-' or '*')
+}
+
+// Makes sure the packed sequence has space for at least this number of bases
+static void ResizePackedSequence(PackedSequence *packed, size_t size){
+	size_t n;
+	n=((size+3)/4);
+	if(n>(packed->maxbasessize)){
+		packed->maxbasessize=n;
+		packed->bases=(unsigned char *)realloc((packed->bases),n*sizeof(unsigned char));
+		if((packed->bases)==NULL){
+			printf("\n> ERROR: Not enough memory to pack the sequence\n");
+			exit(-1);
 		}
 	}
-	*/
-	i=0;
-	while((c=fgetc(file))!='>' && c!=EOF){
-		c=charsTable[(unsigned char)c];
-		if(c!=0) (seq->chars)[i++]=c;
+}
+
+// Appends chars (only 'A','C','G','T' or 'N') to the end of the packed sequence, that must already have space for them
+static void AppendPackedSequenceChars(PackedSequence *packed, char *chars, unsigned int n){
+	unsigned char *bases, code;
+	unsigned int pos, i;
+	char c;
+	bases=(packed->bases);
+	pos=(packed->size);
+	for(i=0;i<n;i++,pos++){
+		c=chars[i];
+		if(c=='A') code=0;
+		else if(c=='C') code=1;
+		else if(c=='G') code=2;
+		else if(c=='T') code=3;
+		else { // 'N'
+			code=0;
+			if((packed->numnruns)!=0 && (packed->nruns)[(2*(packed->numnruns)-1)]==pos) (packed->nruns)[(2*(packed->numnruns)-1)]++; // extend the last run
+			else {
+				if((packed->numnruns)==(packed->maxnruns)){
+					packed->maxnruns+=1024;
+					packed->nruns=(unsigned int *)realloc((packed->nruns),2*(packed->maxnruns)*sizeof(unsigned int));
+				}
+				(packed->nruns)[(2*(packed->numnruns))]=pos;
+				(packed->nruns)[(2*(packed->numnruns)+1)]=(pos+1);
+				(packed->numnruns)++;
+			}
+		}
+		if((pos&3)==0) bases[(pos>>2)]=code;
+		else bases[(pos>>2)]|=(unsigned char)(code<<((pos&3)<<1));
 	}
-	(seq->chars)[i]='\0';
-	//fclose(file);
+	packed->size=pos;
+}
+
+// Stores the chars of a sequence in the packed sequence (reusing its arrays)
+void PackSequenceChars(char *chars, unsigned int size, PackedSequence *packed){
+	packed->size=0;
+	packed->numnruns=0;
+	ResizePackedSequence(packed,(size_t)size);
+	AppendPackedSequenceChars(packed,chars,size);
+}
+
+#define PACKCHUNKSIZE (1<<16)
+
+// Loads the chars of a sequence directly to the packed sequence, going through the file in chunks, so the full array of chars is
+//  never needed
+void LoadPackedSequenceChars(Sequence *seq, PackedSequence *packed){
+	SequenceFile *seqfile;
+	char *seqstart, *seqend, *chunkend, *chars;
+	size_t n;
+	seqfile=&(seqFiles[(seq->fileid)]);
+	seqstart=((seqfile->data)+(seq->sourcefilepos));
+	seqend=GetSequenceCharsEnd(seqstart,((seqfile->data)+(seqfile->size)));
+	packed->size=0;
+	packed->numnruns=0;
+	ResizePackedSequence(packed,(size_t)(seq->size));
+	chars=(char *)malloc(PACKCHUNKSIZE*sizeof(char));
+	while(seqstart!=seqend){
+		chunkend=(((size_t)(seqend-seqstart)>PACKCHUNKSIZE)?(seqstart+PACKCHUNKSIZE):seqend);
+		n=FilterSequenceChars(seqstart,chunkend,chars);
+		AppendPackedSequenceChars(packed,chars,(unsigned int)n);
+		seqstart=chunkend;
+	}
+	free(chars);
+	seq->size=(packed->size); // the size from the FASTA index also counts invalid chars (e.g. '-' or '*')
+}
+
+// Writes the chars from the start position up to length chars to dest (without a terminator), of the forward strand, or of the
+//  reverse complement strand if reverse is set (where start is a position in the reverse strand)
+void UnpackSequenceChars(PackedSequence *packed, unsigned int start, unsigned int length, int reverse, char *dest){
+	static const char basechars[4] = { 'A' , 'C' , 'G' , 'T' };
+	unsigned int pos, end, left, right, middle, runstart, runend;
+	unsigned char *bases;
+	if(reverse) start=((packed->size)-start-length); // corresponding range in the forward strand
+	end=(start+length);
+	bases=(packed->bases);
+	for(pos=start;pos<end;pos++) dest[(pos-start)]=basechars[((bases[(pos>>2)]>>((pos&3)<<1))&3)];
+	left=0; // binary search for the first run of 'N's that ends after the start
+	right=(packed->numnruns);
+	while(left<right){
+		middle=((left+right)/2);
+		if((packed->nruns)[(2*middle+1)]<=start) left=(middle+1);
+		else right=middle;
+	}
+	for(;left<(packed->numnruns);left++){
+		runstart=(packed->nruns)[(2*left)];
+		if(runstart>=end) break;
+		runend=(packed->nruns)[(2*left+1)];
+		if(runstart<start) runstart=start;
+		if(runend>end) runend=end;
+		memset((dest+(runstart-start)),'N',(size_t)(runend-runstart));
+	}
+	if(reverse) ReverseComplementSequence(dest,(int)length);
+}
+
+void FreePackedSequence(PackedSequence *packed){
+	if((packed->bases)!=NULL) free(packed->bases);
+	if((packed->nruns)!=NULL) free(packed->nruns);
+	packed->bases=NULL;
+	packed->nruns=NULL;
+	packed->size=0;
+	packed->numnruns=0;
+	packed->maxbasessize=0;
+	packed->maxnruns=0;
+}
+
+#define STREAMBUFFERSIZE (1<<20)
+
+// Creates a stream over an already opened (and possibly compressed) file
+SequenceStream *NewSequenceStream(void *file, int acgtonly, unsigned int minlength){
+	SequenceStream *stream;
+	InitCharsTable(!acgtonly);
+	stream=(SequenceStream *)calloc(1,sizeof(SequenceStream));
+	stream->file=file;
+	stream->buffer=(char *)malloc(STREAMBUFFERSIZE*sizeof(char));
+	stream->bufferpos=0;
+	stream->buffersize=0;
+	stream->minlength=minlength;
+	stream->seq.name=NULL;
+	stream->seq.chars=NULL;
+	stream->maxnamesize=0;
+	stream->maxcharssize=0;
+	return stream;
+}
+
+// Opens a FASTA file to be read one sequence at a time, even if it is not seekable (e.g. stdin, if the name is "-", or a pipe)
+// NOTE: returns NULL if the file could not be opened
+// NOTE: gzip compressed streams are detected and decompressed on the fly
+SequenceStream *OpenSequenceStream(char *filename, int acgtonly, unsigned int minlength){
+	#ifdef GZIP_FILES
+	gzFile file;
+	if(filename[0]=='-' && filename[1]=='\0'){
+		file=gzdopen(dup(fileno(stdin)),"rb");
+		filename="stdin";
+	} else file=gzopen(filename,"rb");
+	if(file==NULL){
+		printf("> WARNING: Sequence file <%s> not found\n",filename);
+		return NULL;
+	}
+	gzbuffer(file,(1<<17));
+	#else
+	FILE *file;
+	if(filename[0]=='-' && filename[1]=='\0'){
+		file=stdin;
+		filename="stdin";
+	} else if((file=fopen(filename,"rb"))==NULL){
+		printf("> WARNING: Sequence file <%s> not found\n",filename);
+		return NULL;
+	}
+	#endif
+	return NewSequenceStream((void *)file,acgtonly,minlength);
+}
+
+// Opens a FASTA stream from an already open file descriptor (e.g. a socket), which is closed together with the stream
+// NOTE: returns NULL if the stream could not be opened
+SequenceStream *OpenSequenceStreamFromDescriptor(int fd, int acgtonly, unsigned int minlength){
+	#ifdef GZIP_FILES
+	gzFile file;
+	if((file=gzdopen(fd,"rb"))==NULL) return NULL;
+	gzbuffer(file,(1<<17));
+	#else
+	FILE *file;
+	if((file=fdopen(fd,"rb"))==NULL) return NULL;
+	#endif
+	return NewSequenceStream((void *)file,acgtonly,minlength);
+}
+
+// Reads the next chunk of the stream into the buffer, and returns 0 if the end of the stream was reached
+int FillSequenceStreamBuffer(SequenceStream *stream){
+	#ifdef GZIP_FILES
+	int n;
+	n=gzread((gzFile)(stream->file),(stream->buffer),STREAMBUFFERSIZE);
+	if(n<0){
+		printf("\n> WARNING: Invalid or corrupted gzip stream\n");
+		n=0;
+	}
+	stream->buffersize=(size_t)n;
+	#else
+	stream->buffersize=fread((stream->buffer),sizeof(char),STREAMBUFFERSIZE,(FILE *)(stream->file));
+	#endif
+	stream->bufferpos=0;
+	return ((stream->buffersize)!=0);
+}
+
+// Reads the next valid sequence from the stream, and returns NULL if there are no more sequences
+// NOTE: the name and chars arrays of the returned sequence are reused (and only grown if needed) by the next sequence, so the
+//  memory used is bounded by the size of the largest sequence in the stream
+Sequence *ReadNextSequenceFromStream(SequenceStream *stream){
+	char *bufferstart, *bufferend, *seqend;
+	size_t namesize, charssize, n;
+	while(1){ // loop until a valid sequence is found
+		do { // go to the start of the next sequence
+			bufferstart=((stream->buffer)+(stream->bufferpos));
+			bufferend=((stream->buffer)+(stream->buffersize));
+			seqend=(char *)memchr(bufferstart,'>',(size_t)(bufferend-bufferstart));
+			if(seqend!=NULL) break;
+		} while(FillSequenceStreamBuffer(stream));
+		if(seqend==NULL) return NULL;
+		stream->bufferpos=(size_t)((seqend+1)-(stream->buffer));
+		namesize=0;
+		while(1){ // read the name
+			if((stream->bufferpos)==(stream->buffersize) && !FillSequenceStreamBuffer(stream)) break;
+			bufferstart=((stream->buffer)+(stream->bufferpos));
+			bufferend=((stream->buffer)+(stream->buffersize));
+			seqend=bufferstart;
+			while(seqend!=bufferend && (*seqend)!='\n' && (*seqend)!='\r') seqend++;
+			n=(size_t)(seqend-bufferstart);
+			if((namesize+n+1)>(stream->maxnamesize)){
+				stream->maxnamesize=(namesize+n+1);
+				stream->seq.name=(char *)realloc((stream->seq.name),(stream->maxnamesize)*sizeof(char));
+			}
+			memcpy(((stream->seq.name)+namesize),bufferstart,n);
+			namesize+=n;
+			stream->bufferpos+=n;
+			if(seqend!=bufferend) break;
+		}
+		if((stream->seq.name)==NULL){
+			stream->maxnamesize=1;
+			stream->seq.name=(char *)malloc(sizeof(char));
+		}
+		(stream->seq.name)[namesize]='\0';
+		charssize=0;
+		while(1){ // read the chars until the next sequence starts
+			if((stream->bufferpos)==(stream->buffersize) && !FillSequenceStreamBuffer(stream)) break;
+			bufferstart=((stream->buffer)+(stream->bufferpos));
+			bufferend=((stream->buffer)+(stream->buffersize));
+			seqend=(char *)memchr(bufferstart,'>',(size_t)(bufferend-bufferstart));
+			if(seqend==NULL) seqend=bufferend;
+			n=(size_t)(seqend-bufferstart);
+			if((charssize+n+1)>(stream->maxcharssize)){ // there can be at most n more valid chars
+				stream->maxcharssize=(charssize+n+1);
+				if((stream->maxcharssize)<(2*charssize)) stream->maxcharssize=(2*charssize); // grow geometrically
+				stream->seq.chars=(char *)realloc((stream->seq.chars),(stream->maxcharssize)*sizeof(char));
+				if((stream->seq.chars)==NULL){
+					printf("\n> ERROR: Not enough memory to read the sequence \"%s\"\n",(stream->seq.name));
+					exit(-1);
+				}
+			}
+			charssize+=FilterSequenceChars(bufferstart,seqend,((stream->seq.chars)+charssize));
+			stream->bufferpos+=n;
+			if(charssize>=(size_t)UINT_MAX){
+				printf("\n> ERROR: Sequence lengths of more than %u bp are not supported\n",UINT_MAX);
+				exit(-1);
+			}
+			if(seqend!=bufferend) break;
+		}
+		if(charssize==0) continue; // empty sequence
+		if((stream->minlength)!=0 && charssize<(size_t)(stream->minlength)) continue; // too short
+		(stream->seq.chars)[charssize]='\0';
+		stream->seq.size=(unsigned int)charssize;
+		return &(stream->seq);
+	}
+	return NULL;
+}
+
+void CloseSequenceStream(SequenceStream *stream){
+	#ifdef GZIP_FILES
+	gzclose((gzFile)(stream->file));
+	#else
+	if((stream->file)!=stdin) fclose((FILE *)(stream->file));
+	#endif
+	free(stream->buffer);
+	if((stream->seq.name)!=NULL) free(stream->seq.name);
+	if((stream->seq.chars)!=NULL) free(stream->seq.chars);
+	free(stream);
+}
+
+// Returns 1 if the file cannot be mapped to memory and should be read as a stream (stdin, pipes, devices, ...)
+int IsStreamFile(char *filename){
+	#ifdef MMAP_FILES
+	struct stat filestat;
+	#endif
+	if(filename[0]=='-' && filename[1]=='\0') return 1;
+	#ifdef MMAP_FILES
+	if(stat(filename,&filestat)==0 && !S_ISREG(filestat.st_mode) && !S_ISDIR(filestat.st_mode)) return 1;
+	#endif
+	return 0;
 }
 
 void FreeSequenceChars(Sequence *seq){
@@ -306,17 +1136,14 @@ void FreeSequenceChars(Sequence *seq){
 }
 
 // Given a position in the global merged seq, returns the id of the corresponding partial seq and updates the pos inside the seq
+// NOTE: the lookup table gives the seq at the start of the block containing the pos, and the following seqs starting inside the
+//  same block are checked next (usually none, or only one if the blocks are not larger than the shortest seq)
 int GetSeqIdFromMergedSeqsPos(unsigned int *pos){
-	int leftseq, rightseq, middleseq;
-	leftseq=0;
-	rightseq=(numMergedSeqs-1);
-	while(leftseq!=rightseq){ // binary search
-		middleseq=(leftseq+rightseq+1)/2; // +1 for ceiling
-		if((*pos)>=mergedSeqsStartPos[middleseq]) leftseq=middleseq;
-		else rightseq=(middleseq-1); // pos < middle ; -1 so the pointers are placed to the left of the pos
-	}
-	(*pos)-=mergedSeqsStartPos[leftseq];
-	return leftseq;
+	unsigned int seqid;
+	seqid=mergedSeqsIdInBlock[((*pos)>>mergedSeqsPosShift)];
+	while((*pos)>=mergedSeqsStartPos[(seqid+1)]) seqid++;
+	(*pos)-=mergedSeqsStartPos[seqid];
+	return (int)seqid;
 }
 
 int GetSeqIdFromSeqName(char *seqname){
@@ -428,3 +1255,18 @@ void ReverseComplementSequence(char *text, int textsize){
 		text[posright]=charleft;
 	}
 }
+
+// Writes the reverse complement of the text to a separate array (that must have at least textsize chars)
+void GetReverseComplementSequence(char *text, char *revtext, unsigned int textsize){
+	unsigned int i;
+	char c;
+	revtext+=textsize;
+	for(i=0;i<textsize;i++){
+		c=text[i];
+		if(c=='A') c='T';
+		else if(c=='C') c='G';
+		else if(c=='G') c='C';
+		else if(c=='T') c='A';
+		(*(--revtext))=c;
+	}
+}
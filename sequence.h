@@ -6,18 +6,45 @@ typedef struct Sequence {
 	int order;
 	char strand;
 	unsigned char fileid;
-	fpos_t sourcefilepos;
+	size_t sourcefilepos;
 	//char *sourcefilename;
 	//FILE *sourcefile;
 } Sequence;
 
+typedef struct SequenceStream {
+	void *file; // FILE, or gzFile if gzip files are supported
+	char *buffer;
+	size_t bufferpos, buffersize;
+	unsigned int minlength;
+	Sequence seq; // last read sequence
+	size_t maxnamesize, maxcharssize;
+} SequenceStream;
+
+typedef struct PackedSequence {
+	unsigned int size;
+	unsigned char *bases; // 4 bases per byte (A=0,C=1,G=2,T=3), with the 'N's stored as 'A's
+	unsigned int *nruns; // start and end (exclusive) positions of each run of 'N's
+	unsigned int numnruns;
+	size_t maxbasessize, maxnruns;
+} PackedSequence;
+
 int numSequences;
 Sequence **allSequences;
 
+void SetSequenceLoadingThreads(int numthreads);
 int LoadSequencesFromFile(char *inputfilename, int loadchars, int mergeseqs, int acgtonly, unsigned int minlength, char *seqnamestring);
 void DeleteAllSequences();
 void LoadSequenceChars(Sequence *seq);
 void FreeSequenceChars(Sequence *seq);
+void PackSequenceChars(char *chars, unsigned int size, PackedSequence *packed);
+void LoadPackedSequenceChars(Sequence *seq, PackedSequence *packed);
+void UnpackSequenceChars(PackedSequence *packed, unsigned int start, unsigned int length, int reverse, char *dest);
+void FreePackedSequence(PackedSequence *packed);
+SequenceStream *OpenSequenceStream(char *filename, int acgtonly, unsigned int minlength);
+SequenceStream *OpenSequenceStreamFromDescriptor(int fd, int acgtonly, unsigned int minlength);
+Sequence *ReadNextSequenceFromStream(SequenceStream *stream);
+void CloseSequenceStream(SequenceStream *stream);
+int IsStreamFile(char *filename);
 int GetSeqIdFromSeqName(char *seqname);
 int GetSeqIdFromMergedSeqsPos(unsigned int *pos);
 /*
@@ -27,3 +54,4 @@ int GetNextCharCode(int seqid);
 */
 void SortSequences(int *seqsizes, int *sortedseqs, int numseqs);
 void ReverseComplementSequence(char *text, int textsize);
+void GetReverseComplementSequence(char *text, char *revtext, unsigned int textsize);
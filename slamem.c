@@ -14,11 +14,14 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <limits.h>
 #include "tools.h"
 #include "sequence.h"
 #include "bwtindex.h"
 #include "lcparray.h"
 #include "graphics.h"
+#include "slamem.h"
 
 #define VERSION "0.8.2"
 
@@ -32,220 +35,2526 @@
 #define PAUSE_AT_EXIT 1
 #endif
 
-#define MATCH_TYPE_CHAR "EAU"
+#if defined(unix) || defined(__unix__) || defined(__APPLE__)
+#define PREFETCH_QUERIES 1 // load the next query sequences in a background thread while the current one is being matched
+#define CONCURRENT_STRANDS 1 // match the reverse strand in another thread at the same time as the forward strand
+#define PARALLEL_SORT 1 // sort the chunks of MEMs of the MEMs file sorter in multiple threads
+#define SERVER_MODE 1 // keep the index in memory and match the queries sent by other processes through a local socket
+#define SHARED_INDEX 1 // map the index files read-only and shared, so all the processes using the same index file share its memory
+#define LOCKED_LIBRARY_BUILDS 1 // let the library build indexes from several threads, by running one build at a time
+#include <pthread.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#endif
+#define MAXREFNAMESIZE 64 // number of chars of the ref names kept in the sorted MEMs files (and compared when sorting the matches)
+#define QUERYPREFETCHDEPTH 1 // number of queries loaded in advance (each one also with its reverse complement if both strands are used)
+
+#define SMEM_MATCH_TYPE 3 // super-maximal exact matches (not contained in any other match in the query)
+#define MS_MATCH_TYPE 4 // matching statistics (length of the longest match starting at each query position)
+
+static const char *matchTypeNames[5] = { "MEM" , "MAM" , "MUM" , "SMEM" , "MS" };
+
+#ifdef DEBUGMEMS
+static char *refText;
+static int refSize;
+#endif
+
+typedef struct _RefStartsTable { // start positions of the refs in an index, with a lookup table like the one of the merged loaded refs
+	unsigned int *starts; // (numRefs+1) positions, the last one right after the separator of the last ref
+	unsigned int *idInBlock; // id of the ref at the first position of each block of positions
+	unsigned int posShift; // log2 of the size of the blocks
+} RefStartsTable;
+
+static char *refLabels = NULL; // names of all the refs already formatted as they are printed in each match line (" <name>\t")
+static unsigned int *refLabelsStart = NULL;
+static unsigned int *refSortRanks = NULL; // order of each ref when the matches are sorted (by name, as in SortMEMsFile)
+static int chainMaxGap = 90, chainMaxDiagDiff = 5, chainMinLength = 65; // limits used when chaining the matches (same defaults as nucmer)
+static int quietMatching = 0; // if set, the progress of each query is not printed
+static FMIndex *refIndex = NULL; // index of the reference(s) loaded by the command line tool
+static SampledLCPArray *refLCPArray = NULL; // sampled LCP array of that index (NULL if only the SMEMs are matched)
+static RefStartsTable *refStarts = NULL; // start positions of the refs in that index (if NULL, they are taken from the merged loaded refs)
+
+// Compares the names of two refs as they are compared when sorting a MEMs file (only up to the first space char)
+int RefNameSortFunction(const void *a, const void *b){
+	char *namea, *nameb, chara, charb;
+	size_t sizea, sizeb, n;
+	namea = (allSequences[*((int *)a)]->name);
+	nameb = (allSequences[*((int *)b)]->name);
+	sizea = strcspn(namea," \t");
+	sizeb = strcspn(nameb," \t");
+	if(sizea>MAXREFNAMESIZE) sizea=MAXREFNAMESIZE; // same size limit of the ref names parsed by SortMEMsFile
+	if(sizeb>MAXREFNAMESIZE) sizeb=MAXREFNAMESIZE;
+	for(n=0;;n++){
+		chara = ((n<sizea)?(namea[n]):'\0');
+		charb = ((n<sizeb)?(nameb[n]):'\0');
+		if(chara!=charb || chara=='\0') return (int)(chara-charb);
+	}
+}
+
+// Formats the names of all the merged refs once, so they only need to be copied to the output in each match
+void CreateRefLabels(int numRefs){
+	unsigned int n;
+	int i, *sortedIds;
+	refLabelsStart=(unsigned int *)malloc((numRefs+1)*sizeof(unsigned int));
+	n=0;
+	for(i=0;i<numRefs;i++){
+		refLabelsStart[i]=n;
+		n+=(unsigned int)(strlen(allSequences[i]->name)+2);
+	}
+	refLabelsStart[numRefs]=n;
+	refLabels=(char *)malloc((n+1)*sizeof(char));
+	for(i=0;i<numRefs;i++) sprintf((refLabels+refLabelsStart[i])," %s\t",(allSequences[i]->name));
+	sortedIds=(int *)malloc(numRefs*sizeof(int));
+	for(i=0;i<numRefs;i++) sortedIds[i]=i;
+	qsort(sortedIds,numRefs,sizeof(int),RefNameSortFunction);
+	refSortRanks=(unsigned int *)malloc(numRefs*sizeof(unsigned int));
+	n=0;
+	for(i=0;i<numRefs;i++){ // refs with the same name get the same rank
+		if(i!=0 && RefNameSortFunction(&(sortedIds[(i-1)]),&(sortedIds[i]))!=0) n++;
+		refSortRanks[sortedIds[i]]=n;
+	}
+	free(sortedIds);
+}
+
+void FreeRefLabels(){
+	if(refLabels!=NULL) free(refLabels);
+	if(refLabelsStart!=NULL) free(refLabelsStart);
+	if(refSortRanks!=NULL) free(refSortRanks);
+	refLabels=NULL;
+	refLabelsStart=NULL;
+	refSortRanks=NULL;
+}
+
+typedef struct _QuerySlot {
+	char *name;
+	char *chars;
+	unsigned int size;
+	Sequence *seq; // loaded query that owns the name and chars, or NULL if they were copied from a streamed file
+	int streamId; // index of the streamed file the query was read from, or -1 for the loaded queries
+	size_t maxNameSize, maxCharsSize;
+	PackedSequence packed; // 2 bits per base (only used if the queries are packed, and then chars is not used)
+} QuerySlot;
+
+#ifdef PREFETCH_QUERIES
+#define NUMQUERYSLOTS (QUERYPREFETCHDEPTH+1) // the slot being matched plus the ones being loaded in advance
+#else
+#define NUMQUERYSLOTS 1
+#endif
+
+typedef struct _QueryReader { // reads the loaded queries first and then the ones from the streamed files, one at a time
+	int nextSeq, numSeqs;
+	int nextStream, numStreams;
+	char **streamFilenames;
+	SequenceStream *stream;
+	int acgtOnly;
+	unsigned int minSeqLength;
+	int packQueries;
+	QuerySlot slots[NUMQUERYSLOTS];
+	#ifdef PREFETCH_QUERIES
+	int numFilledSlots, nextFillSlot, nextReadSlot;
+	char finished;
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t slotFilled, slotFreed;
+	#endif
+} QueryReader;
+
+// Loads the chars of the next query to the slot, and returns 0 if there are no more queries
+int ReadQueryToSlot(QueryReader *reader, QuerySlot *slot){
+	Sequence *seq;
+	char *chars;
+	size_t n;
+	while((reader->nextSeq)<(reader->numSeqs)){ // loaded queries
+		seq=allSequences[(reader->nextSeq)];
+		(reader->nextSeq)++;
+		if(reader->packQueries) LoadPackedSequenceChars(seq,&(slot->packed));
+		else LoadSequenceChars(seq);
+		if((seq->size)<(reader->minSeqLength)){ // the size taken from a FASTA index can be larger than the real one
+			FreeSequenceChars(seq);
+			continue;
+		}
+		slot->name=(seq->name);
+		slot->chars=(seq->chars);
+		slot->size=(seq->size);
+		slot->seq=seq;
+		slot->streamId=(-1);
+		return 1;
+	}
+	while(1){ // streamed queries
+		if((reader->stream)==NULL){
+			if((reader->nextStream)==(reader->numStreams)) return 0;
+			reader->stream=OpenSequenceStream((reader->streamFilenames)[(reader->nextStream)],(reader->acgtOnly),(reader->minSeqLength));
+			if((reader->stream)==NULL){
+				(reader->nextStream)++;
+				continue;
+			}
+		}
+		if((seq=ReadNextSequenceFromStream(reader->stream))!=NULL) break;
+		CloseSequenceStream(reader->stream);
+		reader->stream=NULL;
+		(reader->nextStream)++;
+	}
+	// the stream reuses its arrays for the next sequence, so swap them with the ones of the slot instead of copying the chars
+	chars=(slot->name);
+	slot->name=(seq->name);
+	seq->name=chars;
+	n=(slot->maxNameSize);
+	slot->maxNameSize=(reader->stream->maxnamesize);
+	reader->stream->maxnamesize=n;
+	if(reader->packQueries) PackSequenceChars((seq->chars),(seq->size),&(slot->packed));
+	else {
+		chars=(slot->chars);
+		slot->chars=(seq->chars);
+		seq->chars=chars;
+		n=(slot->maxCharsSize);
+		slot->maxCharsSize=(reader->stream->maxcharssize);
+		reader->stream->maxcharssize=n;
+	}
+	slot->size=(seq->size);
+	slot->seq=NULL;
+	slot->streamId=(reader->nextStream);
+	return 1;
+}
+
+#ifdef PREFETCH_QUERIES
+// Background thread that keeps filling the free slots with the next queries, so that they are ready when the matching needs them
+void *PrefetchQueries(void *arg){
+	QueryReader *reader;
+	QuerySlot *slot;
+	int more;
+	reader=(QueryReader *)arg;
+	while(1){
+		pthread_mutex_lock(&(reader->mutex));
+		while((reader->numFilledSlots)==NUMQUERYSLOTS) pthread_cond_wait(&(reader->slotFreed),&(reader->mutex));
+		slot=&((reader->slots)[(reader->nextFillSlot)]);
+		pthread_mutex_unlock(&(reader->mutex));
+		more=ReadQueryToSlot(reader,slot);
+		pthread_mutex_lock(&(reader->mutex));
+		if(more){
+			reader->nextFillSlot=(((reader->nextFillSlot)+1)%NUMQUERYSLOTS);
+			(reader->numFilledSlots)++;
+		} else reader->finished=1;
+		pthread_cond_signal(&(reader->slotFilled));
+		pthread_mutex_unlock(&(reader->mutex));
+		if(!more) break;
+	}
+	return NULL;
+}
+#endif
+
+QueryReader *OpenQueryReader(int numRefs, int numSeqs, int numStreams, char **streamFilenames, int acgtOnly, unsigned int minSeqLength, int packQueries){
+	QueryReader *reader;
+	reader=(QueryReader *)calloc(1,sizeof(QueryReader));
+	reader->nextSeq=numRefs;
+	reader->numSeqs=numSeqs;
+	reader->nextStream=0;
+	reader->numStreams=numStreams;
+	reader->streamFilenames=streamFilenames;
+	reader->stream=NULL;
+	reader->acgtOnly=acgtOnly;
+	reader->minSeqLength=minSeqLength;
+	reader->packQueries=packQueries;
+	#ifdef PREFETCH_QUERIES
+	reader->numFilledSlots=0;
+	reader->nextFillSlot=0;
+	reader->nextReadSlot=0;
+	reader->finished=0;
+	pthread_mutex_init(&(reader->mutex),NULL);
+	pthread_cond_init(&(reader->slotFilled),NULL);
+	pthread_cond_init(&(reader->slotFreed),NULL);
+	if(pthread_create(&(reader->thread),NULL,PrefetchQueries,(void *)reader)!=0){
+		printf("\n> ERROR: Failed to create query prefetching thread\n");
+		exit(-1);
+	}
+	#endif
+	return reader;
+}
+
+// Returns the slot with the next query, or NULL if there are no more queries
+// NOTE: the slot must be released with ReleaseQuerySlot after it has been processed
+QuerySlot *GetNextQuerySlot(QueryReader *reader){
+	#ifdef PREFETCH_QUERIES
+	QuerySlot *slot;
+	pthread_mutex_lock(&(reader->mutex));
+	while((reader->numFilledSlots)==0 && !(reader->finished)) pthread_cond_wait(&(reader->slotFilled),&(reader->mutex));
+	slot=NULL;
+	if((reader->numFilledSlots)!=0) slot=&((reader->slots)[(reader->nextReadSlot)]);
+	pthread_mutex_unlock(&(reader->mutex));
+	return slot;
+	#else
+	if(!ReadQueryToSlot(reader,&((reader->slots)[0]))) return NULL;
+	return &((reader->slots)[0]);
+	#endif
+}
+
+void ReleaseQuerySlot(QueryReader *reader, QuerySlot *slot){
+	if((slot->seq)!=NULL){ // the chars of the loaded queries are not needed anymore
+		FreeSequenceChars(slot->seq);
+		slot->name=NULL;
+		slot->chars=NULL;
+		slot->seq=NULL;
+	}
+	#ifdef PREFETCH_QUERIES
+	pthread_mutex_lock(&(reader->mutex));
+	reader->nextReadSlot=(((reader->nextReadSlot)+1)%NUMQUERYSLOTS);
+	(reader->numFilledSlots)--;
+	pthread_cond_signal(&(reader->slotFreed));
+	pthread_mutex_unlock(&(reader->mutex));
+	#else
+	(void)reader;
+	#endif
+}
+
+// NOTE: must only be called after all the queries were read (GetNextQuerySlot returned NULL)
+void CloseQueryReader(QueryReader *reader){
+	QuerySlot *slot;
+	int i;
+	#ifdef PREFETCH_QUERIES
+	pthread_join((reader->thread),NULL);
+	pthread_mutex_destroy(&(reader->mutex));
+	pthread_cond_destroy(&(reader->slotFilled));
+	pthread_cond_destroy(&(reader->slotFreed));
+	#endif
+	for(i=0;i<NUMQUERYSLOTS;i++){
+		slot=&((reader->slots)[i]);
+		if((slot->seq)==NULL){ // arrays allocated for the streamed queries
+			if((slot->name)!=NULL) free(slot->name);
+			if((slot->chars)!=NULL) free(slot->chars);
+		}
+		FreePackedSequence(&(slot->packed));
+	}
+	free(reader);
+}
+
+#define QUERYWINDOWSIZE (1<<16) // number of chars extracted at once from a packed query or from the reverse strand
+
+typedef struct _StrandMatcher {
+	char *text; // chars of the forward strand (not used if the query is packed)
+	PackedSequence *packedText;
+	unsigned int textSize;
+	int reverse; // if set, the reverse complement strand is processed, with its chars taken on the fly from the forward strand
+	int numRefs, matchType, minMatchSize;
+	int statsPositions; // if set, the matching statistics also include one position in the reference for each run
+	int countOnly; // if set, the matches are only counted (with their lengths), and their positions are never located
+	int maxTopMatches; // if not 0, only this number of the longest matches are kept (and written at the end of the strand)
+	int sortMatches; // if set, the matches are kept in memory and written sorted at the end of the strand
+	int chainMatches; // if set, the matches kept in memory are chained at the end of the strand, and only the chains are written
+	struct _SortedMatch *sortedMatches[2]; // matches on the forward and on the reverse strand of the reference
+	size_t numSortedMatches[2], maxNumSortedMatches[2];
+	FILE *outputFile;
+	unsigned int refReverseStart; // position where the reverse strand of the reference starts in the index (or UINT_MAX if not indexed)
+	FILE *reverseHitsFile; // where the hits on the reverse strand of the reference are written
+	int numReverseMatches;
+	long long int sumReverseMatchesSize;
+	FMIndex *fmi; // index being matched (its sampled LCP array is reached through the intervals cache)
+	LCPIntervalCache *intervalCache;
+	RefStartsTable *refStarts; // start positions of the refs in the index (if NULL, they are taken from the merged loaded refs)
+	SlamemMatchCallback matchCallback; // if set, each match is reported to this function instead of being written to the output file
+	void *callbackData;
+	int showProgress;
+	char *window;
+	int numMatches;
+	long long int sumMatchesSize;
+} StrandMatcher;
+
+// Fills the window of chars of the query strand that ends at this position, and returns the char at that position
+// NOTE: the chars of the reverse strand are complemented from the forward strand (or unpacked) one window at a time, so the query
+//  buffer is never modified and both strands can be processed at the same time
+char FillQueryWindow(StrandMatcher *matcher, unsigned int pos, unsigned int *windowStart){
+	unsigned int start, length;
+	start=((pos>=QUERYWINDOWSIZE)?(pos+1-QUERYWINDOWSIZE):0);
+	length=(pos+1-start);
+	if((matcher->packedText)!=NULL) UnpackSequenceChars((matcher->packedText),start,length,(matcher->reverse),(matcher->window));
+	else GetReverseComplementSequence(((matcher->text)+((matcher->textSize)-start-length)),(matcher->window),length);
+	(*windowStart)=start;
+	return (matcher->window)[(pos-start)];
+}
+
+// NOTE: the query is processed from right to left, so the window of chars only needs to be refilled when a position to its left is read
+#define QUERYCHAR(pos) (((pos)>=windowStart)?(window[((pos)-windowStart)]):(FillQueryWindow(matcher,(pos),&windowStart)))
+
+typedef struct _SortedMatch {
+	unsigned int refRank; // order of the ref by name
+	unsigned int refPos; // position inside the ref
+	unsigned int queryPos;
+	int refId;
+	int matchSize;
+} SortedMatch;
+
+// Creates the lookup table of the refs in an index from the array of their start positions (which must have space for numRefs+1
+//  positions, and is then owned by the table), as done by InitializeMergedSeqsLookupTable for the merged loaded refs
+// NOTE: the blocks have the size of the highest power of two not larger than the shortest ref, so each block has at most one ref
+//  start inside it, but the blocks are made larger if needed to keep the table size proportional to the number of refs
+RefStartsTable *NewRefStartsTable(unsigned int *starts, int numRefs, unsigned int textSize){
+	RefStartsTable *table;
+	unsigned int refId, pos, minSize, numBlocks, block;
+	table=(RefStartsTable *)malloc(sizeof(RefStartsTable));
+	starts[numRefs]=(textSize+1); // fake start after the last ref (as if it also had a separator)
+	table->starts=starts;
+	minSize=UINT_MAX; // size of the shortest ref (plus its separator)
+	for(refId=0;refId<(unsigned int)numRefs;refId++){
+		pos=(starts[(refId+1)]-starts[refId]);
+		if(pos<minSize) minSize=pos;
+	}
+	table->posShift=0;
+	while((2UL<<(table->posShift))<=(unsigned long)minSize && (table->posShift)<31) (table->posShift)++;
+	while((textSize>>(table->posShift))>(8U*(unsigned int)numRefs)) (table->posShift)++; // at most 8 blocks per ref
+	numBlocks=((textSize>>(table->posShift))+1);
+	table->idInBlock=(unsigned int *)malloc(numBlocks*sizeof(unsigned int));
+	refId=0;
+	for(block=0;block<numBlocks;block++){
+		pos=(block<<(table->posShift));
+		while(pos>=starts[(refId+1)]) refId++;
+		(table->idInBlock)[block]=refId;
+	}
+	return table;
+}
+
+void FreeRefStartsTable(RefStartsTable *table){
+	if(table==NULL) return;
+	free(table->starts);
+	free(table->idInBlock);
+	free(table);
+}
+
+// Returns the id of the ref that contains this position of the index, and updates the position to be inside that ref
+// NOTE: as in GetSeqIdFromMergedSeqsPos, the lookup table gives the ref at the start of the block containing the position, and the
+//  following refs starting inside the same block are checked next
+int GetRefIdFromIndexPos(RefStartsTable *table, unsigned int *pos){
+	unsigned int refId;
+	refId=(table->idInBlock)[((*pos)>>(table->posShift))];
+	while((*pos)>=(table->starts)[(refId+1)]) refId++;
+	(*pos)-=(table->starts)[refId];
+	return (int)refId;
+}
+
+// Returns the id of the ref that contains this position of the index of the matcher, and updates the position to be inside that ref
+int GetMatcherRefId(StrandMatcher *matcher, unsigned int *refPos){
+	if((matcher->refStarts)!=NULL) return GetRefIdFromIndexPos((matcher->refStarts),refPos);
+	return GetSeqIdFromMergedSeqsPos(refPos);
+}
+
+#ifdef DEBUGMEMS
+// Writes one match together with the chars around its start and end in the reference and in the query (to check that it is maximal)
+void WriteDebugMatch(StrandMatcher *matcher, unsigned int refPos, unsigned int queryPos, int matchSize){
+	FILE *outputFile;
+	char *text;
+	outputFile=(matcher->outputFile);
+	text=(matcher->text);
+	fprintf(outputFile,"%u\t%d\t%d",(refPos+1),(queryPos+1),matchSize);
+	fputc('\t',outputFile);
+	fputc((refPos==0)?('$'):(refText[refPos-1]+32),outputFile);
+	fprintf(outputFile,"%.*s...%.*s",4,(char *)(refText+refPos),4,(char *)(refText+refPos+matchSize-4));
+	fputc(((refPos+matchSize)==(unsigned int)refSize)?('$'):(refText[refPos+matchSize]+32),outputFile);
+	fputc('\t',outputFile);
+	fputc((queryPos==0)?('$'):(text[queryPos-1]+32),outputFile);
+	fprintf(outputFile,"%.*s...%.*s",4,(char *)(text+queryPos),4,(char *)(text+queryPos+matchSize-4));
+	fputc(((queryPos+matchSize)==(matcher->textSize))?('$'):(text[queryPos+matchSize]+32),outputFile);
+	fputc('\n',outputFile);
+}
+#endif
+
+// Writes one match at this position of the index, and returns 1 if it was on the reverse strand of the reference (so it was written
+//  to the file of the reverse strand), or 0 if not
+// NOTE: if the matches are being sorted, the match is only added to the buffer of its strand, to be written by WriteSortedMatches
+// NOTE: if the matcher has a callback, the match is reported to it instead, with the strand of the query it was found on
+int WriteIndexMatch(StrandMatcher *matcher, unsigned int refPos, unsigned int queryPos, int matchSize){
+	FILE *hitsFile;
+	SortedMatch *sortedMatch;
+	int refId, reverse;
+	#ifdef DEBUGMEMS
+	WriteDebugMatch(matcher,refPos,queryPos,matchSize);
+	return 0;
+	#endif
+	hitsFile=(matcher->outputFile);
+	reverse=0;
+	if( refPos >= (matcher->refReverseStart) ){ // position in the forward strands of the reference and of the reverse strand of the query
+		refPos = ( (2*(matcher->refReverseStart)) - 1 - refPos - (unsigned int)matchSize );
+		queryPos = ( (matcher->textSize) - queryPos - (unsigned int)matchSize );
+		hitsFile = (matcher->reverseHitsFile);
+		reverse = 1;
+	}
+	refId = 0;
+	if((matcher->numRefs)!=1) refId = GetMatcherRefId(matcher,&refPos); // multiple refs
+	if((matcher->matchCallback)!=NULL){
+		(matcher->matchCallback)((matcher->callbackData),refId,refPos,queryPos,matchSize,((matcher->reverse)!=reverse));
+		return reverse;
+	}
+	if(matcher->sortMatches){
+		if((matcher->numSortedMatches[reverse])==(matcher->maxNumSortedMatches[reverse])){
+			(matcher->maxNumSortedMatches[reverse])*=2;
+			(matcher->sortedMatches[reverse])=(SortedMatch *)realloc((matcher->sortedMatches[reverse]),(matcher->maxNumSortedMatches[reverse])*sizeof(SortedMatch));
+			if((matcher->sortedMatches[reverse])==NULL){
+				printf("\n> ERROR: Not enough memory to sort the matches\n");
+				exit(-1);
+			}
+		}
+		sortedMatch=&((matcher->sortedMatches[reverse])[(matcher->numSortedMatches[reverse])++]);
+		sortedMatch->refRank=(((matcher->numRefs)!=1)?(refSortRanks[refId]):0);
+		sortedMatch->refPos=refPos;
+		sortedMatch->queryPos=queryPos;
+		sortedMatch->refId=refId;
+		sortedMatch->matchSize=matchSize;
+		return reverse;
+	}
+	if((matcher->numRefs)!=1) fwrite((refLabels+refLabelsStart[refId]),sizeof(char),(size_t)(refLabelsStart[(refId+1)]-refLabelsStart[refId]),hitsFile);
+	fprintf(hitsFile,"%u\t%d\t%d\n",(refPos+1),(queryPos+1),matchSize);
+	return reverse;
+}
+
+// Writes one match at this position of the index (as in WriteIndexMatch), and adds it to the counts of the strand it was found on
+void ReportIndexMatch(StrandMatcher *matcher, unsigned int refPos, unsigned int queryPos, int matchSize){
+	if(WriteIndexMatch(matcher,refPos,queryPos,matchSize)){ // hit on the reverse strand of the reference
+		(matcher->numReverseMatches)++;
+		(matcher->sumReverseMatchesSize)+=matchSize;
+	} else {
+		(matcher->numMatches)++;
+		(matcher->sumMatchesSize)+=matchSize;
+	}
+}
+
+// Sorts the matches by ref (name), ref position and query position, with an LSD radix sort on the bytes of these integer keys
+// NOTE: the passes over the bytes that are equal in all the matches (e.g. the high bytes of small positions) are skipped
+SortedMatch *RadixSortMatches(SortedMatch *matches, SortedMatch *tempMatches, size_t numMatches){
+	SortedMatch *swapMatches;
+	unsigned int key, shift;
+	size_t counts[256], i, sum;
+	int k, pass;
+	for(pass=0;pass<12;pass++){ // 4 bytes of each key, from the least significant key to the most one
+		shift=(8*(pass&3));
+		for(k=0;k<256;k++) counts[k]=0;
+		for(i=0;i<numMatches;i++){
+			key=((pass<4)?(matches[i].queryPos):((pass<8)?(matches[i].refPos):(matches[i].refRank)));
+			counts[((key>>shift)&0xFF)]++;
+		}
+		for(k=0;k<256;k++) if(counts[k]==numMatches) break;
+		if(k!=256) continue; // all matches have the same byte here
+		sum=0;
+		for(k=0;k<256;k++){
+			i=counts[k];
+			counts[k]=sum;
+			sum+=i;
+		}
+		for(i=0;i<numMatches;i++){
+			key=((pass<4)?(matches[i].queryPos):((pass<8)?(matches[i].refPos):(matches[i].refRank)));
+			tempMatches[(counts[((key>>shift)&0xFF)]++)]=matches[i];
+		}
+		swapMatches=matches;
+		matches=tempMatches;
+		tempMatches=swapMatches;
+	}
+	return matches;
+}
+
+#define CHAINDIAGFACTOR 0.12 // the diagonal difference allowed between consecutive matches of a chain also grows with the gap between them
+
+typedef struct _MatchChainer {
+	SortedMatch *anchors; // matches of one ref, sorted by ref position
+	int numAnchors;
+	int *tree; // segment tree with the best chain score ending at each active anchor (or -1), with the anchors ordered by query end position
+	int treeSize;
+	int *anchorsByQueryEnd, *leafOfAnchor, *anchorsByRefEnd;
+	unsigned int *queryEnds; // query end position of the anchor at each leaf
+	int *scores, *predecessors;
+	char *usedAnchors;
+	unsigned int *keys;
+	unsigned long long *sortKeys;
+} MatchChainer;
+
+int ChainKeySortFunction(const void *a, const void *b){
+	if((*(unsigned long long *)a)==(*(unsigned long long *)b)) return 0;
+	return (((*(unsigned long long *)a)>(*(unsigned long long *)b))?1:(-1));
+}
+
+// Sorts the anchors by the given keys (ties are broken by anchor number) and stores their order in the array
+// NOTE: the keys are packed with the anchor number in the low 32 bits, so that no global context is needed by qsort (the strands can be chained in parallel)
+void SortAnchorsByKey(unsigned int *keys, int numAnchors, unsigned long long *sortKeys, int *sortedAnchors){
+	int i;
+	for(i=0;i<numAnchors;i++) sortKeys[i]=((((unsigned long long)keys[i])<<32)|(unsigned long long)i);
+	qsort(sortKeys,numAnchors,sizeof(unsigned long long),ChainKeySortFunction);
+	for(i=0;i<numAnchors;i++) sortedAnchors[i]=(int)(sortKeys[i]&0xFFFFFFFFULL);
+}
+
+// Sets the best chain score of the anchor at this leaf (or -1 to remove it) and updates the maximums of all its ancestors
+void SetChainTreeLeaf(MatchChainer *chainer, int leaf, int score){
+	int node, left, right;
+	node=((chainer->treeSize)+leaf);
+	(chainer->tree)[node]=score;
+	while(node!=1){
+		node>>=1;
+		left=(chainer->tree)[(2*node)];
+		right=(chainer->tree)[(2*node+1)];
+		(chainer->tree)[node]=((left>right)?left:right);
+	}
+}
+
+// Branch and bound search for the active anchor with the highest score inside the range of leaves that can precede the anchor i (on a close enough diagonal)
+// NOTE: the ref and query gaps are already limited by the active anchors and by the range of leaves, so only the diagonal difference is checked here
+void FindChainPredecessor(MatchChainer *chainer, int i, int node, int nodeStart, int nodeEnd, int firstLeaf, int lastLeaf, int maxGap, int maxDiagDiff, int *bestScore, int *bestAnchor){
+	SortedMatch *anchor, *prevAnchor;
+	int j, refGap, queryGap, diagDiff, gap, middle;
+	if((chainer->tree)[node]<=(*bestScore) || nodeEnd<firstLeaf || nodeStart>lastLeaf) return;
+	if(nodeStart==nodeEnd){
+		j=(chainer->anchorsByQueryEnd)[nodeStart];
+		anchor=&((chainer->anchors)[i]);
+		prevAnchor=&((chainer->anchors)[j]);
+		if((prevAnchor->refId)!=(anchor->refId)) return;
+		refGap=(int)((anchor->refPos)-((prevAnchor->refPos)+(unsigned int)(prevAnchor->matchSize)));
+		queryGap=(int)((anchor->queryPos)-((prevAnchor->queryPos)+(unsigned int)(prevAnchor->matchSize)));
+		if(refGap<0 || queryGap<0 || refGap>maxGap || queryGap>maxGap) return;
+		diagDiff=((refGap>queryGap)?(refGap-queryGap):(queryGap-refGap));
+		gap=((refGap>queryGap)?refGap:queryGap);
+		if(diagDiff>maxDiagDiff && (double)diagDiff>(CHAINDIAGFACTOR*(double)gap)) return;
+		(*bestScore)=(chainer->tree)[node];
+		(*bestAnchor)=j;
+		return;
+	}
+	middle=((nodeStart+nodeEnd)/2);
+	if((chainer->tree)[(2*node)]>=(chainer->tree)[(2*node+1)]){ // the most promising subtree is searched first
+		FindChainPredecessor(chainer,i,(2*node),nodeStart,middle,firstLeaf,lastLeaf,maxGap,maxDiagDiff,bestScore,bestAnchor);
+		FindChainPredecessor(chainer,i,(2*node+1),(middle+1),nodeEnd,firstLeaf,lastLeaf,maxGap,maxDiagDiff,bestScore,bestAnchor);
+	} else {
+		FindChainPredecessor(chainer,i,(2*node+1),(middle+1),nodeEnd,firstLeaf,lastLeaf,maxGap,maxDiagDiff,bestScore,bestAnchor);
+		FindChainPredecessor(chainer,i,(2*node),nodeStart,middle,firstLeaf,lastLeaf,maxGap,maxDiagDiff,bestScore,bestAnchor);
+	}
+}
+
+// Sparse dynamic programming over the anchors (sorted by ref position): the best chain ending at each anchor extends the best one among the
+// anchors that end before it in both sequences, within the gap and diagonal limits, found with a max segment tree over their query end positions
+void ChainAnchors(MatchChainer *chainer, int maxGap, int maxDiagDiff){
+	SortedMatch *anchor;
+	unsigned int refEnd, queryStart;
+	int numAnchors, i, k, n, activated, deactivated, firstLeaf, lastLeaf, left, right, bestScore, bestAnchor;
+	numAnchors=(chainer->numAnchors);
+	for(i=0;i<numAnchors;i++) (chainer->keys)[i]=(((chainer->anchors)[i].queryPos)+(unsigned int)((chainer->anchors)[i].matchSize));
+	SortAnchorsByKey((chainer->keys),numAnchors,(chainer->sortKeys),(chainer->anchorsByQueryEnd));
+	for(i=0;i<numAnchors;i++) (chainer->keys)[i]=(((chainer->anchors)[i].refPos)+(unsigned int)((chainer->anchors)[i].matchSize));
+	SortAnchorsByKey((chainer->keys),numAnchors,(chainer->sortKeys),(chainer->anchorsByRefEnd));
+	for(k=0;k<numAnchors;k++){
+		n=(chainer->anchorsByQueryEnd)[k];
+		(chainer->leafOfAnchor)[n]=k;
+		(chainer->queryEnds)[k]=(((chainer->anchors)[n].queryPos)+(unsigned int)((chainer->anchors)[n].matchSize));
+	}
+	chainer->treeSize=1;
+	while((chainer->treeSize)<numAnchors) (chainer->treeSize)<<=1;
+	for(k=1;k<(2*(chainer->treeSize));k++) (chainer->tree)[k]=(-1);
+	activated=0;
+	deactivated=0;
+	for(i=0;i<numAnchors;i++){
+		anchor=&((chainer->anchors)[i]);
+		while(activated<numAnchors){ // the anchors that end before this one starts in the ref can now precede it
+			n=(chainer->anchorsByRefEnd)[activated];
+			refEnd=(((chainer->anchors)[n].refPos)+(unsigned int)((chainer->anchors)[n].matchSize));
+			if(refEnd>(anchor->refPos)) break;
+			SetChainTreeLeaf(chainer,(chainer->leafOfAnchor)[n],(chainer->scores)[n]);
+			activated++;
+		}
+		while(deactivated<activated){ // the anchors that end too far behind in the ref cannot precede this one nor any of the next ones
+			n=(chainer->anchorsByRefEnd)[deactivated];
+			refEnd=(((chainer->anchors)[n].refPos)+(unsigned int)((chainer->anchors)[n].matchSize));
+			if(((anchor->refPos)-refEnd)<=(unsigned int)maxGap) break;
+			SetChainTreeLeaf(chainer,(chainer->leafOfAnchor)[n],(-1));
+			deactivated++;
+		}
+		queryStart=(anchor->queryPos);
+		left=0; // first leaf with query end position >= queryStart-maxGap
+		right=numAnchors;
+		while(left<right){
+			k=((left+right)/2);
+			if((chainer->queryEnds)[k]+(unsigned int)maxGap<queryStart) left=(k+1);
+			else right=k;
+		}
+		firstLeaf=left;
+		right=numAnchors; // last leaf with query end position <= queryStart
+		while(left<right){
+			k=((left+right)/2);
+			if((chainer->queryEnds)[k]<=queryStart) left=(k+1);
+			else right=k;
+		}
+		lastLeaf=(left-1);
+		bestScore=0;
+		bestAnchor=(-1);
+		if(firstLeaf<=lastLeaf) FindChainPredecessor(chainer,i,1,0,((chainer->treeSize)-1),firstLeaf,lastLeaf,maxGap,maxDiagDiff,&bestScore,&bestAnchor);
+		(chainer->scores)[i]=(bestScore+(anchor->matchSize));
+		(chainer->predecessors)[i]=bestAnchor;
+	}
+}
+
+// Chains the matches of each ref and writes the chains long enough (by decreasing score), each one followed by its matches
+// NOTE: each match belongs to at most one chain, so a chain that reaches a match already used by a better chain is cut at that point
+void WriteMatchChains(StrandMatcher *matcher, SortedMatch *matches, size_t numMatches, FILE *hitsFile){
+	MatchChainer chainer;
+	SortedMatch *anchor;
+	int *chainEnds, *chainAnchors, groupStart, groupEnd, numChainAnchors, chainScore, i, k, n, refId, numAnchors;
+	if(numMatches==0) return;
+	if(numMatches>(size_t)(INT_MAX/4)){ // the anchors are indexed by ints, including the 4 nodes per anchor of the tree
+		printf("\n> ERROR: Too many matches to chain (%llu)\n",(unsigned long long)numMatches);
+		exit(-1);
+	}
+	chainer.tree=(int *)malloc(4*numMatches*sizeof(int));
+	chainer.anchorsByQueryEnd=(int *)malloc(numMatches*sizeof(int));
+	chainer.leafOfAnchor=(int *)malloc(numMatches*sizeof(int));
+	chainer.anchorsByRefEnd=(int *)malloc(numMatches*sizeof(int));
+	chainer.queryEnds=(unsigned int *)malloc(numMatches*sizeof(unsigned int));
+	chainer.scores=(int *)malloc(numMatches*sizeof(int));
+	chainer.predecessors=(int *)malloc(numMatches*sizeof(int));
+	chainer.usedAnchors=(char *)malloc(numMatches*sizeof(char));
+	chainer.keys=(unsigned int *)malloc(numMatches*sizeof(unsigned int));
+	chainer.sortKeys=(unsigned long long *)malloc(numMatches*sizeof(unsigned long long));
+	chainEnds=(int *)malloc(numMatches*sizeof(int));
+	chainAnchors=(int *)malloc(numMatches*sizeof(int));
+	if(chainer.tree==NULL || chainer.anchorsByQueryEnd==NULL || chainer.leafOfAnchor==NULL || chainer.anchorsByRefEnd==NULL || chainer.queryEnds==NULL || chainer.scores==NULL
+			|| chainer.predecessors==NULL || chainer.usedAnchors==NULL || chainer.keys==NULL || chainer.sortKeys==NULL || chainEnds==NULL || chainAnchors==NULL){
+		printf("\n> ERROR: Not enough memory to chain the matches\n");
+		exit(-1);
+	}
+	numAnchors=(int)numMatches;
+	for(groupStart=0;groupStart<numAnchors;groupStart=groupEnd){ // the matches are sorted by ref, so the matches of each ref are processed together
+		groupEnd=(groupStart+1);
+		while(groupEnd<numAnchors && matches[groupEnd].refRank==matches[groupStart].refRank) groupEnd++;
+		chainer.anchors=(matches+groupStart);
+		chainer.numAnchors=(groupEnd-groupStart);
+		ChainAnchors(&chainer,chainMaxGap,chainMaxDiagDiff);
+		for(i=0;i<(chainer.numAnchors);i++){
+			chainer.keys[i]=(unsigned int)(INT_MAX-chainer.scores[i]); // by decreasing score
+			chainer.usedAnchors[i]=0;
+		}
+		SortAnchorsByKey(chainer.keys,(chainer.numAnchors),chainer.sortKeys,chainEnds);
+		for(k=0;k<(chainer.numAnchors);k++){
+			i=chainEnds[k];
+			if(chainer.usedAnchors[i]) continue;
+			numChainAnchors=0;
+			while(i!=(-1) && !(chainer.usedAnchors[i])){
+				chainer.usedAnchors[i]=1;
+				chainAnchors[(numChainAnchors++)]=i;
+				i=chainer.predecessors[i];
+			}
+			chainScore=(chainer.scores[chainEnds[k]]-((i==(-1))?0:(chainer.scores[i])));
+			if(chainScore<chainMinLength) continue;
+			anchor=&(chainer.anchors[chainAnchors[(numChainAnchors-1)]]); // first match of the chain
+			i=chainAnchors[0]; // last match of the chain
+			refId=(anchor->refId);
+			fprintf(hitsFile,"chain");
+			if((matcher->numRefs)!=1) fwrite((refLabels+refLabelsStart[refId]),sizeof(char),(size_t)(refLabelsStart[(refId+1)]-refLabelsStart[refId]),hitsFile);
+			else fputc('\t',hitsFile);
+			fprintf(hitsFile,"%u\t%u\t%u\t%u\t%d\t%d\n",((anchor->refPos)+1),((anchor->queryPos)+1),
+				((chainer.anchors[i].refPos)+(unsigned int)(chainer.anchors[i].matchSize)-(anchor->refPos)),
+				((chainer.anchors[i].queryPos)+(unsigned int)(chainer.anchors[i].matchSize)-(anchor->queryPos)),
+				chainScore,numChainAnchors);
+			for(n=(numChainAnchors-1);n>=0;n--){
+				anchor=&(chainer.anchors[chainAnchors[n]]);
+				if((matcher->numRefs)!=1) fwrite((refLabels+refLabelsStart[refId]),sizeof(char),(size_t)(refLabelsStart[(refId+1)]-refLabelsStart[refId]),hitsFile);
+				fprintf(hitsFile,"%u\t%d\t%d\n",((anchor->refPos)+1),((anchor->queryPos)+1),(anchor->matchSize));
+			}
+		}
+	}
+	free(chainer.tree);
+	free(chainer.anchorsByQueryEnd);
+	free(chainer.leafOfAnchor);
+	free(chainer.anchorsByRefEnd);
+	free(chainer.queryEnds);
+	free(chainer.scores);
+	free(chainer.predecessors);
+	free(chainer.usedAnchors);
+	free(chainer.keys);
+	free(chainer.sortKeys);
+	free(chainEnds);
+	free(chainAnchors);
+}
+
+// Allocates the buffers where the matches of both strands of the reference are kept until they are sorted
+void InitSortedMatches(StrandMatcher *matcher){
+	int s;
+	if(!(matcher->sortMatches)) return;
+	for(s=0;s<2;s++){
+		matcher->maxNumSortedMatches[s]=1024;
+		matcher->numSortedMatches[s]=0;
+		matcher->sortedMatches[s]=(SortedMatch *)malloc((matcher->maxNumSortedMatches[s])*sizeof(SortedMatch));
+	}
+}
+
+// Sorts and writes the matches of both strands of the reference (in the same order as SortMEMsFile), or their chains, and frees their buffers
+void WriteSortedMatches(StrandMatcher *matcher){
+	SortedMatch *matches, *tempMatches;
+	FILE *hitsFile;
+	size_t i;
+	int s, refId;
+	if(!(matcher->sortMatches)) return;
+	for(s=0;s<2;s++){
+		hitsFile=((s==0)?(matcher->outputFile):(matcher->reverseHitsFile));
+		tempMatches=(SortedMatch *)malloc(((matcher->numSortedMatches[s])+1)*sizeof(SortedMatch));
+		if(tempMatches==NULL){
+			printf("\n> ERROR: Not enough memory to sort the matches\n");
+			exit(-1);
+		}
+		matches=RadixSortMatches((matcher->sortedMatches[s]),tempMatches,(matcher->numSortedMatches[s]));
+		if(matcher->chainMatches) WriteMatchChains(matcher,matches,(matcher->numSortedMatches[s]),hitsFile);
+		else for(i=(matcher->numSortedMatches[s]);i!=0;){ // by decreasing order, as in the sorted MEMs files
+			i--;
+			refId=matches[i].refId;
+			if((matcher->numRefs)!=1) fwrite((refLabels+refLabelsStart[refId]),sizeof(char),(size_t)(refLabelsStart[(refId+1)]-refLabelsStart[refId]),hitsFile);
+			fprintf(hitsFile,"%u\t%d\t%d\n",(matches[i].refPos+1),(matches[i].queryPos+1),matches[i].matchSize);
+		}
+		free(matcher->sortedMatches[s]);
+		free(tempMatches);
+		matcher->sortedMatches[s]=NULL;
+	}
+}
+
+typedef struct _TopMatch {
+	unsigned int refPos; // position in the index (in the reverse strand of the reference if both strands are indexed)
+	unsigned int queryPos;
+	int matchSize;
+} TopMatch;
+
+// Adds a match to the min-heap of the longest matches, replacing the shortest one if the heap is full (it must be shorter)
+void AddTopMatch(TopMatch *topMatches, int *numTopMatches, int maxTopMatches, unsigned int refPos, unsigned int queryPos, int matchSize){
+	TopMatch newMatch;
+	int i, k;
+	newMatch.refPos=refPos;
+	newMatch.queryPos=queryPos;
+	newMatch.matchSize=matchSize;
+	if((*numTopMatches)<maxTopMatches){ // sift up from the last position
+		i=(*numTopMatches);
+		(*numTopMatches)++;
+		while(i!=0 && topMatches[((i-1)/2)].matchSize>matchSize){
+			topMatches[i]=topMatches[((i-1)/2)];
+			i=((i-1)/2);
+		}
+	} else { // sift down from the root
+		i=0;
+		while((k=(2*i+1))<maxTopMatches){
+			if((k+1)<maxTopMatches && topMatches[(k+1)].matchSize<topMatches[k].matchSize) k++;
+			if(topMatches[k].matchSize>=matchSize) break;
+			topMatches[i]=topMatches[k];
+			i=k;
+		}
+	}
+	topMatches[i]=newMatch;
+}
+
+// Reports the occurrence of a match at this BWT position, or, in top-K mode, adds it to the heap of the longest matches
+// NOTE: in top-K mode, the position of the occurrence is only located if the match is longer than the shortest one in the full heap
+void ReportIntervalMatch(StrandMatcher *matcher, TopMatch *topMatches, int *numTopMatches, unsigned int bwtPos, unsigned int queryPos, int matchSize){
+	if(topMatches!=NULL){
+		if( (*numTopMatches) < (matcher->maxTopMatches) || matchSize > (topMatches[0].matchSize) ) AddTopMatch(topMatches,numTopMatches,(matcher->maxTopMatches),FMI_PositionInText((matcher->fmi),bwtPos),queryPos,matchSize);
+		return;
+	}
+	ReportIndexMatch(matcher,FMI_PositionInText((matcher->fmi),bwtPos),queryPos,matchSize);
+}
+
+int TopMatchSortFunction(const void *a, const void *b){
+	int diff;
+	diff = ((((TopMatch *)b)->matchSize) - (((TopMatch *)a)->matchSize)); // longest first
+	if(diff==0){
+		if((((TopMatch *)a)->queryPos) != (((TopMatch *)b)->queryPos)) diff = ((((TopMatch *)a)->queryPos) < (((TopMatch *)b)->queryPos))?(-1):(1);
+		else if((((TopMatch *)a)->refPos) != (((TopMatch *)b)->refPos)) diff = ((((TopMatch *)a)->refPos) < (((TopMatch *)b)->refPos))?(-1):(1);
+	}
+	return diff;
+}
+
+// Returns the number of BWT positions in the range [start,end) whose char is not c (i.e., the left-maximal occurrences of a match)
+unsigned int CountLeftMaximalOccurrences(FMIndex *fmi, unsigned int start, unsigned int end, char c){
+	unsigned int topPtr, bottomPtr;
+	if(start>=end) return 0;
+	if(c=='\0') return (end-start); // at the start of the query, all occurrences are left-maximal
+	topPtr=start;
+	bottomPtr=(end-1);
+	return ((end-start)-FMI_FollowLetter(fmi,c,&topPtr,&bottomPtr)); // number of positions with that char
+}
+
+// Adds the query interval [start,end) to the stack of disjoint covered intervals (sorted from right to left, with the leftmost on top)
+// NOTE: the intervals are added by decreasing start position, so they can only overlap the ones at the top of the stack
+void AddCoveredInterval(unsigned int start, unsigned int end, unsigned int **coveredIntervals, int *numCoveredIntervals, int *maxNumCoveredIntervals){
+	unsigned int *intervals;
+	int n;
+	intervals=(*coveredIntervals);
+	n=(*numCoveredIntervals);
+	while(n!=0 && intervals[(2*(n-1))]<=end){ // merge with the overlapping (or adjacent) intervals
+		n--;
+		if(intervals[(2*n+1)]>end) end=intervals[(2*n+1)];
+	}
+	if(n==(*maxNumCoveredIntervals)){
+		(*maxNumCoveredIntervals)*=2;
+		intervals=(unsigned int *)realloc(intervals,2*(*maxNumCoveredIntervals)*sizeof(unsigned int));
+		(*coveredIntervals)=intervals;
+	}
+	intervals[(2*n)]=start;
+	intervals[(2*n+1)]=end;
+	(*numCoveredIntervals)=(n+1);
+}
+
+// Finds all the matches of one strand of a query sequence against the index and writes them to the output file of the matcher
+// NOTE: if the index also contains the reverse strand of the reference, its hits are written in forward strand coordinates (of both
+//  the reference and the reverse strand of the query) to a separate file, as if the reverse strand of the query had been matched
+// NOTE: in count mode, the number of left-maximal occurrences of each interval is taken from the counts of the char to the left, and
+//  only a summary of the matches (total count, covered query bases and histogram of lengths) is written to the output file
+// NOTE: in top-K mode, the occurrences are only located if they are longer than the shortest match in the heap, and once the heap is
+//  full, the parent intervals are no longer processed when they cannot beat it either (their matches are always shorter)
+void *MatchQueryStrand(void *arg){
+	StrandMatcher *matcher;
+	FMIndex *fmi;
+	FILE *outputFile;
+	int depth, matchSize, matchType, minMatchSize;
+	unsigned int j, textsize;
+	long long int *lengthCounts;
+	unsigned int *coveredIntervals;
+	int countOnly, maxLengthCount, numCoveredIntervals, maxNumCoveredIntervals, k;
+	TopMatch *topMatches;
+	int numTopMatches, maxTopMatches;
+	unsigned int topPtr, bottomPtr, prevTopPtr, prevBottomPtr, savedTopPtr, savedBottomPtr, n;
+	char c, *window;
+	unsigned int windowStart;
+	int progressCounter, progressStep;
+	matcher=(StrandMatcher *)arg;
+	fmi=(matcher->fmi);
+	outputFile=(matcher->outputFile);
+	matchType=(matcher->matchType);
+	minMatchSize=(matcher->minMatchSize);
+	textsize=(matcher->textSize);
+	matcher->numMatches=0; // the matches on the reverse strand of the reference are counted separately by ReportIndexMatch
+	matcher->sumMatchesSize=0;
+	matcher->numReverseMatches=0;
+	matcher->sumReverseMatchesSize=0;
+	countOnly=(matcher->countOnly);
+	lengthCounts=NULL;
+	coveredIntervals=NULL;
+	maxLengthCount=0;
+	numCoveredIntervals=0;
+	maxNumCoveredIntervals=0;
+	if(countOnly){
+		maxLengthCount=(2*minMatchSize);
+		lengthCounts=(long long int *)calloc((maxLengthCount+1),sizeof(long long int));
+		maxNumCoveredIntervals=1024;
+		coveredIntervals=(unsigned int *)malloc(2*maxNumCoveredIntervals*sizeof(unsigned int));
+	}
+	maxTopMatches=(matcher->maxTopMatches);
+	numTopMatches=0;
+	topMatches=NULL;
+	if(maxTopMatches!=0) topMatches=(TopMatch *)malloc(maxTopMatches*sizeof(TopMatch));
+	InitSortedMatches(matcher);
+	if((matcher->packedText)!=NULL || (matcher->reverse)){
+		window=(matcher->window);
+		windowStart=textsize; // empty window
+	} else {
+		window=(matcher->text);
+		windowStart=0; // the window is the whole text
+	}
+	progressStep=(textsize/10);
+	progressCounter=0;
+	matchSize=0;
+	depth=0;
+	topPtr=0;
+	bottomPtr=(FMI_GetBWTSize(fmi)-1); // the last BWT position (the index has no block after it)
+	prevTopPtr=topPtr;
+	prevBottomPtr=bottomPtr;
+	for(j=textsize;j!=0;){
+		j--;
+		if(progressCounter==progressStep){ // print progress dots
+			if(matcher->showProgress) putchar('.');
+			fflush(stdout);
+			progressCounter=0;
+		} else progressCounter++;
+		while( (n=FMI_FollowLetter(fmi,QUERYCHAR(j),&topPtr,&bottomPtr))==0 ){ // when no match exits, follow prefix links to broaden the interval
+			topPtr = prevTopPtr; // restore pointer values, because they got lost when no hits exist
+			bottomPtr = prevBottomPtr;
+			depth = GetCachedEnclosingLCPInterval((matcher->intervalCache),&topPtr,&bottomPtr); // get enclosing interval and corresponding destination depth
+			if( depth == -1 ) break; // can happen for example when current seq contains 'N's but the indexed reference does not
+			prevTopPtr = topPtr; // save pointer values in case the match fails again
+			prevBottomPtr = bottomPtr;
+		}
+		depth++;
+		if( depth >= minMatchSize ){
+			if(matchType==1 && n!=1) continue; // not a MAM if we are looking for one
+			savedTopPtr = topPtr; // save the original interval to restore after finished processing MEMs
+			savedBottomPtr = bottomPtr;
+			prevTopPtr = (bottomPtr+1); // to process the first interval entirely
+			prevBottomPtr = bottomPtr;
+			matchSize = depth;
+			if( j != 0 ) c = QUERYCHAR(j-1); // next char to be processed (to the left)
+			else c = '\0';
+			while( matchSize >= minMatchSize ){ // process all parent intervals down to this size limit
+				if(countOnly){ // count the occurrences in the new parts of the interval, above and bellow the previous one
+					k = (int)( CountLeftMaximalOccurrences(fmi,topPtr,prevTopPtr,c) + CountLeftMaximalOccurrences(fmi,(prevBottomPtr+1),(bottomPtr+1),c) );
+					if( k != 0 ){
+						if( matchSize > maxLengthCount ){
+							lengthCounts = (long long int *)realloc(lengthCounts,(2*matchSize+1)*sizeof(long long int));
+							memset((lengthCounts+maxLengthCount+1),0,(2*matchSize-maxLengthCount)*sizeof(long long int));
+							maxLengthCount = (2*matchSize);
+						}
+						lengthCounts[matchSize] += k;
+						matcher->numMatches += k;
+						matcher->sumMatchesSize += ((long long int)k*(long long int)matchSize);
+						AddCoveredInterval(j,(j+(unsigned int)matchSize),&coveredIntervals,&numCoveredIntervals,&maxNumCoveredIntervals);
+					}
+				} else {
+					if( topMatches != NULL && numTopMatches == maxTopMatches && matchSize <= (topMatches[0].matchSize) ) break; // not longer than the shortest kept match
+					for( n = topPtr ; n != prevTopPtr ; n++ ){ // from topPtr down to prevTopPtr
+						if( FMI_GetCharAtBWTPos(fmi,n) != c ) ReportIntervalMatch(matcher,topMatches,&numTopMatches,n,j,matchSize);
+					}
+					for( n = bottomPtr ; n != prevBottomPtr ; n-- ){ // from bottomPtr up to prevBottomPtr
+						if( FMI_GetCharAtBWTPos(fmi,n) != c ) ReportIntervalMatch(matcher,topMatches,&numTopMatches,n,j,matchSize);
+					}
+				}
+				prevTopPtr = topPtr;
+				prevBottomPtr = bottomPtr;
+				matchSize = GetCachedEnclosingLCPInterval((matcher->intervalCache),&topPtr,&bottomPtr); // get parent interval and its depth
+			}
+			topPtr = savedTopPtr;
+			bottomPtr = savedBottomPtr;
+		}
+		prevTopPtr=topPtr; // save pointer values in case there's no match on the next char, and they loose their values
+		prevBottomPtr=bottomPtr;
+	} // end of loop for all chars of seq
+	if(countOnly){ // write the summary of the matches of this strand
+		fprintf(outputFile,"count\t%d\n",(matcher->numMatches));
+		n=0;
+		for(k=0;k<numCoveredIntervals;k++) n+=(coveredIntervals[(2*k+1)]-coveredIntervals[(2*k)]);
+		fprintf(outputFile,"covered\t%u\n",n);
+		for(k=minMatchSize;k<=maxLengthCount;k++){
+			if(lengthCounts[k]!=0) fprintf(outputFile,"size\t%d\t%lld\n",k,lengthCounts[k]);
+		}
+		free(lengthCounts);
+		free(coveredIntervals);
+	}
+	if(topMatches!=NULL){ // write the longest matches, by decreasing length
+		qsort(topMatches,numTopMatches,sizeof(TopMatch),TopMatchSortFunction);
+		for(k=0;k<numTopMatches;k++) ReportIndexMatch(matcher,topMatches[k].refPos,topMatches[k].queryPos,topMatches[k].matchSize);
+		free(topMatches);
+	}
+	WriteSortedMatches(matcher);
+	return NULL;
+}
+
+typedef struct _StatsRun {
+	unsigned int queryPos; // first position of the run in the query
+	unsigned int matchSize; // length of the match starting at that position
+	unsigned int topPtr; // BWT position of one occurrence of that match
+} StatsRun;
+
+// Computes the matching statistics of one strand of a query sequence (the length of the longest match starting at each position)
+// NOTE: consecutive positions whose matches end at the same query position form a run, and only the first position of each run is
+//  written to the output file (with its match length, and optionally one position of that match in the reference), since the match
+//  length of the other positions of the run is given by the distance to that end
+// NOTE: the occurrences of the matches are never enumerated, so this runs at the speed of the backward search only
+void *MatchQueryStatistics(void *arg){
+	StrandMatcher *matcher;
+	FMIndex *fmi;
+	FILE *outputFile;
+	StatsRun *runs;
+	int depth, numRuns, maxNumRuns, r, refId;
+	unsigned int j, textsize, runEnd, runTopPtr, refPos;
+	unsigned int topPtr, bottomPtr, prevTopPtr, prevBottomPtr, n;
+	long long int sumMatchesSize;
+	char *window;
+	unsigned int windowStart;
+	int progressCounter, progressStep;
+	matcher=(StrandMatcher *)arg;
+	fmi=(matcher->fmi);
+	outputFile=(matcher->outputFile);
+	textsize=(matcher->textSize);
+	if((matcher->packedText)!=NULL || (matcher->reverse)){
+		window=(matcher->window);
+		windowStart=textsize; // empty window
+	} else {
+		window=(matcher->text);
+		windowStart=0; // the window is the whole text
+	}
+	maxNumRuns=1024;
+	runs=(StatsRun *)malloc(maxNumRuns*sizeof(StatsRun));
+	numRuns=0;
+	progressStep=(textsize/10);
+	progressCounter=0;
+	sumMatchesSize=0;
+	depth=0;
+	topPtr=0;
+	bottomPtr=(FMI_GetBWTSize(fmi)-1);
+	prevTopPtr=topPtr;
+	prevBottomPtr=bottomPtr;
+	runEnd=textsize;
+	runTopPtr=0;
+	for(j=textsize;j!=0;){
+		j--;
+		if(progressCounter==progressStep){ // print progress dots
+			if(matcher->showProgress) putchar('.');
+			fflush(stdout);
+			progressCounter=0;
+		} else progressCounter++;
+		while( (n=FMI_FollowLetter(fmi,QUERYCHAR(j),&topPtr,&bottomPtr))==0 ){ // when no match exits, follow prefix links to broaden the interval
+			topPtr = prevTopPtr;
+			bottomPtr = prevBottomPtr;
+			depth = GetCachedEnclosingLCPInterval((matcher->intervalCache),&topPtr,&bottomPtr);
+			if( depth == -1 ) break;
+			prevTopPtr = topPtr;
+			prevBottomPtr = bottomPtr;
+		}
+		depth++;
+		sumMatchesSize += depth;
+		if((j+(unsigned int)depth)!=runEnd){ // the match ends at another position, so the run to the right is finished
+			if(j!=(textsize-1)){
+				if(numRuns==maxNumRuns){
+					maxNumRuns*=2;
+					runs=(StatsRun *)realloc(runs,maxNumRuns*sizeof(StatsRun));
+				}
+				runs[numRuns].queryPos=(j+1);
+				runs[numRuns].matchSize=(runEnd-(j+1));
+				runs[numRuns].topPtr=runTopPtr;
+				numRuns++;
+			}
+			runEnd=(j+(unsigned int)depth);
+		}
+		runTopPtr=topPtr;
+		prevTopPtr=topPtr;
+		prevBottomPtr=bottomPtr;
+	} // end of loop for all chars of seq
+	if(textsize!=0){ // last run, at the start of the query
+		if(numRuns==maxNumRuns){
+			maxNumRuns*=2;
+			runs=(StatsRun *)realloc(runs,maxNumRuns*sizeof(StatsRun));
+		}
+		runs[numRuns].queryPos=0;
+		runs[numRuns].matchSize=runEnd;
+		runs[numRuns].topPtr=runTopPtr;
+		numRuns++;
+	}
+	for(r=(numRuns-1);r>=0;r--){ // the runs were found from right to left
+		if((matcher->matchCallback)!=NULL){ // each run is reported as a match at one of its positions in the reference
+			if(runs[r].matchSize!=0) WriteIndexMatch(matcher,FMI_PositionInText(fmi,runs[r].topPtr),runs[r].queryPos,(int)runs[r].matchSize);
+			continue;
+		}
+		fprintf(outputFile,"%u\t%u",(runs[r].queryPos+1),runs[r].matchSize);
+		if((matcher->statsPositions) && runs[r].matchSize!=0){
+			refPos=FMI_PositionInText(fmi,runs[r].topPtr);
+			fputc('\t',outputFile);
+			if((matcher->numRefs)!=1){ // multiple refs
+				refId = GetMatcherRefId(matcher,&refPos);
+				fwrite((refLabels+refLabelsStart[refId]),sizeof(char),(size_t)(refLabelsStart[(refId+1)]-refLabelsStart[refId]),outputFile);
+			}
+			fprintf(outputFile,"%u",(refPos+1));
+		}
+		fputc('\n',outputFile);
+	}
+	free(runs);
+	matcher->numMatches=(int)textsize;
+	matcher->sumMatchesSize=sumMatchesSize;
+	matcher->numReverseMatches=0;
+	matcher->sumReverseMatchesSize=0;
+	return NULL;
+}
+
+typedef struct _BidirectionalInterval {
+	unsigned int topPtr, revTopPtr, size; // BWT intervals of the match and of its reverse complement
+	unsigned int queryEnd; // position in the query after the last char of the match
+} BidirectionalInterval;
+
+// Fills the window of chars of the packed query around this position, and returns the char at that position
+char FillQueryWindowAround(StrandMatcher *matcher, unsigned int pos, unsigned int *windowStart, unsigned int *windowEnd){
+	unsigned int start, end;
+	start=((pos>=(QUERYWINDOWSIZE/2))?(pos-(QUERYWINDOWSIZE/2)):0);
+	end=(start+QUERYWINDOWSIZE);
+	if(end>(matcher->textSize)) end=(matcher->textSize);
+	UnpackSequenceChars((matcher->packedText),start,(end-start),0,(matcher->window));
+	(*windowStart)=start;
+	(*windowEnd)=end;
+	return (matcher->window)[(pos-start)];
+}
+
+// NOTE: the SMEMs are searched in both directions of the query, so the window of chars is refilled whenever a position outside it is read
+#define SMEMQUERYCHAR(pos) ((((pos)>=windowStart) && ((pos)<windowEnd))?(window[((pos)-windowStart)]):(FillQueryWindowAround(matcher,(pos),&windowStart,&windowEnd)))
+
+// Finds all the SMEMs of the forward strand of a query sequence against an index with both strands of the reference (as in BWA-MEM)
+// NOTE: for each query position not yet covered, the match starting there is extended to the right while saving the intervals where
+//  its number of occurrences changes, and then all of those are extended to the left together, until only the longest one is left
+// NOTE: as in MatchQueryStrand, the hits on the reverse strand of the reference are reported as matches of the reverse strand of the query
+void *MatchQuerySMEMs(void *arg){
+	StrandMatcher *matcher;
+	FMIndex *fmi;
+	BidirectionalInterval *prevIntervals, *currIntervals, *swapIntervals, interval, newInterval;
+	int numPrevIntervals, numCurrIntervals, maxNumIntervals, k, matchSize;
+	unsigned int textsize, x, i, start, lastStart, nextX, n, progressPos, progressStep;
+	char c, *window;
+	unsigned int windowStart, windowEnd;
+	matcher=(StrandMatcher *)arg;
+	fmi=(matcher->fmi);
+	textsize=(matcher->textSize);
+	if((matcher->packedText)!=NULL){
+		window=(matcher->window);
+		windowStart=textsize; // empty window
+		windowEnd=textsize;
+	} else {
+		window=(matcher->text);
+		windowStart=0; // the window is the whole text
+		windowEnd=textsize;
+	}
+	InitSortedMatches(matcher);
+	maxNumIntervals=1024;
+	prevIntervals=(BidirectionalInterval *)malloc(maxNumIntervals*sizeof(BidirectionalInterval));
+	currIntervals=(BidirectionalInterval *)malloc(maxNumIntervals*sizeof(BidirectionalInterval));
+	progressStep=(textsize/10);
+	progressPos=progressStep;
+	matcher->numMatches=0;
+	matcher->sumMatchesSize=0;
+	matcher->numReverseMatches=0;
+	matcher->sumReverseMatchesSize=0;
+	x=0;
+	while(x<textsize){
+		while(x>=progressPos){ // print progress dots
+			if(matcher->showProgress) putchar('.');
+			fflush(stdout);
+			progressPos+=(progressStep+1);
+		}
+		c=SMEMQUERYCHAR(x);
+		interval.topPtr=0;
+		interval.revTopPtr=0;
+		interval.size=FMI_GetBWTSize(fmi);
+		if(FMI_ExtendBidirectionalInterval(fmi,c,0,&(interval.topPtr),&(interval.revTopPtr),&(interval.size))==0){ // 'N' char
+			x++;
+			continue;
+		}
+		interval.queryEnd=(x+1);
+		numPrevIntervals=0;
+		for(i=(x+1);i<textsize;i++){ // forward extension, saving the match each time its interval shrinks
+			newInterval=interval;
+			if(FMI_ExtendBidirectionalInterval(fmi,SMEMQUERYCHAR(i),1,&(newInterval.topPtr),&(newInterval.revTopPtr),&(newInterval.size))!=(interval.size)){
+				if(numPrevIntervals==maxNumIntervals){
+					maxNumIntervals*=2;
+					prevIntervals=(BidirectionalInterval *)realloc(prevIntervals,maxNumIntervals*sizeof(BidirectionalInterval));
+					currIntervals=(BidirectionalInterval *)realloc(currIntervals,maxNumIntervals*sizeof(BidirectionalInterval));
+				}
+				prevIntervals[numPrevIntervals++]=interval;
+				if(newInterval.size==0) break;
+			}
+			interval=newInterval;
+			interval.queryEnd=(i+1);
+		}
+		if(i==textsize){ // reached the end of the query
+			if(numPrevIntervals==maxNumIntervals){
+				maxNumIntervals*=2;
+				prevIntervals=(BidirectionalInterval *)realloc(prevIntervals,maxNumIntervals*sizeof(BidirectionalInterval));
+				currIntervals=(BidirectionalInterval *)realloc(currIntervals,maxNumIntervals*sizeof(BidirectionalInterval));
+			}
+			prevIntervals[numPrevIntervals++]=interval;
+		}
+		for(k=0;k<(numPrevIntervals/2);k++){ // reverse the order, so the longest matches are extended first
+			interval=prevIntervals[k];
+			prevIntervals[k]=prevIntervals[(numPrevIntervals-1-k)];
+			prevIntervals[(numPrevIntervals-1-k)]=interval;
+		}
+		nextX=(prevIntervals[0].queryEnd); // the next SMEMs can only start after the end of the longest match
+		lastStart=UINT_MAX;
+		for(start=x;;start--){ // backward extension of all the saved matches at the same time
+			c=((start==0)?'\0':SMEMQUERYCHAR(start-1));
+			numCurrIntervals=0;
+			for(k=0;k<numPrevIntervals;k++){
+				newInterval=prevIntervals[k];
+				if(start==0 || FMI_ExtendBidirectionalInterval(fmi,c,0,&(newInterval.topPtr),&(newInterval.revTopPtr),&(newInterval.size))==0){
+					if(numCurrIntervals==0 && start<lastStart){ // if no longer match was extended, this one is an SMEM (unless contained in the last one)
+						lastStart=start;
+						matchSize=(int)((prevIntervals[k].queryEnd)-start);
+						if(matchSize<(matcher->minMatchSize)) continue;
+						for(n=(prevIntervals[k].topPtr);n<((prevIntervals[k].topPtr)+(prevIntervals[k].size));n++){ // report all the occurrences
+							ReportIndexMatch(matcher,FMI_PositionInText(fmi,n),start,matchSize);
+						}
+					}
+				} else if(numCurrIntervals==0 || newInterval.size!=(currIntervals[(numCurrIntervals-1)].size)){ // keep only one match per interval size
+					currIntervals[numCurrIntervals++]=newInterval;
+				}
+			}
+			if(numCurrIntervals==0) break;
+			swapIntervals=prevIntervals;
+			prevIntervals=currIntervals;
+			currIntervals=swapIntervals;
+			numPrevIntervals=numCurrIntervals;
+		}
+		x=nextX;
+	}
+	free(prevIntervals);
+	free(currIntervals);
+	WriteSortedMatches(matcher);
+	return NULL;
+}
+
+// Appends everything written to the temporary file to the output file, and rewinds the temporary file to be reused
+void AppendTemporaryFile(FILE *tempFile, FILE *outputFile){
+	char buffer[(1<<16)];
+	long int n;
+	size_t k;
+	n=ftell(tempFile);
+	rewind(tempFile);
+	while(n>0){
+		k=fread(buffer,sizeof(char),((n>(long int)sizeof(buffer))?sizeof(buffer):(size_t)n),tempFile);
+		if(k==0) break;
+		fwrite(buffer,sizeof(char),k,outputFile);
+		n-=(long int)k;
+	}
+	rewind(tempFile);
+}
+
+typedef struct _MatchingOptions { // options of the matches found for each query (set by main, or by the server for each client)
+	int matchType, minMatchSize;
+	int statsPositions, countOnly, maxTopMatches, sortMatches, chainMatches; // output modes (see StrandMatcher)
+	int bothStrands; // if set, the reverse complement of each query is also matched
+} MatchingOptions;
+
+// Finds all the matches of one query sequence (and of its reverse complement) against the index and writes them to the output file
+// NOTE: if packedText is not NULL, the chars are extracted from it through a small window (for both strands) and text is not used
+// NOTE: if reverseOutputFile is not NULL, the reverse strand is matched in another thread at the same time as the forward strand
+//  (with its own intervals cache), and its matches are written to that temporary file and then appended after the forward ones
+// NOTE: if refReverseStart is not UINT_MAX, the index also contains the reverse strand of the reference, so only the forward strand is
+//  matched, and the hits on the reverse strand of the reference are written to reverseOutputFile and reported as reverse strand matches
+void MatchQuerySequence(char *name, char *text, PackedSequence *packedText, unsigned int textsize, int numRefs, MatchingOptions *options, unsigned int refReverseStart, FILE *matchesOutputFile, FILE *reverseOutputFile, LCPIntervalCache **intervalCaches, char **windows, long long int *totalNumMatches, long long int *totalSumMatchesSizes){
+	StrandMatcher matchers[2];
+	int s, matchSize, numMatches, numStrands, matchType, bothStrands;
+	long long int sumMatchesSize;
+	void *(*matchFunction)(void *);
+	#ifdef CONCURRENT_STRANDS
+	pthread_t reverseThread;
+	#endif
+	#ifdef DEBUGMEMS
+	char *revText;
+	#endif
+	matchType=(options->matchType);
+	bothStrands=(options->bothStrands);
+	for(s=0;s<=bothStrands;s++){
+		matchers[s].text=text;
+		matchers[s].packedText=packedText;
+		matchers[s].textSize=textsize;
+		matchers[s].reverse=s;
+		matchers[s].numRefs=numRefs;
+		matchers[s].matchType=matchType;
+		matchers[s].minMatchSize=(options->minMatchSize);
+		matchers[s].statsPositions=(options->statsPositions);
+		matchers[s].countOnly=(options->countOnly);
+		matchers[s].maxTopMatches=(options->maxTopMatches);
+		matchers[s].sortMatches=((options->sortMatches) || (options->chainMatches));
+		matchers[s].chainMatches=(options->chainMatches);
+		matchers[s].outputFile=matchesOutputFile;
+		matchers[s].refReverseStart=UINT_MAX;
+		matchers[s].reverseHitsFile=NULL;
+		matchers[s].fmi=refIndex;
+		matchers[s].intervalCache=intervalCaches[s];
+		matchers[s].refStarts=refStarts;
+		matchers[s].matchCallback=NULL;
+		matchers[s].callbackData=NULL;
+		matchers[s].showProgress=(!quietMatching);
+		matchers[s].window=windows[s];
+	}
+	if(matchType==SMEM_MATCH_TYPE) matchFunction=MatchQuerySMEMs;
+	else if(matchType==MS_MATCH_TYPE) matchFunction=MatchQueryStatistics;
+	else matchFunction=MatchQueryStrand;
+	#ifdef DEBUGMEMS
+	revText=NULL;
+	if(bothStrands){ // the debug output needs the full chars of the reverse strand
+		revText=(char *)malloc((textsize+1)*sizeof(char));
+		GetReverseComplementSequence(text,revText,textsize);
+		matchers[1].text=revText;
+		matchers[1].reverse=0;
+	}
+	#endif
+	#ifdef CONCURRENT_STRANDS
+	if(bothStrands && reverseOutputFile!=NULL){
+		matchers[1].outputFile=reverseOutputFile;
+		matchers[1].showProgress=0;
+		if(pthread_create(&reverseThread,NULL,matchFunction,(void *)&(matchers[1]))!=0){
+			printf("\n> ERROR: Failed to create reverse strand thread\n");
+			exit(-1);
+		}
+	}
+	#else
+	if(refReverseStart==UINT_MAX) reverseOutputFile=NULL;
+	#endif
+	numStrands=(bothStrands+1);
+	if(refReverseStart!=UINT_MAX){ // both strands are found in a single pass over the forward strand
+		matchers[0].refReverseStart=refReverseStart;
+		matchers[0].reverseHitsFile=reverseOutputFile;
+		numStrands=2;
+	}
+	for(s=0;s<numStrands;s++){ // process one or both strands
+		if(s==0){ // forward strand
+			if(!quietMatching) printf(":: \"%s\" ",name);
+			fprintf(matchesOutputFile,">%s\n",name);
+		} else { // reverse strand
+			if(!quietMatching) printf(":: \"%s Reverse\" ",name);
+			fprintf(matchesOutputFile,">%s Reverse\n",name);
+		}
+		fflush(stdout);
+		if(s==1 && refReverseStart!=UINT_MAX){ // the reverse strand hits were already found together with the forward ones
+			AppendTemporaryFile(reverseOutputFile,matchesOutputFile);
+			numMatches=matchers[0].numReverseMatches;
+			sumMatchesSize=matchers[0].sumReverseMatchesSize;
+		} else {
+			#ifdef CONCURRENT_STRANDS
+			if(s==1 && reverseOutputFile!=NULL){ // wait for the reverse strand thread
+				pthread_join(reverseThread,NULL);
+				AppendTemporaryFile(reverseOutputFile,matchesOutputFile);
+			} else
+			#endif
+			matchFunction((void *)&(matchers[s]));
+			numMatches=matchers[s].numMatches;
+			sumMatchesSize=matchers[s].sumMatchesSize;
+		}
+		(*totalNumMatches) += numMatches;
+		(*totalSumMatchesSizes) += sumMatchesSize;
+		matchSize=(int)((numMatches==0)?(0):(sumMatchesSize/(long long)numMatches));
+		if(!quietMatching) printf(" (%d %ss ; avg size = %d bp)\n",numMatches,matchTypeNames[matchType],matchSize);
+		fflush(stdout);
+	} // end of loop for both strands
+	#ifdef DEBUGMEMS
+	if(revText!=NULL) free(revText);
+	#endif
+}
+
+// Builds the FM-index of the reference(s) (with the reverse strand too if bothStrandsIndex is set) and its sampled LCP array, and
+//  returns the position where the reverse strand starts in the index (or UINT_MAX if it is not indexed)
+unsigned int BuildMatchingIndex(int numRefs, int matchType, int minMatchSize, int bothStrandsIndex, int numThreads){
+	unsigned int textsize, refReverseStart;
+	char *text, *revText;
+	char *refsTexts[2];
+	unsigned int refsTextSizes[2];
+	unsigned char *lcpArray;
+	#if defined(unix) && defined(BENCHMARK)
+	char command[32];
+	int commretval;
+	#endif
+	printf("> Building index for reference sequence");
+	if(numRefs==1) printf(" \"%s\"", (allSequences[0]->name));
+	else printf("s");
+	printf(" (%u Mbp) ...\n",(allSequences[0]->size)/1000000U);
+	fflush(stdout);
+	text=(allSequences[0]->chars);
+	textsize=(allSequences[0]->size);
+	refsTexts[0]=text;
+	refsTextSizes[0]=textsize;
+	refReverseStart=UINT_MAX;
+	revText=NULL;
+	if(bothStrandsIndex){ // the reverse strand is indexed right after the forward one (and the separator char)
+		revText=(char *)malloc((textsize+1)*sizeof(char));
+		if(revText==NULL){
+			printf("\n> ERROR: Not enough memory to index the reverse strand\n");
+			exit(-1);
+		}
+		GetReverseComplementSequence(text,revText,textsize);
+		refsTexts[1]=revText;
+		refsTextSizes[1]=textsize;
+		refReverseStart=(textsize+1);
+	}
+	lcpArray=NULL;
+	refIndex=FMI_BuildIndex(refsTexts,refsTextSizes,(bothStrandsIndex?2:1),&lcpArray,1);
+	#ifndef DEBUGMEMS
+	if(FMI_HasExactLCPs()){ // the reference chars are not needed to build the sampled LCP array if no LCP was truncated
+		FreeSequenceChars(allSequences[0]);
+		text=NULL;
+	}
+	#endif
+	if(bothStrandsIndex){ // the sampled LCP array is built over the concatenation of both strands
+		if(text!=NULL && matchType!=SMEM_MATCH_TYPE){
+			text=(char *)realloc(text,(2*(size_t)textsize+2)*sizeof(char));
+			if(text==NULL){
+				printf("\n> ERROR: Not enough memory to index the reverse strand\n");
+				exit(-1);
+			}
+			text[textsize]='N';
+			memcpy((text+textsize+1),revText,(textsize+1)*sizeof(char));
+			allSequences[0]->chars=text;
+		}
+		free(revText);
+		textsize=FMI_GetTextSize(refIndex);
+	}
+	refLCPArray=NULL;
+	if(matchType==SMEM_MATCH_TYPE) FMI_FreeLCPSamples(); // the SMEMs are found with bidirectional search only
+	else refLCPArray=BuildSampledLCPArray(refIndex,text,textsize,lcpArray,minMatchSize,numThreads,1);
+	if(lcpArray!=NULL) free(lcpArray);
+	#ifndef DEBUGMEMS
+	FreeSequenceChars(allSequences[0]);
+	#else
+	refText=(allSequences[0]->chars);
+	refSize=(allSequences[0]->size);
+	#endif
+	#if defined(unix) && defined(BENCHMARK)
+	sprintf(command,"memusgpid %d &",(int)getpid());
+	commretval=system(command);
+	#endif
+	return refReverseStart;
+}
+
+#define INDEXFILEHEADER "SLAMEMIX"
+#define INDEXFILEVERSION 2
+#define INDEXFILEALIGNMENT 64 // the index arrays start at offsets aligned to the cache line size
+
+typedef struct _IndexFileHeader {
+	char header[8];
+	unsigned int version;
+	unsigned int numRefs;
+	unsigned int refSize; // size of the (merged) reference sequence
+	unsigned int refReverseStart; // or UINT_MAX if the reverse strand is not indexed
+	unsigned int refNamesHash;
+	unsigned int padding;
+	unsigned long long int refCharsHash; // fingerprint of the chars of the (merged) reference sequence
+	unsigned long long int fmiOffset, lcpOffset, fileSize;
+} IndexFileHeader;
+
+static char *indexFileData = NULL; // contents of the attached index file (mapped or loaded)
+static size_t indexFileSize = 0;
+#ifdef SHARED_INDEX
+static int indexFileDescriptor = (-1);
+#endif
+
+// Returns a hash of the names and number of the refs, to check if an index file was built for the same references
+unsigned int GetRefNamesHash(int numRefs){
+	unsigned int hash;
+	char *c;
+	int i;
+	hash=2166136261U; // FNV-1a
+	for(i=0;i<numRefs;i++){
+		for(c=(allSequences[i]->name);(*c)!='\0';c++) hash=((hash^(unsigned char)(*c))*16777619U);
+		hash=((hash^(unsigned char)'\n')*16777619U);
+	}
+	return hash;
+}
+
+// Returns a hash of the chars of the (merged) reference sequence, to check if an index file was built for the same sequence
+// NOTE: the chars are hashed 8 at a time (FNV-1a on 64-bit words, with the high bits folded back after each step)
+unsigned long long int GetRefCharsHash(){
+	unsigned long long int hash, word;
+	char *chars;
+	unsigned int size, i;
+	chars=(allSequences[0]->chars);
+	size=(allSequences[0]->size);
+	hash=14695981039346656037ULL;
+	for(i=0;(size-i)>=8;i+=8){
+		memcpy(&word,(chars+i),8);
+		hash=((hash^word)*1099511628211ULL);
+		hash^=(hash>>29);
+	}
+	for(;i<size;i++) hash=((hash^(unsigned char)chars[i])*1099511628211ULL);
+	return hash;
+}
+
+// Returns 1 if the index file with this header was written by this version for the same reference (refs, names and chars)
+int IndexFileMatchesReference(IndexFileHeader *fileHeader, int numRefs, unsigned long long int refCharsHash){
+	return ( (fileHeader->version)==INDEXFILEVERSION && (fileHeader->numRefs)==(unsigned int)numRefs && (fileHeader->refSize)==(allSequences[0]->size)
+		&& (fileHeader->refNamesHash)==GetRefNamesHash(numRefs) && (fileHeader->refCharsHash)==refCharsHash );
+}
+
+// Writes zeros until the current position of the file is aligned, and returns that position
+unsigned long long int PadIndexFile(FILE *indexFile){
+	long long int pos;
+	pos=(long long int)ftell(indexFile);
+	while((pos%INDEXFILEALIGNMENT)!=0){
+		fputc(0,indexFile);
+		pos++;
+	}
+	return (unsigned long long int)pos;
+}
+
+// Saves the built index to a file, so it can be attached by the next runs with the same reference instead of being built again
+// NOTE: the file is written with a temporary name and only renamed at the end, so other processes never see an incomplete index file
+int SaveMatchingIndex(char *indexFilename, int numRefs, unsigned int refReverseStart, unsigned long long int refCharsHash){
+	IndexFileHeader fileHeader;
+	FILE *indexFile;
+	char *tempFilename;
+	int ok;
+	printf("> Saving index to file <%s> ... ",indexFilename);
+	fflush(stdout);
+	tempFilename=(char *)malloc((strlen(indexFilename)+32)*sizeof(char));
+	#ifdef SHARED_INDEX
+	sprintf(tempFilename,"%s.%d.tmp",indexFilename,(int)getpid()); // processes building the same index file at once do not overwrite each other
+	#else
+	sprintf(tempFilename,"%s.tmp",indexFilename);
+	#endif
+	if((indexFile=fopen(tempFilename,"wb"))==NULL){
+		printf("\n> WARNING: Cannot create index file <%s>\n",tempFilename);
+		free(tempFilename);
+		return 0;
+	}
+	memset(&fileHeader,0,sizeof(IndexFileHeader));
+	memcpy(fileHeader.header,INDEXFILEHEADER,8*sizeof(char));
+	fileHeader.version=INDEXFILEVERSION;
+	fileHeader.numRefs=(unsigned int)numRefs;
+	fileHeader.refSize=(allSequences[0]->size);
+	fileHeader.refReverseStart=refReverseStart;
+	fileHeader.refNamesHash=GetRefNamesHash(numRefs);
+	fileHeader.refCharsHash=refCharsHash;
+	ok=(fwrite(&fileHeader,sizeof(IndexFileHeader),(size_t)1,indexFile)==(size_t)1);
+	fileHeader.fmiOffset=PadIndexFile(indexFile);
+	if(ok) ok=(FMI_WriteIndex(refIndex,indexFile)!=0);
+	fileHeader.lcpOffset=PadIndexFile(indexFile);
+	if(ok) ok=(WriteSampledLCPArray(refLCPArray,indexFile)!=0);
+	fileHeader.fileSize=(unsigned long long int)ftell(indexFile);
+	if(ok){ // the offsets are only known now
+		rewind(indexFile);
+		ok=(fwrite(&fileHeader,sizeof(IndexFileHeader),(size_t)1,indexFile)==(size_t)1);
+	}
+	if(fclose(indexFile)!=0) ok=0;
+	if(ok) ok=(rename(tempFilename,indexFilename)==0);
+	if(!ok){
+		printf("\n> WARNING: Cannot write index file <%s>\n",indexFilename);
+		remove(tempFilename);
+		free(tempFilename);
+		return 0;
+	}
+	free(tempFilename);
+	printf("(%llu MB) OK\n",(fileHeader.fileSize>>20));
+	fflush(stdout);
+	return 1;
+}
+
+// Attaches the index saved in this file, and returns the position where the reverse strand starts in the index (or UINT_MAX)
+// NOTE: with SHARED_INDEX the file is mapped read-only and shared, so all the processes using the same index file on a node share a
+//  single physical copy of it (in the page cache) instead of each having its own
+// NOTE: every process attached to the file holds a shared lock on it (released by DetachMatchingIndex() or when the process exits),
+//  so LoadMatchingIndex only replaces an outdated index file if it can lock it exclusively (i.e., if no process is using it)
+unsigned int AttachMatchingIndex(char *indexFilename, int numRefs, int bothStrandsIndex, unsigned long long int refCharsHash){
+	IndexFileHeader *fileHeader;
+	unsigned int expectedTextSize;
+	size_t usedSize;
+	#ifdef SHARED_INDEX
+	struct stat fileStats, nameStats;
+	#else
+	FILE *indexFile;
+	#endif
+	printf("> Attaching index file <%s> ... ",indexFilename);
+	fflush(stdout);
+	#ifdef SHARED_INDEX
+	while(1){ // if the file was replaced while waiting for the lock, the new file with that name is opened and locked instead
+		indexFileDescriptor=open(indexFilename,O_RDONLY);
+		if(indexFileDescriptor<0){
+			printf("\n> ERROR: Cannot open index file <%s>\n",indexFilename);
+			exit(-1);
+		}
+		while(flock(indexFileDescriptor,LOCK_SH)!=0){ // marks the file as in use (and waits if it is being replaced)
+			if(errno==EINTR) continue;
+			printf("\n> ERROR: Cannot lock index file <%s> (%s)\n",indexFilename,strerror(errno));
+			exit(-1);
+		}
+		if(fstat(indexFileDescriptor,&fileStats)!=0 || stat(indexFilename,&nameStats)!=0){
+			printf("\n> ERROR: Cannot open index file <%s>\n",indexFilename);
+			exit(-1);
+		}
+		if(fileStats.st_dev==nameStats.st_dev && fileStats.st_ino==nameStats.st_ino) break;
+		close(indexFileDescriptor);
+	}
+	indexFileSize=(size_t)fileStats.st_size;
+	indexFileData=(char *)mmap(NULL,indexFileSize,PROT_READ,MAP_SHARED,indexFileDescriptor,0);
+	if(indexFileData==MAP_FAILED){
+		printf("\n> ERROR: Cannot map index file <%s> to memory\n",indexFilename);
+		exit(-1);
+	}
+	#else
+	if((indexFile=fopen(indexFilename,"rb"))==NULL){
+		printf("\n> ERROR: Cannot open index file <%s>\n",indexFilename);
+		exit(-1);
+	}
+	fseek(indexFile,0L,SEEK_END);
+	indexFileSize=(size_t)ftell(indexFile);
+	rewind(indexFile);
+	indexFileData=(char *)malloc(indexFileSize*sizeof(char));
+	if(indexFileData==NULL || fread(indexFileData,sizeof(char),indexFileSize,indexFile)!=indexFileSize){
+		printf("\n> ERROR: Cannot load index file <%s>\n",indexFilename);
+		exit(-1);
+	}
+	fclose(indexFile);
+	#endif
+	fileHeader=(IndexFileHeader *)indexFileData;
+	if(indexFileSize<sizeof(IndexFileHeader) || memcmp(fileHeader->header,INDEXFILEHEADER,8*sizeof(char))!=0
+		|| (fileHeader->fileSize)!=(unsigned long long int)indexFileSize || (fileHeader->fmiOffset)>(fileHeader->lcpOffset) || (fileHeader->lcpOffset)>(fileHeader->fileSize)){
+		printf("\n> ERROR: Invalid index file <%s>\n",indexFilename);
+		exit(-1);
+	}
+	if(!IndexFileMatchesReference(fileHeader,numRefs,refCharsHash)){
+		printf("\n> ERROR: Index file <%s> was built for a different reference (delete it to build it again)\n",indexFilename);
+		exit(-1);
+	}
+	if(((fileHeader->refReverseStart)!=UINT_MAX)!=(bothStrandsIndex!=0)){
+		printf("\n> ERROR: Index file <%s> was built %s option -ib\n",indexFilename,(bothStrandsIndex?"without":"with"));
+		exit(-1);
+	}
+	expectedTextSize=(bothStrandsIndex)?(2*(fileHeader->refSize)+1):(fileHeader->refSize);
+	refIndex=FMI_AttachIndex((indexFileData+(fileHeader->fmiOffset)),(size_t)((fileHeader->lcpOffset)-(fileHeader->fmiOffset)),&usedSize);
+	refLCPArray=NULL;
+	if(refIndex!=NULL && FMI_GetTextSize(refIndex)==expectedTextSize)
+		refLCPArray=AttachSampledLCPArray(refIndex,(indexFileData+(fileHeader->lcpOffset)),(size_t)((fileHeader->fileSize)-(fileHeader->lcpOffset)),&usedSize);
+	if(refLCPArray==NULL){
+		printf("\n> ERROR: Invalid index data in file <%s>\n",indexFilename);
+		exit(-1);
+	}
+	FreeSequenceChars(allSequences[0]); // the reference chars are not needed anymore
+	printf("(%llu MB) OK\n",(unsigned long long int)(indexFileSize>>20));
+	fflush(stdout);
+	return (fileHeader->refReverseStart);
+}
+
+// Releases the index (built or attached), and unmaps and unlocks the attached index file
+void DetachMatchingIndex(){
+	FMI_FreeIndex(refIndex);
+	FreeSampledSuffixArray(refLCPArray);
+	refIndex=NULL;
+	refLCPArray=NULL;
+	if(indexFileData==NULL) return;
+	#ifdef SHARED_INDEX
+	munmap(indexFileData,indexFileSize);
+	close(indexFileDescriptor); // also releases the shared lock
+	indexFileDescriptor=(-1);
+	#else
+	free(indexFileData);
+	#endif
+	indexFileData=NULL;
+	indexFileSize=0;
+}
+
+// Attaches the index of the reference(s) from the index file if it exists, or otherwise builds it (and saves it to the index file, if given)
+// NOTE: the index file always has the sampled LCP array, so it can be used with all the match types
+// NOTE: an index file built for a different reference (or by another version) is built again and replaced, but only if no other
+//  process has it attached (see AttachMatchingIndex)
+unsigned int LoadMatchingIndex(char *indexFilename, int numRefs, int matchType, int minMatchSize, int bothStrandsIndex, int numThreads){
+	IndexFileHeader fileHeader;
+	unsigned long long int refCharsHash;
+	unsigned int refReverseStart;
+	FILE *indexFile;
+	int staleFile, saved;
+	#ifdef SHARED_INDEX
+	int lockDescriptor;
+	#endif
+	if(indexFilename==NULL) return BuildMatchingIndex(numRefs,matchType,minMatchSize,bothStrandsIndex,numThreads);
+	refCharsHash=GetRefCharsHash(); // the reference chars are freed when the index is built or attached
+	staleFile=0;
+	if((indexFile=fopen(indexFilename,"rb"))!=NULL){
+		if(fread(&fileHeader,sizeof(IndexFileHeader),(size_t)1,indexFile)==(size_t)1 && memcmp(fileHeader.header,INDEXFILEHEADER,8*sizeof(char))==0)
+			staleFile=(!IndexFileMatchesReference(&fileHeader,numRefs,refCharsHash));
+		fclose(indexFile);
+		if(!staleFile) return AttachMatchingIndex(indexFilename,numRefs,bothStrandsIndex,refCharsHash); // also if it is not an index file at all
+	}
+	#ifdef SHARED_INDEX
+	lockDescriptor=(-1);
+	if(staleFile){ // the exclusive lock is kept until the new file replaces it, so no process attaches the old one meanwhile
+		lockDescriptor=open(indexFilename,O_RDONLY);
+		if(lockDescriptor<0 || flock(lockDescriptor,(LOCK_EX|LOCK_NB))!=0){
+			printf("\n> ERROR: Index file <%s> was built for a different reference and is in use by other processes\n",indexFilename);
+			exit(-1);
+		}
+		printf("> WARNING: Index file <%s> was built for a different reference, so it will be replaced\n",indexFilename);
+	}
+	#else
+	if(staleFile){
+		printf("\n> ERROR: Index file <%s> was built for a different reference (delete it to build it again)\n",indexFilename);
+		exit(-1);
+	}
+	#endif
+	refReverseStart=BuildMatchingIndex(numRefs,0,minMatchSize,bothStrandsIndex,numThreads);
+	saved=SaveMatchingIndex(indexFilename,numRefs,refReverseStart,refCharsHash);
+	#ifdef SHARED_INDEX
+	if(lockDescriptor>=0) close(lockDescriptor);
+	#endif
+	if(!saved) return refReverseStart;
+	DetachMatchingIndex(); // drop the private copy of the index and share the one in the file instead
+	return AttachMatchingIndex(indexFilename,numRefs,bothStrandsIndex,refCharsHash);
+}
+
+typedef struct _MatchingReference {
+	char *name; // file of the reference
+	int numRefs; // number of sequences in that file
+	unsigned int refReverseStart;
+	FMIndex *fmi;
+	SampledLCPArray *lcpArray;
+	RefStartsTable *refStarts;
+	char *refLabels;
+	unsigned int *refLabelsStart, *refSortRanks;
+	char *outFilename;
+	FILE *outputFile, *reverseOutputFile;
+	LCPIntervalCache *intervalCaches[2];
+	long long int totalNumMatches, totalSumMatchesSizes;
+} MatchingReference;
+
+// Moves the index and the names of the refs currently in the globals to this reference
+void KeepMatchingReference(MatchingReference *reference){
+	reference->fmi=refIndex;
+	reference->lcpArray=refLCPArray;
+	reference->refStarts=refStarts;
+	reference->refLabels=refLabels;
+	reference->refLabelsStart=refLabelsStart;
+	reference->refSortRanks=refSortRanks;
+	refIndex=NULL;
+	refLCPArray=NULL;
+	refStarts=NULL;
+	refLabels=NULL;
+	refLabelsStart=NULL;
+	refSortRanks=NULL;
+}
+
+// Sets the index and the names of the refs of this reference as the ones used by the matching functions
+void UseMatchingReference(MatchingReference *reference){
+	refIndex=(reference->fmi);
+	refLCPArray=(reference->lcpArray);
+	refStarts=(reference->refStarts);
+	refLabels=(reference->refLabels);
+	refLabelsStart=(reference->refLabelsStart);
+	refSortRanks=(reference->refSortRanks);
+}
+
+// Returns the name of the output file of this reference when using multiple references: "<ref>-mems.txt" by default, or the given
+//  output file name with the name of the reference added to it (e.g. "out-ref.txt")
+char *GetReferenceOutFilename(char *refFilename, char *outFilename){
+	char *refName, *extension, *extra, *filename;
+	int i;
+	if(outFilename==NULL) return AppendToBasename(refFilename,"-mems.txt");
+	for(i=(int)strlen(refFilename);i>0;i--){ // skip the path of the reference file
+		if(refFilename[(i-1)]=='/' || refFilename[(i-1)]=='\\') break;
+	}
+	refName=AppendToBasename((refFilename+i),""); // and its extension
+	extension=strrchr(outFilename,'.');
+	if(extension==NULL || extension==outFilename) extension=""; // same as in AppendToBasename
+	extra=(char *)malloc((strlen(refName)+strlen(extension)+2)*sizeof(char));
+	sprintf(extra,"-%s%s",refName,extension);
+	filename=AppendToBasename(outFilename,extra);
+	free(extra);
+	free(refName);
+	return filename;
+}
+
+// Builds the index of each reference file, one file at a time, and keeps only the indexes (and the names of the refs of each file),
+//  so all the queries can then be matched against all the references in a single pass
+// NOTE: the sequences of each reference are deleted after its index is built, so the queries can only be loaded after this
+MatchingReference *LoadMatchingReferences(int numRefFiles, char **refFilenames, char *outFilename, char *refNameSearch, int acgtOnly, unsigned int minSeqLength, int matchType, int minMatchSize, int bothStrandsIndex, int numThreads){
+	MatchingReference *references, *reference;
+	unsigned int *starts, pos;
+	int r, i, numRefs;
+	references=(MatchingReference *)calloc(numRefFiles,sizeof(MatchingReference));
+	for(r=0;r<numRefFiles;r++){
+		reference=&(references[r]);
+		reference->name=refFilenames[r];
+		reference->outFilename=GetReferenceOutFilename(refFilenames[r],outFilename);
+		numRefs=LoadSequencesFromFile(refFilenames[r],1,1,acgtOnly,minSeqLength,refNameSearch);
+		if(numRefs==0){
+			printf("\n> ERROR: No valid sequences found in reference file <%s>\n",refFilenames[r]);
+			exit(-1);
+		}
+		reference->numRefs=numRefs;
+		if(numRefs!=1){ // the merged sequences are deleted, so the positions where the refs start are kept with the index
+			CreateRefLabels(numRefs);
+			starts=(unsigned int *)malloc((numRefs+1)*sizeof(unsigned int));
+			pos=((allSequences[0]->size)+1); // the size of the 1st ref was replaced by the merged size, so start from the last ref
+			for(i=(numRefs-1);i>0;i--){
+				pos-=((allSequences[i]->size)+1);
+				starts[i]=pos;
+			}
+			starts[0]=0;
+			refStarts=NewRefStartsTable(starts,numRefs,(allSequences[0]->size));
+		}
+		reference->refReverseStart=BuildMatchingIndex(numRefs,matchType,minMatchSize,bothStrandsIndex,numThreads);
+		KeepMatchingReference(reference);
+		DeleteAllSequences();
+	}
+	return references;
+}
+
+// NOTE: the query files in streamFilenames are read one sequence at a time (e.g. from stdin or a pipe), and each sequence is matched
+//  as soon as it is read, so only the largest sequence is kept in memory
+// NOTE: if bothStrandsIndex is set, the reverse complement of the reference is added to the index as a second text, so each query
+//  only needs to be matched once to find the matches of both strands (with an index twice as big)
+// NOTE: if references is NULL, the index is built for the refs already loaded (the first numRefs sequences); otherwise, each query is
+//  matched against all the given references in turn, and the matches against each one are written to its own output file
+void GetMatches(MatchingReference *references, int numReferences, int numRefs, int numSeqs, int numStreams, char **streamFilenames, int acgtOnly, unsigned int minSeqLength, MatchingOptions *options, int bothStrandsIndex, int packQueries, int numThreads, char *indexFilename, char *outFilename){
+	MatchingReference *reference;
+	int numQueries;
+	char *windows[2];
+	int s, r;
+	long long int cacheHits, cacheLookups, n, k;
+	QueryReader *queryReader;
+	QuerySlot *querySlot;
+	int streamId, matchType, minMatchSize, bothStrands;
+	matchType=(options->matchType);
+	minMatchSize=(options->minMatchSize);
+	bothStrands=(options->bothStrands);
+	printf("> Using options: minimum %s length = %d ; strand = %s ; threads = %d\n", matchTypeNames[matchType], minMatchSize,(bothStrandsIndex)?"forward + reverse (indexed)":((bothStrands==0)?"forward only":"forward + reverse"),numThreads);
+	if(references==NULL){ // single reference, with its sequences already loaded
+		references=(MatchingReference *)calloc(1,sizeof(MatchingReference));
+		numReferences=1;
+		references[0].numRefs=numRefs;
+		references[0].outFilename=outFilename;
+	}
+	for(r=0;r<numReferences;r++){
+		references[r].outputFile=fopen(references[r].outFilename,"w");
+		if(references[r].outputFile==NULL){
+			printf("\n> ERROR: Cannot create output file <%s>\n",references[r].outFilename);
+			exit(-1);
+		}
+	}
+	if(references[0].name==NULL){ // the index of the single reference is only built (or attached) now
+		references[0].refReverseStart=LoadMatchingIndex(indexFilename,numRefs,matchType,minMatchSize,bothStrandsIndex,numThreads);
+		if(numRefs!=1) CreateRefLabels(numRefs);
+		KeepMatchingReference(&(references[0]));
+	}
+	printf("> Matching query sequences against index%s ...\n",((numReferences==1)?"":"es"));
+	fflush(stdout);
+	for(s=0;s<2;s++) windows[s]=(char *)malloc(QUERYWINDOWSIZE*sizeof(char)); // only used by one reference at a time
+	for(r=0;r<numReferences;r++){
+		reference=&(references[r]);
+		for(s=0;s<2;s++) reference->intervalCaches[s]=NewLCPIntervalCache(reference->lcpArray); // one for each strand, because they can be processed at the same time
+		reference->reverseOutputFile=NULL;
+		if(bothStrandsIndex){
+			reference->reverseOutputFile=tmpfile(); // the matches on the reverse strand of the reference are kept here until the query is finished
+			if((reference->reverseOutputFile)==NULL){
+				printf("\n> ERROR: Cannot create temporary file\n");
+				exit(-1);
+			}
+		}
+		#ifdef CONCURRENT_STRANDS
+		else if(bothStrands && numThreads>1){
+			reference->reverseOutputFile=tmpfile(); // the matches of the reverse strand are kept here until the forward strand is finished
+			if((reference->reverseOutputFile)==NULL) printf("> WARNING: Cannot create temporary file, so the strands will be matched one at a time\n");
+		}
+		#endif
+	}
+	numQueries=0;
+	streamId=(-1);
+	queryReader=OpenQueryReader(numRefs,numSeqs,numStreams,streamFilenames,acgtOnly,minSeqLength,packQueries);
+	while((querySlot=GetNextQuerySlot(queryReader))!=NULL){ // process all queries (the next one is loaded while this one is matched)
+		if((querySlot->streamId)!=streamId){
+			streamId=(querySlot->streamId);
+			printf("> Reading query sequences from <%s> ...\n",(streamFilenames[streamId][0]=='-' && streamFilenames[streamId][1]=='\0')?"stdin":streamFilenames[streamId]);
+		}
+		for(r=0;r<numReferences;r++){ // each query is only read once, and matched against all the references
+			reference=&(references[r]);
+			UseMatchingReference(reference);
+			if(numReferences!=1 && !quietMatching) printf("> Reference <%s>\n",(reference->name));
+			MatchQuerySequence((querySlot->name),(querySlot->chars),((packQueries)?(&(querySlot->packed)):NULL),(querySlot->size),(reference->numRefs),options,(reference->refReverseStart),(reference->outputFile),(reference->reverseOutputFile),(reference->intervalCaches),windows,&(reference->totalNumMatches),&(reference->totalSumMatchesSizes));
+			if(streamId!=(-1)) fflush(reference->outputFile); // the matches of each streamed query are available as soon as it is processed
+		}
+		ReleaseQuerySlot(queryReader,querySlot);
+		numQueries++;
+	}
+	CloseQueryReader(queryReader);
+	cacheHits=0;
+	cacheLookups=0;
+	for(r=0;r<numReferences;r++){
+		reference=&(references[r]);
+		for(s=0;s<2;s++){
+			GetLCPIntervalCacheStats((reference->intervalCaches[s]),&n,&k);
+			cacheHits+=n;
+			cacheLookups+=k;
+			FreeLCPIntervalCache(reference->intervalCaches[s]);
+		}
+		if((reference->reverseOutputFile)!=NULL) fclose(reference->reverseOutputFile);
+		UseMatchingReference(reference);
+		FreeRefLabels();
+		FreeRefStartsTable(refStarts);
+		refStarts=NULL;
+		DetachMatchingIndex();
+	}
+	for(s=0;s<2;s++) free(windows[s]);
+	if(matchType!=SMEM_MATCH_TYPE) printf(":: Parent intervals cache hits = %.2lf%% (%lld of %lld)\n",((cacheLookups==0)?(0.0):(((double)cacheHits/(double)cacheLookups)*100.0)),cacheHits,cacheLookups);
+	for(r=0;r<numReferences;r++){
+		reference=&(references[r]);
+		if(numQueries>1){ // if more than one query, print average stats for all queries
+			printf(":: Average %d %ss found per query sequence",(int)((reference->totalNumMatches)/numQueries),matchTypeNames[matchType]);
+			if(numReferences!=1) printf(" in <%s>",(reference->name));
+			printf(" (total = %lld, avg size = %d bp)\n",(reference->totalNumMatches),(int)(((reference->totalNumMatches)==0)?(0):((reference->totalSumMatchesSizes)/(reference->totalNumMatches))));
+		}
+		fflush(stdout);
+		printf("> Saving %ss to <%s> ... ",matchTypeNames[matchType],(reference->outFilename));
+		fclose(reference->outputFile);
+		printf("OK\n");
+		fflush(stdout);
+		if((reference->outFilename)!=outFilename) free(reference->outFilename); // the names of the multiple references were created by LoadMatchingReferences
+	}
+	free(references);
+}
+
+#ifdef SERVER_MODE
+#define SERVERREQUESTSIZE 256
+#define SERVERBUFFERSIZE (1<<16)
+
+typedef struct _ServerWorker {
+	int listenSocket;
+	int numRefs, acgtOnly;
+	unsigned int minSeqLength;
+	LCPIntervalCache *intervalCaches[2];
+	char *windows[2];
+	pthread_t thread;
+} ServerWorker;
+
+// Writes the whole buffer to the socket, and returns 0 if the other side was closed
+int WriteToSocket(int socketFd, char *buffer, size_t size){
+	ssize_t n;
+	while(size!=0){
+		n=write(socketFd,buffer,size);
+		if(n<0 && errno==EINTR) continue;
+		if(n<=0) return 0;
+		buffer+=n;
+		size-=(size_t)n;
+	}
+	return 1;
+}
+
+// Reads one line (without the newline char) from the socket one char at a time, so that nothing after it is consumed
+int ReadSocketLine(int socketFd, char *line, int maxLineSize){
+	ssize_t n;
+	int size;
+	size=0;
+	while(size<(maxLineSize-1)){
+		n=read(socketFd,(line+size),1);
+		if(n<0 && errno==EINTR) continue;
+		if(n<=0) return 0;
+		if(line[size]=='\n') break;
+		size++;
+	}
+	line[size]='\0';
+	return 1;
+}
 
-void GetMatches(int numRefs, int numSeqs, int matchType, int minMatchSize, int bothStrands, char *outFilename){
+// Matches all the queries sent by one client with the options in its request, and streams back the matches in the usual format
+// NOTE: the request is a line with "SLAMEM <match_type> <min_match_size> <both_strands>" followed by the query sequences in FASTA
+//  format, and the reply is a line with "OK" (or "ERROR <message>") followed by the contents of the MEMs file
+void ServeClient(ServerWorker *worker, int clientSocket){
+	char request[SERVERREQUESTSIZE];
+	SequenceStream *queryStream;
+	Sequence *query;
 	FILE *matchesOutputFile;
-	int i, s, depth, matchSize, numMatches, refId;
-	unsigned int j, textsize, refPos;
-	long long int sumMatchesSize, totalNumMatches, totalAvgMatchesSize;
-	unsigned int topPtr, bottomPtr, prevTopPtr, prevBottomPtr, savedTopPtr, savedBottomPtr, n;
-	char c, *text;
-	char *refsTexts[1];
-	unsigned int refsTextSizes[1];
-	unsigned char *lcpArray;
-	int progressCounter, progressStep;
-	#ifdef DEBUGMEMS
-	char *refText;
-	int refSize;
-	#endif
-	#if defined(unix) && defined(BENCHMARK)
-	char command[32];
-	int commretval;
-	#endif
-	printf("> Using options: minimum M%cM length = %d ; strand = %s\n", MATCH_TYPE_CHAR[matchType], minMatchSize,(bothStrands==0)?"forward only":"forward + reverse");
-	matchesOutputFile=fopen(outFilename,"w");
-	if(matchesOutputFile==NULL){
-		printf("\n> ERROR: Cannot create output file <%s>\n",outFilename);
-		exit(-1);
+	MatchingOptions options;
+	int matchType, minMatchSize, bothStrands, numQueries, outputSocket;
+	long long int totalNumMatches, totalSumMatchesSizes;
+	if(!ReadSocketLine(clientSocket,request,SERVERREQUESTSIZE) || sscanf(request,"SLAMEM %d %d %d",&matchType,&minMatchSize,&bothStrands)!=3
+			|| matchType<0 || matchType>1 || minMatchSize<1 || bothStrands<0 || bothStrands>1){
+		WriteToSocket(clientSocket,"ERROR Invalid request\n",22);
+		close(clientSocket);
+		printf("> WARNING: Invalid request received\n");
+		fflush(stdout);
+		return;
 	}
-	printf("> Building index for reference sequence");
-	if(numRefs==1) printf(" \"%s\"", (allSequences[0]->name));
-	else printf("s");
-	printf(" (%u Mbp) ...\n",(allSequences[0]->size)/1000000U);
+	outputSocket=dup(clientSocket); // the matches are written while the next queries are still being received
+	if(outputSocket<0 || (matchesOutputFile=fdopen(outputSocket,"w"))==NULL){
+		WriteToSocket(clientSocket,"ERROR Cannot reply to request\n",30);
+		if(outputSocket>=0) close(outputSocket);
+		close(clientSocket);
+		return;
+	}
+	if((queryStream=OpenSequenceStreamFromDescriptor(clientSocket,(worker->acgtOnly),(worker->minSeqLength)))==NULL){
+		fprintf(matchesOutputFile,"ERROR Cannot read the queries\n");
+		fclose(matchesOutputFile);
+		close(clientSocket);
+		return;
+	}
+	fprintf(matchesOutputFile,"OK\n");
+	memset(&options,0,sizeof(MatchingOptions)); // the clients can only choose the match type, the minimum length and the strands
+	options.matchType=matchType;
+	options.minMatchSize=minMatchSize;
+	options.bothStrands=bothStrands;
+	numQueries=0;
+	totalNumMatches=0;
+	totalSumMatchesSizes=0;
+	while((query=ReadNextSequenceFromStream(queryStream))!=NULL){
+		MatchQuerySequence((query->name),(query->chars),NULL,(query->size),(worker->numRefs),&options,UINT_MAX,matchesOutputFile,NULL,(worker->intervalCaches),(worker->windows),&totalNumMatches,&totalSumMatchesSizes);
+		fflush(matchesOutputFile); // each query is sent back as soon as it is matched
+		numQueries++;
+	}
+	CloseSequenceStream(queryStream);
+	fclose(matchesOutputFile);
+	printf(":: Served %d quer%s (%lld %ss ; min length = %d ; strand = %s)\n",numQueries,((numQueries==1)?"y":"ies"),totalNumMatches,matchTypeNames[matchType],minMatchSize,((bothStrands)?"forward + reverse":"forward only"));
 	fflush(stdout);
-	text=(allSequences[0]->chars);
-	textsize=(allSequences[0]->size);
-	refId=0;
-	refsTexts[0]=text;
-	refsTextSizes[0]=textsize;
-	lcpArray=NULL;
-	FMI_BuildIndex(refsTexts,refsTextSizes,1,&lcpArray,1);
-	i=BuildSampledLCPArray(text,textsize,lcpArray,minMatchSize,1);
-	if(lcpArray!=NULL) free(lcpArray);
-	#ifndef DEBUGMEMS
-	FreeSequenceChars(allSequences[0]);
-	#else
-	refText=(allSequences[0]->chars);
-	refSize=(allSequences[0]->size);
-	#endif
-	#if defined(unix) && defined(BENCHMARK)
-	sprintf(command,"memusgpid %d &",(int)getpid());
-	commretval=system(command);
-	#endif
-	printf("> Matching query sequences against index ...\n");
+}
+
+void *ServeClients(void *arg){
+	ServerWorker *worker;
+	int clientSocket;
+	worker=(ServerWorker *)arg;
+	while(1){
+		clientSocket=accept((worker->listenSocket),NULL,NULL);
+		if(clientSocket<0){
+			if(errno==EINTR || errno==ECONNABORTED) continue;
+			printf("> WARNING: Cannot accept connection (%s)\n",strerror(errno));
+			fflush(stdout);
+			sleep(1);
+			continue;
+		}
+		ServeClient(worker,clientSocket);
+	}
+	return NULL;
+}
+
+// Removes the socket file left by a previous server that is no longer running (no connections are accepted on it), and exits if the
+//  file is not a socket or if another server is still listening on it
+void RemoveStaleSocketFile(struct sockaddr_un *socketAddress){
+	struct stat fileStats;
+	int testSocket, connectError;
+	if(lstat((socketAddress->sun_path),&fileStats)!=0) return; // no file yet
+	if(!S_ISSOCK(fileStats.st_mode)){
+		printf("\n> ERROR: File <%s> already exists and is not a socket\n",(socketAddress->sun_path));
+		exit(-1);
+	}
+	if((testSocket=socket(AF_UNIX,SOCK_STREAM,0))<0){
+		printf("\n> ERROR: Cannot create socket (%s)\n",strerror(errno));
+		exit(-1);
+	}
+	connectError=0;
+	if(connect(testSocket,(struct sockaddr *)socketAddress,sizeof(struct sockaddr_un))<0) connectError=errno;
+	close(testSocket);
+	if(connectError==0){
+		printf("\n> ERROR: Socket <%s> is already being served by another process\n",(socketAddress->sun_path));
+		exit(-1);
+	}
+	if(connectError!=ECONNREFUSED){
+		printf("\n> ERROR: Cannot check socket <%s> (%s)\n",(socketAddress->sun_path),strerror(connectError));
+		exit(-1);
+	}
+	if(unlink(socketAddress->sun_path)!=0){
+		printf("\n> ERROR: Cannot remove stale socket <%s> (%s)\n",(socketAddress->sun_path),strerror(errno));
+		exit(-1);
+	}
+}
+
+// Builds the index of the reference(s) once and keeps it in memory, to match the queries sent by any number of clients through the
+//  local socket, with each one served by one of the worker threads
+// NOTE: the server runs until it is killed
+void ServeMatches(int numRefs, char *socketFilename, int acgtOnly, unsigned int minSeqLength, int numWorkers, int numThreads, char *indexFilename){
+	struct sockaddr_un socketAddress;
+	ServerWorker *workers;
+	int listenSocket, w, s;
+	if(strlen(socketFilename)>=sizeof(socketAddress.sun_path)){
+		printf("\n> ERROR: Socket file name <%s> is too long\n",socketFilename);
+		exit(-1);
+	}
+	memset(&socketAddress,0,sizeof(socketAddress));
+	socketAddress.sun_family=AF_UNIX;
+	strcpy(socketAddress.sun_path,socketFilename);
+	RemoveStaleSocketFile(&socketAddress); // checked before the (slow) loading of the index
+	LoadMatchingIndex(indexFilename,numRefs,0,0,0,numThreads);
+	if(numRefs!=1) CreateRefLabels(numRefs);
+	signal(SIGPIPE,SIG_IGN); // a client that disconnects early only ends its own request
+	if((listenSocket=socket(AF_UNIX,SOCK_STREAM,0))<0){
+		printf("\n> ERROR: Cannot create socket (%s)\n",strerror(errno));
+		exit(-1);
+	}
+	if(bind(listenSocket,(struct sockaddr *)&socketAddress,sizeof(socketAddress))<0 || listen(listenSocket,SOMAXCONN)<0){
+		printf("\n> ERROR: Cannot listen on socket <%s> (%s)\n",socketFilename,strerror(errno));
+		exit(-1);
+	}
+	quietMatching=1; // the progress of the queries of concurrent clients would be interleaved
+	printf("> Serving queries on socket <%s> with %d worker%s ...\n",socketFilename,numWorkers,((numWorkers==1)?"":"s"));
 	fflush(stdout);
-	totalNumMatches=0;
-	totalAvgMatchesSize=0;
-	for(i=numRefs;i<numSeqs;i++){ // process all queries
-		LoadSequenceChars(allSequences[i]);
-		text=(allSequences[i]->chars);
-		textsize=(allSequences[i]->size);
-		progressStep=(textsize/10);
-		for(s=0;s<=bothStrands;s++){ // process one or both strands
-			if(s==0){ // forward strand
-				printf(":: \"%s\" ",(allSequences[i]->name));
-				fprintf(matchesOutputFile,">%s\n",(allSequences[i]->name));
-			} else { // reverse strand
-				ReverseComplementSequence(text,textsize); // convert to reverse strand
-				printf(":: \"%s Reverse\" ",(allSequences[i]->name));
-				fprintf(matchesOutputFile,">%s Reverse\n",(allSequences[i]->name));
+	workers=(ServerWorker *)malloc(numWorkers*sizeof(ServerWorker));
+	for(w=0;w<numWorkers;w++){
+		workers[w].listenSocket=listenSocket;
+		workers[w].numRefs=numRefs;
+		workers[w].acgtOnly=acgtOnly;
+		workers[w].minSeqLength=minSeqLength;
+		for(s=0;s<2;s++){
+			workers[w].intervalCaches[s]=NewLCPIntervalCache(refLCPArray);
+			workers[w].windows[s]=(char *)malloc(QUERYWINDOWSIZE*sizeof(char));
+		}
+		if(w==0) continue; // the first worker runs in this thread
+		if(pthread_create(&(workers[w].thread),NULL,ServeClients,(void *)&(workers[w]))!=0){
+			printf("\n> ERROR: Failed to create worker thread\n");
+			exit(-1);
+		}
+	}
+	ServeClients((void *)&(workers[0]));
+}
+
+typedef struct _RemoteSender {
+	int socketFd;
+	char **queryFilenames;
+	int numQueryFiles;
+	int failed;
+} RemoteSender;
+
+// Sends the contents of all the query files to the server, and then closes the sending side of the socket
+void *SendRemoteQueries(void *arg){
+	RemoteSender *sender;
+	FILE *queryFile;
+	char *buffer;
+	size_t n;
+	int i;
+	sender=(RemoteSender *)arg;
+	buffer=(char *)malloc(SERVERBUFFERSIZE*sizeof(char));
+	for(i=0;i<(sender->numQueryFiles) && !(sender->failed);i++){
+		if((sender->queryFilenames[i])[0]=='-' && (sender->queryFilenames[i])[1]=='\0') queryFile=stdin;
+		else if((queryFile=fopen((sender->queryFilenames[i]),"rb"))==NULL){
+			printf("> WARNING: Sequence file <%s> not found\n",(sender->queryFilenames[i]));
+			continue;
+		}
+		while((n=fread(buffer,sizeof(char),SERVERBUFFERSIZE,queryFile))!=0){
+			if(!WriteToSocket((sender->socketFd),buffer,n)){
+				sender->failed=1;
+				break;
 			}
-			fflush(stdout);
-			progressCounter=0;
-			matchSize=0;
-			numMatches=0;
-			sumMatchesSize=0;
-			depth=0;
-			topPtr=0;
-			bottomPtr=FMI_GetBWTSize();
-			prevTopPtr=topPtr;
-			prevBottomPtr=bottomPtr;
-			for(j=textsize;j!=0;){
-				j--;
-				if(progressCounter==progressStep){ // print progress dots
-					putchar('.');
-					fflush(stdout);
-					progressCounter=0;
-				} else progressCounter++;
-				while( (n=FMI_FollowLetter(text[j],&topPtr,&bottomPtr))==0 ){ // when no match exits, follow prefix links to broaden the interval
-					topPtr = prevTopPtr; // restore pointer values, because they got lost when no hits exist
-					bottomPtr = prevBottomPtr;
-					depth = GetEnclosingLCPInterval(&topPtr,&bottomPtr); // get enclosing interval and corresponding destination depth
-					if( depth == -1 ) break; // can happen for example when current seq contains 'N's but the indexed reference does not
-					prevTopPtr = topPtr; // save pointer values in case the match fails again
-					prevBottomPtr = bottomPtr;
-				}
-				depth++;
-				if( depth >= minMatchSize ){
-					if(matchType==1 && n!=1) continue; // not a MAM if we are looking for one
-					savedTopPtr = topPtr; // save the original interval to restore after finished processing MEMs
-					savedBottomPtr = bottomPtr;
-					prevTopPtr = (bottomPtr+1); // to process the first interval entirely
-					prevBottomPtr = bottomPtr;
-					matchSize = depth;
-					if( j != 0 ) c = text[j-1]; // next char to be processed (to the left)
-					else c = '\0';
-					while( matchSize >= minMatchSize ){ // process all parent intervals down to this size limit
-						for( n = topPtr ; n != prevTopPtr ; n++ ){ // from topPtr down to prevTopPtr
-							if( FMI_GetCharAtBWTPos(n) != c ){
-								refPos = FMI_PositionInText(n);
-								#ifndef DEBUGMEMS
-								if(numRefs!=1){ // multiple refs
-									refId = GetSeqIdFromMergedSeqsPos(&refPos); // get ref id and pos inside that ref
-									fprintf(matchesOutputFile," %s\t",(allSequences[refId]->name));
-								}
-								fprintf(matchesOutputFile,"%u\t%d\t%d\n",(refPos+1),(j+1),matchSize);
-								#else
-								fprintf(matchesOutputFile,"%u\t%d\t%d",(refPos+1),(j+1),matchSize);
-								fputc('\t',matchesOutputFile);
-								fputc((refPos==0)?('$'):(refText[refPos-1]+32),matchesOutputFile);
-								fprintf(matchesOutputFile,"%.*s...%.*s",4,(char *)(refText+refPos),4,(char *)(refText+refPos+matchSize-4));
-								fputc(((refPos+matchSize)==refSize)?('$'):(refText[refPos+matchSize]+32),matchesOutputFile);
-								fputc('\t',matchesOutputFile);
-								fputc((j==0)?('$'):(text[j-1]+32),matchesOutputFile);
-								fprintf(matchesOutputFile,"%.*s...%.*s",4,(char *)(text+j),4,(char *)(text+j+matchSize-4));
-								fputc(((j+matchSize)==textsize)?('$'):(text[j+matchSize]+32),matchesOutputFile);
-								fputc('\n',matchesOutputFile);
-								#endif
-								numMatches++;
-								sumMatchesSize += matchSize;
-							}
-						}
-						for( n = bottomPtr ; n != prevBottomPtr ; n-- ){ // from bottomPtr up to prevBottomPtr
-							if( FMI_GetCharAtBWTPos(n) != c ){
-								refPos = FMI_PositionInText(n);
-								#ifndef DEBUGMEMS
-								if(numRefs!=1){ // multiple refs
-									refId = GetSeqIdFromMergedSeqsPos(&refPos); // get ref id and pos inside that ref
-									fprintf(matchesOutputFile," %s\t",(allSequences[refId]->name));
-								}
-								fprintf(matchesOutputFile,"%u\t%d\t%d\n",(refPos+1),(j+1),matchSize);
-								#else
-								fprintf(matchesOutputFile,"%u\t%d\t%d",(refPos+1),(j+1),matchSize);
-								fputc('\t',matchesOutputFile);
-								fputc((refPos==0)?('$'):(refText[refPos-1]+32),matchesOutputFile);
-								fprintf(matchesOutputFile,"%.*s...%.*s",4,(char *)(refText+refPos),4,(char *)(refText+refPos+matchSize-4));
-								fputc(((refPos+matchSize)==refSize)?('$'):(refText[refPos+matchSize]+32),matchesOutputFile);
-								fputc('\t',matchesOutputFile);
-								fputc((j==0)?('$'):(text[j-1]+32),matchesOutputFile);
-								fprintf(matchesOutputFile,"%.*s...%.*s",4,(char *)(text+j),4,(char *)(text+j+matchSize-4));
-								fputc(((j+matchSize)==textsize)?('$'):(text[j+matchSize]+32),matchesOutputFile);
-								fputc('\n',matchesOutputFile);
-								#endif
-								numMatches++;
-								sumMatchesSize += matchSize;
-							}
-						}
-						prevTopPtr = topPtr;
-						prevBottomPtr = bottomPtr;
-						matchSize = GetEnclosingLCPInterval(&topPtr,&bottomPtr); // get parent interval and its depth
-					}
-					topPtr = savedTopPtr;
-					bottomPtr = savedBottomPtr;
-				}
-				prevTopPtr=topPtr; // save pointer values in case there's no match on the next char, and they loose their values
-				prevBottomPtr=bottomPtr;
-			} // end of loop for all chars of seq
-			totalNumMatches += numMatches;
-			totalAvgMatchesSize += sumMatchesSize;
-			matchSize=(int)((numMatches==0)?(0):(sumMatchesSize/(long long)numMatches));
-			printf(" (%d M%cMs ; avg size = %d bp)\n",numMatches,MATCH_TYPE_CHAR[matchType],matchSize);
-			fflush(stdout);
-		} // end of loop for both strands
-		FreeSequenceChars(allSequences[i]);
-	} // end of loop for all queries
-	FMI_FreeIndex();
-	FreeSampledSuffixArray();
-	if((numSeqs-numRefs)!=1){ // if more than one query, print average stats for all queries
-		printf(":: Average %d M%cMs found per query sequence (total = %lld, avg size = %d bp)\n",(int)(totalNumMatches/(numSeqs-numRefs)),MATCH_TYPE_CHAR[matchType],totalNumMatches,(int)(totalAvgMatchesSize/totalNumMatches));
+		}
+		if(queryFile!=stdin) fclose(queryFile);
+	}
+	free(buffer);
+	shutdown((sender->socketFd),SHUT_WR);
+	return NULL;
+}
+
+// Sends the query files to a server started with "-serve" (which already has the index in memory) and saves the matches it returns
+int GetRemoteMatches(char *socketFilename, char **queryFilenames, int numQueryFiles, int matchType, int minMatchSize, int bothStrands, char *outFilename){
+	struct sockaddr_un socketAddress;
+	RemoteSender sender;
+	pthread_t senderThread;
+	FILE *matchesOutputFile, *replyFile;
+	char request[SERVERREQUESTSIZE], *buffer;
+	size_t n;
+	int socketFd;
+	printf("> Using options: minimum %s length = %d ; strand = %s\n",matchTypeNames[matchType],minMatchSize,((bothStrands)?"forward + reverse":"forward only"));
+	if(strlen(socketFilename)>=sizeof(socketAddress.sun_path)){
+		printf("\n> ERROR: Socket file name <%s> is too long\n",socketFilename);
+		exit(-1);
+	}
+	signal(SIGPIPE,SIG_IGN);
+	memset(&socketAddress,0,sizeof(socketAddress));
+	socketAddress.sun_family=AF_UNIX;
+	strcpy(socketAddress.sun_path,socketFilename);
+	if((socketFd=socket(AF_UNIX,SOCK_STREAM,0))<0 || connect(socketFd,(struct sockaddr *)&socketAddress,sizeof(socketAddress))<0){
+		printf("\n> ERROR: Cannot connect to server on socket <%s> (%s)\n",socketFilename,strerror(errno));
+		exit(-1);
 	}
+	printf("> Sending queries to server on socket <%s> ...\n",socketFilename);
 	fflush(stdout);
-	printf("> Saving M%cMs to <%s> ... ",MATCH_TYPE_CHAR[matchType],outFilename);
+	sprintf(request,"SLAMEM %d %d %d\n",matchType,minMatchSize,bothStrands);
+	if(!WriteToSocket(socketFd,request,strlen(request))){
+		printf("\n> ERROR: Cannot send request to server\n");
+		exit(-1);
+	}
+	sender.socketFd=socketFd;
+	sender.queryFilenames=queryFilenames;
+	sender.numQueryFiles=numQueryFiles;
+	sender.failed=0;
+	if(pthread_create(&senderThread,NULL,SendRemoteQueries,(void *)&sender)!=0){ // the matches are received while the queries are sent
+		printf("\n> ERROR: Failed to create sending thread\n");
+		exit(-1);
+	}
+	replyFile=fdopen(dup(socketFd),"r");
+	if(replyFile==NULL || fgets(request,SERVERREQUESTSIZE,replyFile)==NULL || strncmp(request,"OK",2)!=0){
+		if(replyFile!=NULL && strncmp(request,"ERROR ",6)==0) printf("\n> ERROR: Server replied: %s",(request+6));
+		else printf("\n> ERROR: No reply from server\n");
+		exit(-1);
+	}
+	if((matchesOutputFile=fopen(outFilename,"w"))==NULL){
+		printf("\n> ERROR: Cannot create output file <%s>\n",outFilename);
+		exit(-1);
+	}
+	buffer=(char *)malloc(SERVERBUFFERSIZE*sizeof(char));
+	while((n=fread(buffer,sizeof(char),SERVERBUFFERSIZE,replyFile))!=0) fwrite(buffer,sizeof(char),n,matchesOutputFile);
+	free(buffer);
+	pthread_join(senderThread,NULL);
+	fclose(replyFile);
+	close(socketFd);
+	if(sender.failed) printf("> WARNING: The server closed the connection before receiving all the queries\n");
+	printf("> Saving %ss to <%s> ... ",matchTypeNames[matchType],outFilename);
 	fclose(matchesOutputFile);
 	printf("OK\n");
 	fflush(stdout);
+	return (sender.failed)?(-1):0;
 }
+#endif
 
-typedef struct _MEMInfo {
-	char refName[65];
-	int refPos;
-	int queryPos;
-	int size;
-} MEMInfo;
+#define DEFAULTSORTMEMORY 1024
+#define MAXSPILLEDRUNS 256
+#define MINCHUNKSIZE 65536
 
-int MEMInfoSortFunction(const void *a, const void *b){
-	char *charsa, *charsb;
-	int diff;
-	diff = 0;
-	charsa = (((MEMInfo *)a)->refName);
-	charsb = (((MEMInfo *)b)->refName);
-	while((diff=(int)((*charsa)-(*charsb)))==0 && (*charsa)!='\0'){ charsa++; charsb++; }
-	if(diff==0){
-		diff = ((((MEMInfo *)a)->refPos) - (((MEMInfo *)b)->refPos));
-		if(diff==0) diff = ((((MEMInfo *)a)->queryPos) - (((MEMInfo *)b)->queryPos));
+typedef struct _RefNameEntry {
+	char *name;
+	unsigned int rank;
+} RefNameEntry;
+
+static RefNameEntry *refNamesTable = NULL; // hash table with the names of the refs found in the MEMs file
+static int refNamesTableSize = 0, numRefNames = 0;
+
+// Returns the position in the hash table of the entry with this ref name, or of the empty slot where it should be
+int FindRefNameSlot(char *name){
+	unsigned int hash;
+	char *c;
+	hash=2166136261U; // FNV-1a
+	for(c=name;(*c)!='\0';c++) hash=((hash^(unsigned char)(*c))*16777619U);
+	hash&=(unsigned int)(refNamesTableSize-1);
+	while(refNamesTable[hash].name!=NULL && strcmp(refNamesTable[hash].name,name)!=0) hash=((hash+1)&(unsigned int)(refNamesTableSize-1));
+	return (int)hash;
+}
+
+// Returns the entry of this ref name, adding it to the hash table if it is not there yet
+RefNameEntry *GetRefNameEntry(char *name){
+	RefNameEntry *oldTable;
+	int oldTableSize, i, k;
+	if(refNamesTableSize==0){
+		refNamesTableSize=1024;
+		refNamesTable=(RefNameEntry *)calloc(refNamesTableSize,sizeof(RefNameEntry));
 	}
-	return diff;
+	k=FindRefNameSlot(name);
+	if(refNamesTable[k].name!=NULL) return &(refNamesTable[k]);
+	if(2*(numRefNames+1)>refNamesTableSize){ // keep the table at most half full
+		oldTable=refNamesTable;
+		oldTableSize=refNamesTableSize;
+		refNamesTableSize*=2;
+		refNamesTable=(RefNameEntry *)calloc(refNamesTableSize,sizeof(RefNameEntry));
+		for(i=0;i<oldTableSize;i++) if(oldTable[i].name!=NULL) refNamesTable[FindRefNameSlot(oldTable[i].name)]=oldTable[i];
+		free(oldTable);
+		k=FindRefNameSlot(name);
+	}
+	refNamesTable[k].name=(char *)malloc((strlen(name)+1)*sizeof(char));
+	strcpy(refNamesTable[k].name,name);
+	refNamesTable[k].rank=0;
+	numRefNames++;
+	return &(refNamesTable[k]);
+}
+
+void FreeRefNamesTable(){
+	int i;
+	for(i=0;i<refNamesTableSize;i++) if(refNamesTable[i].name!=NULL) free(refNamesTable[i].name);
+	free(refNamesTable);
+	refNamesTable=NULL;
+	refNamesTableSize=0;
+	numRefNames=0;
+}
+
+int RefNameStringSortFunction(const void *a, const void *b){
+	return strcmp((*(char **)a),(*(char **)b));
+}
+
+typedef struct _MEMsChunk {
+	SortedMatch *matches; // part of the buffer sorted by one thread (points to the sorted matches when finished)
+	SortedMatch *tempMatches;
+	int numMatches;
+} MEMsChunk;
+
+typedef struct _MEMsRun {
+	FILE *file; // run spilled to a temporary file (read forwards), or NULL if it is a sorted chunk still in memory (read backwards)
+	SortedMatch *matches;
+	long long numMatches; // number of matches not read yet
+	SortedMatch match; // largest match not yet merged
+} MEMsRun;
+
+typedef struct _MEMsSorter {
+	SortedMatch *matches, *tempMatches;
+	int numMatches, maxNumMatches, maxBufferMatches;
+	int numThreads;
+	MEMsChunk *chunks;
+	#ifdef PARALLEL_SORT
+	pthread_t *threads;
+	#endif
+	FILE *spilledRuns[MAXSPILLEDRUNS];
+	long long numSpilledMatches[MAXSPILLEDRUNS];
+	int numSpilledRuns, numSpills;
+	MEMsRun *runs;
+	char **refNames; // names of the refs by rank, or NULL if the MEMs file does not have ref names
+} MEMsSorter;
+
+void *SortMEMsChunk(void *arg){
+	MEMsChunk *chunk;
+	chunk=(MEMsChunk *)arg;
+	chunk->matches=RadixSortMatches((chunk->matches),(chunk->tempMatches),(chunk->numMatches));
+	return NULL;
+}
+
+// Splits the buffer of matches in one chunk per thread, radix sorts all chunks in parallel, and adds them as runs to be merged after the spilled ones
+int SortMEMsBuffer(MEMsSorter *sorter, int numRuns){
+	int numChunks, chunkStart, chunkEnd, i;
+	numChunks=((sorter->numMatches)/MINCHUNKSIZE)+1; // small buffers are not worth splitting
+	if(numChunks>(sorter->numThreads)) numChunks=(sorter->numThreads);
+	sorter->tempMatches=(SortedMatch *)malloc(((sorter->numMatches)+1)*sizeof(SortedMatch));
+	for(i=0;i<numChunks;i++){
+		chunkStart=(int)(((long long)(sorter->numMatches)*(long long)i)/(long long)numChunks);
+		chunkEnd=(int)(((long long)(sorter->numMatches)*(long long)(i+1))/(long long)numChunks);
+		sorter->chunks[i].matches=((sorter->matches)+chunkStart);
+		sorter->chunks[i].tempMatches=((sorter->tempMatches)+chunkStart);
+		sorter->chunks[i].numMatches=(chunkEnd-chunkStart);
+		if(i==0) continue; // the first chunk is sorted by this thread
+		#ifdef PARALLEL_SORT
+		if(pthread_create(&(sorter->threads[i]),NULL,SortMEMsChunk,(void *)&(sorter->chunks[i]))!=0){
+			printf("\n> ERROR: Failed to create sorting thread\n");
+			exit(-1);
+		}
+		#else
+		SortMEMsChunk((void *)&(sorter->chunks[i]));
+		#endif
+	}
+	SortMEMsChunk((void *)&(sorter->chunks[0]));
+	#ifdef PARALLEL_SORT
+	for(i=1;i<numChunks;i++) pthread_join((sorter->threads[i]),NULL);
+	#endif
+	for(i=0;i<numChunks;i++){
+		sorter->runs[numRuns].file=NULL;
+		sorter->runs[numRuns].matches=(sorter->chunks[i].matches);
+		sorter->runs[numRuns].numMatches=(long long)(sorter->chunks[i].numMatches);
+		numRuns++;
+	}
+	return numRuns;
+}
+
+// Loads the next match of the run (by decreasing order), and returns 0 if the run has no more matches
+int NextMEMInRun(MEMsRun *run){
+	if((run->numMatches)==0) return 0;
+	(run->numMatches)--;
+	if((run->file)!=NULL){
+		if(fread(&(run->match),sizeof(SortedMatch),1,(run->file))!=1){
+			printf("\n> ERROR: Cannot read temporary file\n");
+			exit(-1);
+		}
+	} else run->match=(run->matches)[(run->numMatches)];
+	return 1;
+}
+
+// Returns a positive value if the match of the run a comes after the one of the run b (sorted by ref, ref position and query position)
+int CompareMEMsRuns(MEMsRun *a, MEMsRun *b){
+	if((a->match.refRank)!=(b->match.refRank)) return (((a->match.refRank)>(b->match.refRank))?1:(-1));
+	if((a->match.refPos)!=(b->match.refPos)) return (((a->match.refPos)>(b->match.refPos))?1:(-1));
+	if((a->match.queryPos)!=(b->match.queryPos)) return (((a->match.queryPos)>(b->match.queryPos))?1:(-1));
+	return 0;
+}
+
+void SiftDownMEMsRun(MEMsRun **heap, int heapSize, int i){
+	MEMsRun *run;
+	int k;
+	run=heap[i];
+	while((k=(2*i+1))<heapSize){
+		if((k+1)<heapSize && CompareMEMsRuns(heap[(k+1)],heap[k])>0) k++;
+		if(CompareMEMsRuns(heap[k],run)<=0) break;
+		heap[i]=heap[k];
+		i=k;
+	}
+	heap[i]=run;
+}
+
+// Merges the runs by decreasing order of their matches, either to a temporary file (in binary) or to the sorted MEMs file, and returns the number of matches
+long long MergeMEMsRuns(MEMsSorter *sorter, int numRuns, FILE *outputFile, int binaryOutput){
+	MEMsRun **heap, *run;
+	long long numMerged;
+	int heapSize, i;
+	heap=(MEMsRun **)malloc((numRuns+1)*sizeof(MEMsRun *));
+	heapSize=0;
+	for(i=0;i<numRuns;i++) if(NextMEMInRun(&(sorter->runs[i]))) heap[(heapSize++)]=&(sorter->runs[i]);
+	for(i=((heapSize/2)-1);i>=0;i--) SiftDownMEMsRun(heap,heapSize,i);
+	numMerged=0;
+	while(heapSize!=0){
+		run=heap[0];
+		if(binaryOutput) fwrite(&(run->match),sizeof(SortedMatch),1,outputFile);
+		else {
+			if((sorter->refNames)!=NULL) fprintf(outputFile," %s\t",(sorter->refNames)[(run->match.refRank)]);
+			fprintf(outputFile,"%u\t%u\t%d\n",(run->match.refPos),(run->match.queryPos),(run->match.matchSize));
+		}
+		numMerged++;
+		if(!NextMEMInRun(run)){
+			heapSize--;
+			if(heapSize==0) break;
+			heap[0]=heap[heapSize];
+		}
+		SiftDownMEMsRun(heap,heapSize,0);
+	}
+	free(heap);
+	return numMerged;
+}
+
+// Sets the spilled runs as the first runs to be merged, and returns their number
+int GetSpilledMEMsRuns(MEMsSorter *sorter){
+	int i;
+	for(i=0;i<(sorter->numSpilledRuns);i++){
+		rewind(sorter->spilledRuns[i]);
+		sorter->runs[i].file=(sorter->spilledRuns[i]);
+		sorter->runs[i].matches=NULL;
+		sorter->runs[i].numMatches=(sorter->numSpilledMatches[i]);
+	}
+	return (sorter->numSpilledRuns);
+}
+
+void CloseSpilledMEMsRuns(MEMsSorter *sorter){
+	int i;
+	for(i=0;i<(sorter->numSpilledRuns);i++) fclose(sorter->spilledRuns[i]);
+	sorter->numSpilledRuns=0;
+}
+
+// Sorts the buffer and writes it to a new temporary file, or merges it with all the previous ones if the limit of temporary files was reached
+void SpillMEMsBuffer(MEMsSorter *sorter){
+	FILE *runFile;
+	long long numMerged;
+	int numRuns;
+	numRuns=0;
+	if((sorter->numSpilledRuns)==MAXSPILLEDRUNS) numRuns=GetSpilledMEMsRuns(sorter);
+	numRuns=SortMEMsBuffer(sorter,numRuns);
+	if((runFile=tmpfile())==NULL){
+		printf("\n> ERROR: Cannot create temporary file\n");
+		exit(-1);
+	}
+	numMerged=MergeMEMsRuns(sorter,numRuns,runFile,1);
+	free(sorter->tempMatches);
+	if((sorter->numSpilledRuns)==MAXSPILLEDRUNS) CloseSpilledMEMsRuns(sorter);
+	sorter->spilledRuns[(sorter->numSpilledRuns)]=runFile;
+	sorter->numSpilledMatches[(sorter->numSpilledRuns)]=numMerged;
+	(sorter->numSpilledRuns)++;
+	(sorter->numSpills)++;
+	sorter->numMatches=0;
+}
+
+// Adds a match to the buffer, spilling the sorted buffer to disk first if it is already using all the available memory
+void AddMEMToSorter(MEMsSorter *sorter, unsigned int refRank, unsigned int refPos, unsigned int queryPos, int matchSize){
+	SortedMatch *match;
+	if((sorter->numMatches)==(sorter->maxNumMatches)){
+		if((sorter->maxNumMatches)==(sorter->maxBufferMatches)) SpillMEMsBuffer(sorter);
+		else {
+			sorter->maxNumMatches*=2;
+			if((sorter->maxNumMatches)>(sorter->maxBufferMatches)) sorter->maxNumMatches=(sorter->maxBufferMatches);
+			sorter->matches=(SortedMatch *)realloc((sorter->matches),(sorter->maxNumMatches)*sizeof(SortedMatch));
+		}
+	}
+	match=&((sorter->matches)[(sorter->numMatches)++]);
+	match->refRank=refRank;
+	match->refPos=refPos;
+	match->queryPos=queryPos;
+	match->refId=(int)refRank;
+	match->matchSize=matchSize;
+}
+
+// Merges the sorted buffer with all the spilled runs into the sorted MEMs file, and returns the total number of matches of the query
+long long WriteSortedMEMs(MEMsSorter *sorter, FILE *sortedMemsFile){
+	long long numMerged;
+	int numRuns;
+	numRuns=GetSpilledMEMsRuns(sorter);
+	numRuns=SortMEMsBuffer(sorter,numRuns);
+	numMerged=MergeMEMsRuns(sorter,numRuns,sortedMemsFile,0);
+	free(sorter->tempMatches);
+	CloseSpilledMEMsRuns(sorter);
+	sorter->numMatches=0;
+	return numMerged;
+}
+
+// Reads the next line of the MEMs file, discarding the chars that do not fit in the buffer
+int ReadMEMsFileLine(FILE *memsFile, char *line, int maxLineSize){
+	int c, n;
+	if(fgets(line,maxLineSize,memsFile)==NULL) return 0;
+	n=(int)strlen(line);
+	if(n!=0 && line[(n-1)]=='\n') line[(n-1)]='\0';
+	else while((c=fgetc(memsFile))!='\n' && c!=EOF);
+	return 1;
 }
 
+// Copies the ref name at the start of the line (up to MAXREFNAMESIZE chars) and returns the position after it
+char *ParseMEMRefName(char *line, char *refName){
+	int n;
+	while((*line)==' ' || (*line)=='\t') line++;
+	n=0;
+	while((*line)!=' ' && (*line)!='\t' && (*line)!='\r' && (*line)!='\0'){
+		if(n<MAXREFNAMESIZE) refName[(n++)]=(*line);
+		line++;
+	}
+	refName[n]='\0';
+	return line;
+}
 
 // NOTE: the spacing of the MUMmer output format is in the form: "  <max_ref_name_size> <9_spaces_number> <9_spaces_number> <9_spaces_number>"
 // NOTE: in multi-ref format (4 columns) the name of the ref is considered only up to the 1st space char
-void SortMEMsFile(char *memsFilename){
+// NOTE: the MEMs of each query are sorted in chunks of at most the given amount of memory, which are radix sorted in parallel, spilled to temporary files and merged at the end of the query
+void SortMEMsFile(char *memsFilename, int maxMemory, int numThreads){
 	FILE *memsFile, *sortedMemsFile;
-	char c, *sortedMemsFilename, seqname[256];
-	int numMems, maxNumMems, numSeqs, refpos, querypos, memsize, formatNumFields, n;
-	MEMInfo *memsArray;
+	char c, *sortedMemsFilename, *line, *p, *end, seqname[256], refName[(MAXREFNAMESIZE+1)];
+	int numSeqs, numSpills, formatNumFields, n;
+	long refPos, queryPos, memSize;
+	long long numMems;
+	unsigned int refRank;
+	MEMsSorter sorter;
 	printf("> Sorting MEMs from <%s> ",memsFilename);
 	fflush(stdout);
 	if((memsFile=fopen(memsFilename, "r"))==NULL){
@@ -282,67 +2591,109 @@ void SortMEMsFile(char *memsFilename){
 	rewind(memsFile);
 	if(formatNumFields==4) printf("(multiple references) ");
 	printf("...\n");
+	if(maxMemory<1) maxMemory=1;
+	if(numThreads<1) numThreads=1;
+	printf(":: Using %d thread%s and up to %d MB of memory per sorting pass\n",numThreads,((numThreads==1)?"":"s"),maxMemory);
+	fflush(stdout);
+	line=(char *)malloc(1024*sizeof(char));
+	sorter.refNames=NULL;
+	if(formatNumFields==4){ // the ref names are collected first, so that they can be sorted by their rank
+		while(ReadMEMsFileLine(memsFile,line,1024)){
+			p=line;
+			while((*p)==' ' || (*p)=='\t') p++;
+			if((*p)=='>' || (*p)=='\0' || (*p)=='\r') continue;
+			ParseMEMRefName(p,refName);
+			GetRefNameEntry(refName);
+		}
+		rewind(memsFile);
+		sorter.refNames=(char **)malloc((numRefNames+1)*sizeof(char *));
+		n=0;
+		for(refRank=0;refRank<(unsigned int)refNamesTableSize;refRank++) if(refNamesTable[refRank].name!=NULL) sorter.refNames[(n++)]=refNamesTable[refRank].name;
+		qsort(sorter.refNames,numRefNames,sizeof(char *),RefNameStringSortFunction);
+		for(n=0;n<numRefNames;n++) GetRefNameEntry(sorter.refNames[n])->rank=(unsigned int)n;
+	}
 	sortedMemsFilename=AppendToBasename(memsFilename,"-sorted.txt");
 	if((sortedMemsFile=fopen(sortedMemsFilename,"w"))==NULL){
 		printf("> ERROR: Cannot write output file\n");
 		exit(-1);
 	}
+	sorter.maxBufferMatches=(int)(((long long)maxMemory*1048576LL)/(2LL*(long long)sizeof(SortedMatch))); // the radix sort needs a second buffer
+	if((long long)maxMemory*1048576LL>=(2LL*(long long)sizeof(SortedMatch)*(long long)INT_MAX)) sorter.maxBufferMatches=(INT_MAX-1);
+	sorter.maxNumMatches=1024;
+	if(sorter.maxNumMatches>sorter.maxBufferMatches) sorter.maxNumMatches=sorter.maxBufferMatches;
+	sorter.matches=(SortedMatch *)malloc((sorter.maxNumMatches)*sizeof(SortedMatch));
+	sorter.numMatches=0;
+	sorter.numThreads=numThreads;
+	sorter.chunks=(MEMsChunk *)malloc(numThreads*sizeof(MEMsChunk));
+	#ifdef PARALLEL_SORT
+	sorter.threads=(pthread_t *)malloc(numThreads*sizeof(pthread_t));
+	#endif
+	sorter.runs=(MEMsRun *)malloc((MAXSPILLEDRUNS+numThreads)*sizeof(MEMsRun));
+	sorter.numSpilledRuns=0;
+	sorter.numSpills=0;
 	seqname[0]='\0';
-	refpos=-1;
-	querypos=-1;
-	memsize=-1;
 	numSeqs=0;
-	numMems=0;
-	maxNumMems=0;
-	memsArray=NULL;
+	refRank=0;
 	while(1){
-		c=fgetc(memsFile);
-		if(c=='>' || c==EOF){
+		n=ReadMEMsFileLine(memsFile,line,1024);
+		p=line;
+		if(n) while((*p)==' ' || (*p)=='\t' || (*p)=='\r' || (*p)=='\n') p++;
+		if(n && (*p)=='\0') continue; // empty line
+		if(!n || (*p)=='>'){
 			if(numSeqs!=0){
-				printf("(%d MEMs)\n",numMems);
-				fflush(stdout);
-				qsort(memsArray,numMems,sizeof(MEMInfo),MEMInfoSortFunction);
 				fprintf(sortedMemsFile,">%s\n",seqname);
-				while(numMems!=0){
-					numMems--;
-					refpos=memsArray[numMems].refPos;
-					querypos=memsArray[numMems].queryPos;
-					memsize=memsArray[numMems].size;
-					if(formatNumFields==4) fprintf(sortedMemsFile," %s\t",(memsArray[numMems].refName));
-					fprintf(sortedMemsFile,"%d\t%d\t%d\n",refpos,querypos,memsize);
-				}
+				numSpills=sorter.numSpills;
+				numMems=WriteSortedMEMs(&sorter,sortedMemsFile);
+				if(numSpills!=0) printf("(%lld MEMs, %d runs on disk)\n",numMems,numSpills);
+				else printf("(%lld MEMs)\n",numMems);
+				fflush(stdout);
 			}
-			if(c==EOF) break;
-			numMems=0;
-			n=fscanf(memsFile," %255[^\n]\n",seqname);
+			if(!n) break;
+			p++;
+			while((*p)==' ' || (*p)=='\t') p++;
+			strncpy(seqname,p,255);
+			seqname[255]='\0';
+			sorter.numSpills=0;
 			printf(":: '%s' ... ",seqname);
 			fflush(stdout);
 			numSeqs++;
 			continue;
-		} else ungetc(c,memsFile);
-		if(numMems==maxNumMems){
-			maxNumMems+=1024;
-			memsArray=(MEMInfo *)realloc(memsArray,(maxNumMems*sizeof(MEMInfo)));
-		}
-		if(formatNumFields==4) n=fscanf(memsFile," %64[^\t ]",(memsArray[numMems].refName));
-		else memsArray[numMems].refName[0]='\0';
-		n=fscanf(memsFile," %d %d %d ",&refpos,&querypos,&memsize);
-		if(n!=3){
+		}
+		if(formatNumFields==4){
+			p=ParseMEMRefName(p,refName);
+			refRank=(GetRefNameEntry(refName)->rank);
+		}
+		refPos=strtol(p,&end,10);
+		if(end!=p){
+			p=end;
+			queryPos=strtol(p,&end,10);
+		}
+		if(end!=p){
+			p=end;
+			memSize=strtol(p,&end,10);
+		}
+		if(end==p || refPos<0 || queryPos<0){
 			printf("\n> ERROR: Invalid format\n");
-			getchar();
 			exit(-1);
 		}
-		memsArray[numMems].refPos=refpos;
-		memsArray[numMems].queryPos=querypos;
-		memsArray[numMems].size=memsize;
-		numMems++;
+		AddMEMToSorter(&sorter,refRank,(unsigned int)refPos,(unsigned int)queryPos,(int)memSize);
 	}
 	printf("> Saving sorted MEMs to <%s> ...\n",sortedMemsFilename);
 	fflush(stdout);
 	fclose(memsFile);
 	fclose(sortedMemsFile);
 	free(sortedMemsFilename);
-	free(memsArray);
+	free(line);
+	free(sorter.matches);
+	free(sorter.chunks);
+	#ifdef PARALLEL_SORT
+	free(sorter.threads);
+	#endif
+	free(sorter.runs);
+	if(sorter.refNames!=NULL){
+		free(sorter.refNames);
+		FreeRefNamesTable();
+	}
 	printf("> Done!\n");
 	#ifdef PAUSE_AT_EXIT
 	getchar();
@@ -520,15 +2871,185 @@ void CleanFasta(char *fastafilename){
 	exit(0);
 }
 
+#ifdef LIBSLAMEM
+
+struct _SlamemIndex {
+	FMIndex *fmi;
+	SampledLCPArray *lcpArray;
+	int numRefs;
+	RefStartsTable *refStarts; // start position of each ref in the index (the refs are separated by an 'N' char)
+	unsigned int refReverseStart; // position where the reverse strand starts in the index (or UINT_MAX if not indexed)
+};
+
+struct _SlamemContext {
+	SlamemIndex *index;
+	LCPIntervalCache *intervalCache;
+	char *window;
+};
+
+typedef struct _SlamemMatchCounter {
+	SlamemMatchCallback callback;
+	void *data;
+	long long int numMatches;
+} SlamemMatchCounter;
+
+#ifdef LOCKED_LIBRARY_BUILDS
+static pthread_mutex_t slamemBuildMutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+// Builds the index of these refs (with their reverse strands too if bothStrands is set), or returns NULL if they are empty
+// NOTE: the index build uses global state in bwtindex.c and lcparray.c, so only one index is built at a time (the concurrent calls
+//  are serialized by slamemBuildMutex, as stated in slamem.h), while the matching of the built indexes is never serialized
+SlamemIndex *Slamem_BuildIndex(char **refChars, unsigned int *refSizes, int numRefs, int bothStrands, int numThreads){
+	SlamemIndex *index;
+	char *text, *revText, *refsTexts[2], c;
+	unsigned int refsTextSizes[2], textsize, i, k, *starts;
+	unsigned char *lcpArray;
+	int r;
+	if(numRefs<=0) return NULL;
+	textsize=(unsigned int)(numRefs-1); // separators
+	for(r=0;r<numRefs;r++) textsize+=refSizes[r];
+	if(textsize==0) return NULL;
+	index=(SlamemIndex *)calloc(1,sizeof(SlamemIndex));
+	index->numRefs=numRefs;
+	index->refReverseStart=UINT_MAX;
+	starts=(unsigned int *)malloc((numRefs+1)*sizeof(unsigned int));
+	text=(char *)malloc((2*(size_t)textsize+2)*sizeof(char)); // with space for the reverse strand too
+	k=0;
+	for(r=0;r<numRefs;r++){ // merge the refs, with the chars other than "ACGT" replaced by 'N's
+		if(r!=0) text[k++]='N';
+		starts[r]=k;
+		for(i=0;i<refSizes[r];i++){
+			c=refChars[r][i];
+			if(c>='a' && c<='z') c-=32;
+			if(c!='A' && c!='C' && c!='G' && c!='T') c='N';
+			text[k++]=c;
+		}
+	}
+	text[textsize]='\0';
+	index->refStarts=NewRefStartsTable(starts,numRefs,textsize);
+	refsTexts[0]=text;
+	refsTextSizes[0]=textsize;
+	revText=NULL;
+	if(bothStrands){
+		revText=(char *)malloc((textsize+1)*sizeof(char));
+		GetReverseComplementSequence(text,revText,textsize);
+		revText[textsize]='\0';
+		refsTexts[1]=revText;
+		refsTextSizes[1]=textsize;
+		index->refReverseStart=(textsize+1);
+	}
+	#ifdef LOCKED_LIBRARY_BUILDS
+	pthread_mutex_lock(&slamemBuildMutex);
+	#endif
+	lcpArray=NULL;
+	index->fmi=FMI_BuildIndex(refsTexts,refsTextSizes,(bothStrands?2:1),&lcpArray,0);
+	if(bothStrands){ // the sampled LCP array is built over the concatenation of both strands
+		text[textsize]='N';
+		memcpy((text+textsize+1),revText,(textsize+1)*sizeof(char));
+		textsize=FMI_GetTextSize(index->fmi);
+	}
+	index->lcpArray=BuildSampledLCPArray((index->fmi),text,textsize,lcpArray,1,numThreads,0);
+	#ifdef LOCKED_LIBRARY_BUILDS
+	pthread_mutex_unlock(&slamemBuildMutex);
+	#endif
+	if(lcpArray!=NULL) free(lcpArray);
+	if(revText!=NULL) free(revText);
+	free(text);
+	return index;
+}
+
+void Slamem_FreeIndex(SlamemIndex *index){
+	if(index==NULL) return;
+	FreeSampledSuffixArray(index->lcpArray);
+	FMI_FreeIndex(index->fmi);
+	FreeRefStartsTable(index->refStarts);
+	free(index);
+}
+
+// Creates the per-thread state needed to match queries against this index
+SlamemContext *Slamem_NewContext(SlamemIndex *index){
+	SlamemContext *context;
+	context=(SlamemContext *)malloc(sizeof(SlamemContext));
+	context->index=index;
+	context->intervalCache=NewLCPIntervalCache(index->lcpArray);
+	context->window=(char *)malloc(QUERYWINDOWSIZE*sizeof(char));
+	return context;
+}
+
+void Slamem_FreeContext(SlamemContext *context){
+	if(context==NULL) return;
+	FreeLCPIntervalCache(context->intervalCache);
+	free(context->window);
+	free(context);
+}
+
+// Counts each match found by the matcher before passing it to the callback of the user
+void CountLibraryMatch(void *data, int refId, unsigned int refPos, unsigned int queryPos, int length, int reverse){
+	SlamemMatchCounter *counter;
+	counter=(SlamemMatchCounter *)data;
+	(counter->numMatches)++;
+	if((counter->callback)!=NULL) (counter->callback)((counter->data),refId,refPos,queryPos,length,reverse);
+}
+
+// Finds the matches of this type between the query and the index, reports each one to the callback, and returns their number
+//  (or -1 if this type of match is not supported by the index)
+// NOTE: if the reverse strand of the refs is indexed, the matches on the reverse strand of the query are always reported
+long long int Slamem_FindMatches(SlamemContext *context, char *query, unsigned int querySize, int matchType, int minMatchSize, int bothStrands, SlamemMatchCallback callback, void *data){
+	SlamemIndex *index;
+	StrandMatcher matcher;
+	SlamemMatchCounter counter;
+	int s, numStrands;
+	index=(context->index);
+	if(matchType<0 || matchType>MS_MATCH_TYPE || matchType==2) return -1; // MUMs are not supported yet
+	if(matchType==SMEM_MATCH_TYPE && (index->refReverseStart)==UINT_MAX) return -1; // the SMEMs need both strands indexed
+	if(minMatchSize<1) minMatchSize=1;
+	counter.callback=callback;
+	counter.data=data;
+	counter.numMatches=0;
+	memset(&matcher,0,sizeof(StrandMatcher));
+	matcher.text=query;
+	matcher.packedText=NULL;
+	matcher.textSize=querySize;
+	matcher.numRefs=(index->numRefs);
+	matcher.matchType=matchType;
+	matcher.minMatchSize=minMatchSize;
+	matcher.statsPositions=1;
+	matcher.outputFile=NULL;
+	matcher.refReverseStart=(index->refReverseStart);
+	matcher.reverseHitsFile=NULL;
+	matcher.fmi=(index->fmi);
+	matcher.intervalCache=(context->intervalCache);
+	matcher.refStarts=(index->refStarts);
+	matcher.matchCallback=CountLibraryMatch;
+	matcher.callbackData=(void *)&counter;
+	matcher.showProgress=0;
+	matcher.window=(context->window);
+	numStrands=((bothStrands && (index->refReverseStart)==UINT_MAX)?2:1);
+	for(s=0;s<numStrands;s++){
+		matcher.reverse=s;
+		if(matchType==SMEM_MATCH_TYPE) MatchQuerySMEMs((void *)&matcher);
+		else if(matchType==MS_MATCH_TYPE) MatchQueryStatistics((void *)&matcher);
+		else MatchQueryStrand((void *)&matcher);
+	}
+	return (counter.numMatches);
+}
+
+#else
+
 // TODO: if multiple refs exist draw all refs names bellow ref image, one name per row, and vertical lines on each split point extending to corresponding row (box around names or horizontal line above names right extended to the max of name length or split point; grey line when overlapping)
 // TODO: enable option "-v" on normal mode to create image automatically after finding MEMs (directly draw each block inside MEMs finding function) (or if "-v" set, call function to check if any of the input files is a mems file, set new var "memsFile", and pass it to image function)
 // TODO: draw gene annotations in image if GFF present (first detect type of all input files, set "memsFile"/"gffFile" variables, add all Fastas to a new array and use it as arg to loadSequences function)
 // TODO: remove "baseBwtPos" field from SLCP structure to save memory and benchmark new running times
 // TODO: output MUMs (only once in query) and Multi-MEMS (same number in ref and all queries)
 int main(int argc, char *argv[]){
-	int i, j, n, numFiles, numSeqsInFirstFile, refFileArgNum, memsFileArgNum, refNameSearchArgNum;
-	int argMatchType, argBothStrands, argNoNs, argMinMemSize, argMinSeqLen;
+	int i, j, n, numFiles, numSeqsInFirstFile, refFileArgNum, memsFileArgNum, refNameSearchArgNum, serveArgNum, remoteArgNum, indexFileArgNum, argNumRefFiles, numRefFiles;
+	int argMatchType, argStatsPositions, argCountOnly, argMaxTopMatches, argSortMatches, argChainMatches, argChainMaxGap, argChainMaxDiagDiff, argChainMinLength, argBothStrands, argBothStrandsIndex, argPackQueries, argNoNs, argMinMemSize, argMinSeqLen, argNumThreads, argSortMemory;
 	char *outFilename, *isArgFastaFile, *refNameSearch, optionChar;
+	char **streamFilenames, **refFilenames;
+	int numStreams;
+	MatchingReference *references;
+	MatchingOptions matchingOptions;
 	printf("[ slaMEM v%s ]\n\n",VERSION);
 	if(argc<3){
 		printf("Usage:\n");
@@ -536,28 +3057,57 @@ int main(int argc, char *argv[]){
 		printf("Options:\n");
 		printf("\t-mem\tfind MEMs: any number of occurrences in both ref and query (default)\n");
 		printf("\t-mam\tfind MAMs: unique in ref but any number in query\n");
+		printf("\t-smem\tfind SMEMs: not contained in any other match in the query (both strands are indexed)\n");
+		printf("\t-ms\toutput the matching statistics: longest match length at each query position (in runs)\n");
+		printf("\t-mp\tsame as -ms, but also with one reference position for each run\n");
+		printf("\t-count\tonly output the number of matches, covered bases and lengths histogram of each query\n");
+		printf("\t-k\tonly output this number of the longest matches of each query strand\n");
+		printf("\t-sort\toutput the matches of each query already sorted (as with option -s)\n");
+		printf("\t-ch\tchain the matches of each query strand into colinear chains, and output the chains with their matches\n");
+		printf("\t-cg\tmaximum gap between consecutive matches of a chain (default=%d)\n",chainMaxGap);
+		printf("\t-cd\tmaximum diagonal difference between consecutive matches of a chain (default=%d)\n",chainMaxDiagDiff);
+		printf("\t-cl\tminimum total length of the matches of a chain (default=%d)\n",chainMinLength);
 		//printf("\t-mum\tfind MUMs: unique both in ref and query\n");
 		printf("\t-l\tminimum match length (default=20)\n");
 		printf("\t-o\toutput file name (default=\"*-mems.txt\")\n");
 		printf("\t-b\tprocess both forward and reverse strands\n");
+		printf("\t-ib\tindex both reference strands to process both query strands in a single pass\n");
 		printf("\t-n\tdiscard 'N' characters in the sequences\n");
 		printf("\t-m\tminimum sequence size (e.g. to ignore small scaffolds)\n");
 		printf("\t-r\tload only the reference(s) whose name(s) contain(s) this string\n");
+		printf("\t-t\tnumber of threads used to build the index, to decompress bgzip files and to match both strands at once (default=number of cores)\n");
+		printf("\t-p\tkeep the query sequences in memory with 2 bits per base\n");
+		printf("\t-ix\tattach the index saved in this file (shared by all the processes using it), or build it and save it there\n");
+		printf("\t-mr\tuse this number of the first files as separate references, and match each query against all of them (one output file each)\n");
+		printf("\t-\tread the query sequences from stdin (pipes are also read one sequence at a time)\n");
 		printf("Extra:\n");
 		printf("\t-v\tgenerate MEMs map image from this MEMs file\n");
+		#ifdef SERVER_MODE
+		printf("\t-serve\tkeep the index of the reference in memory and match the queries sent to this local socket file\n");
+		printf("\t-remote\tsend the queries to the server on this local socket file (with options -mam, -l, -b and -o only)\n");
+		#endif
 		//printf("\t-s\tsort MEMs file\n");
 		//printf("\t-c\tclean FASTA file\n");
 		printf("Example:\n");
 		printf("\t%s -b -l 10 ./ref.fna ./query.fna\n",argv[0]);
 		printf("\t%s -v ./ref-mems.txt ./ref.fna ./query.fna\n",argv[0]);
+		printf("\t%s -mr 2 -l 20 ./human.fna ./mouse.fna ./query.fna\n",argv[0]);
+		#ifdef SERVER_MODE
+		printf("\t%s -serve /tmp/ref.sock ./ref.fna\n",argv[0]);
+		printf("\t%s -remote /tmp/ref.sock -b -l 10 ./query.fna\n",argv[0]);
+		#endif
 		return (-1);
 	}
 	if( ParseArgument(argc,argv,"S",0) ){ // Sort MEMs
-		if(argc!=3){
-			printf("Usage: %s -s <mems_file>\n\n",argv[0]);
+		argSortMemory=ParseArgument(argc,argv,"MB",1);
+		argNumThreads=ParseArgument(argc,argv,"T",1);
+		if(argc!=(3+2*(argSortMemory!=(-1))+2*(argNumThreads!=(-1)))){
+			printf("Usage: %s -s [-mb <max_memory_in_MB>] [-t <num_threads>] <mems_file>\n\n",argv[0]);
 			return (-1);
 		}
-		SortMEMsFile(argv[2]);
+		if(argSortMemory<1) argSortMemory=DEFAULTSORTMEMORY;
+		if(argNumThreads<1) argNumThreads=GetNumberOfCores(); // default is one thread per core
+		SortMEMsFile(argv[(argc-1)],argSortMemory,argNumThreads);
 		return 0;
 	}
 	if( ParseArgument(argc,argv,"C",0) ){ // Clean FASTA file
@@ -572,10 +3122,17 @@ int main(int argc, char *argv[]){
 	isArgFastaFile=(char *)calloc(argc,sizeof(char));
 	numFiles=0;
 	for(i=1;i<argc;i++){
-		if(argv[i][0]=='-'){ // skip arguments for options
+		if(argv[i][0]=='-' && argv[i][1]!='\0'){ // skip arguments for options (a single "-" is stdin)
 			optionChar=argv[i][1];
 			if(optionChar>='A' && optionChar<='Z') optionChar=(char)('a' + (optionChar - 'A'));
-			if(optionChar=='l' || optionChar=='o' || optionChar=='m' || optionChar=='v') i++; // skip value of option "-l", "-o", "-s", "-v"
+			if(argv[i][2]!='\0'){ // multi-letter options (e.g. "-mam") have no value, except the chaining limits "-cg", "-cd" and "-cl"
+				if(optionChar=='c' && argv[i][3]=='\0' && strchr("gGdDlL",argv[i][2])!=NULL) i++;
+				else if(optionChar=='i' && argv[i][3]=='\0' && (argv[i][2]=='x' || argv[i][2]=='X')) i++; // index file of "-ix"
+				else if(optionChar=='m' && argv[i][3]=='\0' && (argv[i][2]=='r' || argv[i][2]=='R')) i++; // number of references of "-mr"
+				else if((optionChar=='s' || optionChar=='r') && (argv[i][2]=='e' || argv[i][2]=='E')) i++; // socket file of "-serve" and "-remote"
+				continue;
+			}
+			if(optionChar=='l' || optionChar=='o' || optionChar=='m' || optionChar=='v' || optionChar=='t' || optionChar=='k') i++; // skip value of option "-l", "-o", "-m", "-v", "-t", "-k"
 			else if(optionChar=='r'){ // skip reference name string (can span through multiple args)
 				i++;
 				if(i==argc) break;
@@ -598,7 +3155,37 @@ int main(int argc, char *argv[]){
 		isArgFastaFile[i]=1;
 		numFiles++;
 	}
-	if(numFiles<2) exitMessage("Not enough input sequence files provided");
+	serveArgNum=(-1);
+	#ifdef SERVER_MODE
+	remoteArgNum=ParseArgument(argc,argv,"RE",2);
+	if(remoteArgNum!=(-1)){ // send the queries to a server that already has the index of the reference in memory
+		if(numFiles==0) exitMessage("No query files provided");
+		streamFilenames=(char **)malloc(argc*sizeof(char *));
+		numStreams=0;
+		for(i=1;i<argc;i++) if(isArgFastaFile[i]) streamFilenames[numStreams++]=argv[i];
+		free(isArgFastaFile);
+		argMatchType=ParseArgument(argc,argv,"MA",0); // MEMs or MAMs
+		argMinMemSize=ParseArgument(argc,argv,"L",1);
+		if(argMinMemSize==(-1)) argMinMemSize=20;
+		argBothStrands=ParseArgument(argc,argv,"B",0);
+		j=ParseArgument(argc,argv,"O",2);
+		if(j==(-1)) outFilename=AppendToBasename(streamFilenames[0],"-mems.txt"); // default output base filename is the first query filename
+		else outFilename=argv[j];
+		i=GetRemoteMatches(argv[remoteArgNum],streamFilenames,numStreams,argMatchType,argMinMemSize,argBothStrands,outFilename);
+		free(streamFilenames);
+		if(j==(-1)) free(outFilename);
+		printf("> Done!\n");
+		return i;
+	}
+	serveArgNum=ParseArgument(argc,argv,"SE",2);
+	if(serveArgNum!=(-1) && numFiles!=1) exitMessage("Only the reference file is needed to start the server");
+	#endif
+	argNumRefFiles=ParseArgument(argc,argv,"MR",1);
+	if(argNumRefFiles<1 || serveArgNum!=(-1)) argNumRefFiles=1;
+	#ifdef DEBUGMEMS
+	if(argNumRefFiles!=1) exitMessage("Multiple references are not supported in debug mode");
+	#endif
+	if(numFiles<(argNumRefFiles+1) && serveArgNum==(-1)) exitMessage("Not enough input sequence files provided");
 	argNoNs=ParseArgument(argc,argv,"N",0);
 	argMinSeqLen=ParseArgument(argc,argv,"M",1);
 	if(argMinSeqLen==(-1)) argMinSeqLen=0;
@@ -628,12 +3215,29 @@ int main(int argc, char *argv[]){
 		refNameSearch[n]='\0';
 	}
 	memsFileArgNum=ParseArgument(argc,argv,"V",2);
+	argNumThreads=ParseArgument(argc,argv,"T",1);
+	if(argNumThreads<1) argNumThreads=GetNumberOfCores(); // default is one thread per core
+	SetSequenceLoadingThreads(argNumThreads); // the gzip files are also decompressed with this number of threads
 	refFileArgNum=(-1);
 	numSeqsInFirstFile=0;
 	numFiles=0;
 	numSequences=0; // initialize global variable needed by sequence functions
+	streamFilenames=(char **)malloc(argc*sizeof(char *));
+	numStreams=0;
+	refFilenames=NULL;
+	numRefFiles=0;
+	if(argNumRefFiles!=1) refFilenames=(char **)malloc(argNumRefFiles*sizeof(char *));
 	for(i=1;i<argc;i++){
 		if(!isArgFastaFile[i]) continue; // skip options and their arguments
+		if(refFilenames!=NULL){ // each reference is only loaded when its index is built, and the queries after all of them
+			if(numRefFiles<argNumRefFiles) refFilenames[numRefFiles++]=argv[i];
+			else streamFilenames[numStreams++]=argv[i];
+			continue;
+		}
+		if(numFiles!=0 && IsStreamFile(argv[i])){ // query files that are not seekable are only read while matching
+			streamFilenames[numStreams++]=argv[i];
+			continue;
+		}
 		n=LoadSequencesFromFile(argv[i],((numFiles==0 && memsFileArgNum==(-1))?1:0),((numFiles==0)?1:0),argNoNs,(unsigned int)argMinSeqLen,(numFiles==0)?refNameSearch:NULL);
 		if(n!=0) numFiles++;
 		if(numFiles==0) exitMessage("No valid sequences found in reference file");
@@ -643,25 +3247,126 @@ int main(int argc, char *argv[]){
 		}
 	}
 	free(isArgFastaFile);
-	if(refNameSearch!=NULL) free(refNameSearch);
+	if(refNameSearch!=NULL && refFilenames==NULL) free(refNameSearch);
 	//if(numFiles==0) exitMessage("No reference or query files provided");
-	if(numFiles==1) exitMessage("No query files provided");
+	#ifdef SERVER_MODE
+	if(serveArgNum!=(-1)){ // the queries (and their options) are sent by the clients
+		if(ParseArgument(argc,argv,"IB",0)) printf("> WARNING: Option -ib is not used by the server (the clients choose the strands with -b)\n");
+		free(streamFilenames);
+		indexFileArgNum=ParseArgument(argc,argv,"IX",2);
+		ServeMatches(numSeqsInFirstFile,argv[serveArgNum],argNoNs,(unsigned int)argMinSeqLen,argNumThreads,argNumThreads,((indexFileArgNum!=(-1))?argv[indexFileArgNum]:NULL));
+		return 0;
+	}
+	#endif
+	if(numFiles==1 && numStreams==0) exitMessage("No query files provided");
 	n=(numSequences-numSeqsInFirstFile);
-	if(n==0) exitMessage("No valid query sequences found");
-	printf("> %d reference%s and %d quer%s successfully loaded\n",numSeqsInFirstFile,((numSeqsInFirstFile==1)?"":"s"),n,((n==1)?"y":"ies"));
+	if(n==0 && numStreams==0) exitMessage("No valid query sequences found");
+	if(refFilenames==NULL) printf("> %d reference%s and %d quer%s successfully loaded\n",numSeqsInFirstFile,((numSeqsInFirstFile==1)?"":"s"),n,((n==1)?"y":"ies"));
 	if(memsFileArgNum!=(-1)){ // Create MEMs image
+		if(refFilenames!=NULL) exitMessage("Multiple references are not supported when creating a MEMs map image");
+		if(numStreams!=0) exitMessage("Streamed query files are not supported when creating a MEMs map image");
 		CreateMemMapImage(argv[memsFileArgNum]);
 		return 0;
 	}
 	argMatchType=0; // MEMs mode
 	if( ParseArgument(argc,argv,"MA",0) ) argMatchType=1; // MAMs mode
+	if( ParseArgument(argc,argv,"SM",0) ) argMatchType=SMEM_MATCH_TYPE; // SMEMs mode
+	argStatsPositions=ParseArgument(argc,argv,"MP",0);
+	argCountOnly=ParseArgument(argc,argv,"CO",0);
+	argMaxTopMatches=ParseArgument(argc,argv,"K",1);
+	if(argMaxTopMatches<1) argMaxTopMatches=0; // all matches are output by default
+	argSortMatches=ParseArgument(argc,argv,"SO",0);
+	argChainMatches=ParseArgument(argc,argv,"CH",0);
+	argChainMaxGap=ParseArgument(argc,argv,"CG",1);
+	if(argChainMaxGap>=0) chainMaxGap=argChainMaxGap;
+	argChainMaxDiagDiff=ParseArgument(argc,argv,"CD",1);
+	if(argChainMaxDiagDiff>=0) chainMaxDiagDiff=argChainMaxDiagDiff;
+	argChainMinLength=ParseArgument(argc,argv,"CL",1);
+	if(argChainMinLength>=0) chainMinLength=argChainMinLength;
+	if( ParseArgument(argc,argv,"MS",0) || argStatsPositions ) argMatchType=MS_MATCH_TYPE; // matching statistics mode
 	argBothStrands=ParseArgument(argc,argv,"B",0);
+	argBothStrandsIndex=ParseArgument(argc,argv,"IB",0);
+	if(argMatchType==SMEM_MATCH_TYPE) argBothStrandsIndex=1; // the bidirectional search needs both strands in the index
+	if(argMatchType==MS_MATCH_TYPE && argBothStrandsIndex){
+		printf("> WARNING: Option -ib is not used with the matching statistics (use -b for both strands)\n");
+		argBothStrandsIndex=0;
+	}
+	if(argCountOnly && (argMatchType==SMEM_MATCH_TYPE || argMatchType==MS_MATCH_TYPE)){
+		printf("> WARNING: Option -count is only used for MEMs and MAMs\n");
+		argCountOnly=0;
+	}
+	if(argMaxTopMatches && (argCountOnly || argMatchType==SMEM_MATCH_TYPE || argMatchType==MS_MATCH_TYPE)){
+		printf("> WARNING: Option -k is only used when outputting MEMs or MAMs\n");
+		argMaxTopMatches=0;
+	}
+	if(argSortMatches && (argCountOnly || argMatchType==MS_MATCH_TYPE)){
+		printf("> WARNING: Option -sort is not used with -count or -ms\n");
+		argSortMatches=0;
+	}
+	if(argChainMatches && (argCountOnly || argMatchType==MS_MATCH_TYPE)){
+		printf("> WARNING: Option -ch is not used with -count or -ms\n");
+		argChainMatches=0;
+	}
+	if(argCountOnly && argBothStrandsIndex){ // the strand of each match is only known after locating it
+		printf("> WARNING: Option -ib is not used with -count (use -b for both strands)\n");
+		argBothStrandsIndex=0;
+	}
+	if(argBothStrandsIndex && argBothStrands){
+		printf("> WARNING: Option -b is not needed when both strands are indexed\n");
+		argBothStrands=0;
+	}
+	argPackQueries=ParseArgument(argc,argv,"P",0);
+	indexFileArgNum=ParseArgument(argc,argv,"IX",2);
+	if(indexFileArgNum!=(-1) && refFilenames!=NULL){
+		printf("> WARNING: Option -ix is not used with multiple references\n");
+		indexFileArgNum=(-1);
+	}
+	#ifdef DEBUGMEMS
+	indexFileArgNum=(-1); // the debug output needs the reference chars
+	if(argBothStrandsIndex){ // the debug output needs a reference index with a single strand
+		argBothStrandsIndex=0;
+		argBothStrands=1;
+	}
+	if(argMatchType==SMEM_MATCH_TYPE || argMatchType==MS_MATCH_TYPE) argMatchType=0;
+	argCountOnly=0;
+	argMaxTopMatches=0;
+	argSortMatches=0;
+	argChainMatches=0;
+	argPackQueries=0; // the debug output needs the full chars of the queries
+	#endif
 	argMinMemSize=ParseArgument(argc,argv,"L",1);
 	if(argMinMemSize==(-1)) argMinMemSize=20; // default minimum MEM length is 20
 	n=ParseArgument(argc,argv,"O",2);
-	if(n==(-1)) outFilename=AppendToBasename(argv[refFileArgNum],"-mems.txt"); // default output base filename is the ref filename
+	if(refFilenames!=NULL) outFilename=((n==(-1))?NULL:argv[n]); // each reference has its own output file
+	else if(n==(-1)) outFilename=AppendToBasename(argv[refFileArgNum],"-mems.txt"); // default output base filename is the ref filename
 	else outFilename=argv[n];
-	GetMatches(numSeqsInFirstFile,numSequences,argMatchType,argMinMemSize,argBothStrands,outFilename);
+	references=NULL;
+	if(refFilenames!=NULL){ // build the indexes of all the references, and only then load the queries
+		references=LoadMatchingReferences(numRefFiles,refFilenames,outFilename,refNameSearch,argNoNs,(unsigned int)argMinSeqLen,argMatchType,argMinMemSize,argBothStrandsIndex,argNumThreads);
+		j=numStreams;
+		numStreams=0;
+		for(i=0;i<j;i++){
+			if(IsStreamFile(streamFilenames[i])){ // only read while matching
+				streamFilenames[numStreams++]=streamFilenames[i];
+				continue;
+			}
+			LoadSequencesFromFile(streamFilenames[i],0,0,argNoNs,(unsigned int)argMinSeqLen,NULL);
+		}
+		if(numSequences==0 && numStreams==0) exitMessage("No valid query sequences found");
+		printf("> %d references and %d quer%s successfully loaded\n",numRefFiles,numSequences,((numSequences==1)?"y":"ies"));
+		if(refNameSearch!=NULL) free(refNameSearch);
+		free(refFilenames);
+	}
+	matchingOptions.matchType=argMatchType;
+	matchingOptions.minMatchSize=argMinMemSize;
+	matchingOptions.statsPositions=argStatsPositions;
+	matchingOptions.countOnly=argCountOnly;
+	matchingOptions.maxTopMatches=argMaxTopMatches;
+	matchingOptions.sortMatches=argSortMatches;
+	matchingOptions.chainMatches=argChainMatches;
+	matchingOptions.bothStrands=argBothStrands;
+	GetMatches(references,numRefFiles,numSeqsInFirstFile,numSequences,numStreams,streamFilenames,argNoNs,(unsigned int)argMinSeqLen,&matchingOptions,argBothStrandsIndex,argPackQueries,argNumThreads,((indexFileArgNum!=(-1))?argv[indexFileArgNum]:NULL),outFilename);
+	free(streamFilenames);
 	if(n==(-1)) free(outFilename);
 	DeleteAllSequences();
 	printf("> Done!\n");
@@ -670,3 +3375,5 @@ int main(int argc, char *argv[]){
 	#endif
 	return 0;
 }
+
+#endif
@@ -0,0 +1,23 @@
+typedef struct _SlamemIndex SlamemIndex;
+typedef struct _SlamemContext SlamemContext;
+
+// Called for each match found, with 0-based positions (the matches on the reverse strand of the query have their query position in
+//  that strand, as in the output files of the command line tool)
+typedef void (*SlamemMatchCallback)(void *data, int refId, unsigned int refPos, unsigned int queryPos, int length, int reverse);
+
+// Match types
+#define SLAMEM_MEM 0
+#define SLAMEM_MAM 1
+#define SLAMEM_SMEM 3
+#define SLAMEM_MS 4
+
+// NOTE: the sequences are given as "ACGT" chars, and any other char is treated as an 'N' (the queries must be uppercase)
+// NOTE: an index can be queried by any number of threads at the same time, each one with its own context
+// NOTE: Slamem_BuildIndex can be called from several threads, but the builds themselves run one at a time (the builder keeps its
+//  state in globals), so concurrent calls wait for each other; each build uses numThreads threads for its own parallel steps
+// NOTE: without pthreads (non-unix builds), Slamem_BuildIndex is not serialized and must only be called from one thread at a time
+SlamemIndex *Slamem_BuildIndex(char **refChars, unsigned int *refSizes, int numRefs, int bothStrands, int numThreads);
+void Slamem_FreeIndex(SlamemIndex *index);
+SlamemContext *Slamem_NewContext(SlamemIndex *index);
+void Slamem_FreeContext(SlamemContext *context);
+long long int Slamem_FindMatches(SlamemContext *context, char *query, unsigned int querySize, int matchType, int minMatchSize, int bothStrands, SlamemMatchCallback callback, void *data);
@@ -17,6 +17,9 @@
 #include <string.h>
 #include <stdint.h>
 #include <math.h>
+#if defined(unix) || defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
 
 void exitMessage(char *msg){
 	printf("> ERROR: %s\n",msg);
@@ -61,6 +64,17 @@ int ParseArgument(int numargs, char** arglist, char *optionchars, int parse){
 	return 0; // argument not present
 }
 
+// Returns the number of processors available in the system (or 1 if it cannot be determined)
+int GetNumberOfCores(){
+	int n;
+	n = 1;
+	#ifdef _SC_NPROCESSORS_ONLN
+	n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if( n < 1 ) n = 1;
+	#endif
+	return n;
+}
+
 // joins the basename of a name of a file with another string
 char* AppendToBasename(char *filename, char *extra){
 	char *resultfilename;
@@ -4,6 +4,7 @@ char* AppendToBasename(char *filename, char *extra);
 char *NormalizeSeqName(char *name, int mode);
 int ParseArgument(int numargs, char** arglist, char *optionchars, int parse);
 int ParseNumber(char *numberstring);
+int GetNumberOfCores();
 void PrintNumber(int number);
 void PrintSpace(int spaceval);
 void PrintTime(double timeval);